@@ -132,6 +132,12 @@ cali_set_string(cali_id_t attr, const char* val)
     return CALI_SUCCESS;
 }
 
+cali_err
+cali_accumulate(cali_id_t attr, double val)
+{
+    return CALI_SUCCESS;
+}
+
 cali_err
 cali_begin_double_byname(const char* attr_name, double val)
 {
@@ -179,3 +185,65 @@ cali_end_byname(const char* attr_name)
 {
     return CALI_SUCCESS;
 }
+
+const char*
+cali_intern_string(const char* str)
+{
+    return str;
+}
+
+//
+// --- Static regions
+//
+
+cali_region_t
+cali_make_region(const char* attr_name, const char* name)
+{
+    return 0;
+}
+
+cali_region_t
+cali_make_region_once(cali_region_t* handle, const char* attr_name, const char* name)
+{
+    return 0;
+}
+
+cali_err
+cali_region_begin(cali_region_t region)
+{
+    return CALI_SUCCESS;
+}
+
+cali_err
+cali_region_end(cali_region_t region)
+{
+    return CALI_SUCCESS;
+}
+
+//
+// --- Loops
+//
+
+cali_loop_t
+cali_make_loop(const char* name, cali_loop_bucketing mode, int bucket_size)
+{
+    return 0;
+}
+
+cali_err
+cali_loop_begin(cali_loop_t loop)
+{
+    return CALI_SUCCESS;
+}
+
+cali_err
+cali_loop_iteration(cali_loop_t loop, int i)
+{
+    return CALI_SUCCESS;
+}
+
+cali_err
+cali_loop_end(cali_loop_t loop)
+{
+    return CALI_SUCCESS;
+}
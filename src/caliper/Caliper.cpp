@@ -41,9 +41,11 @@
 #include "EntryList.h"
 #include "MetadataTree.h"
 #include "MemoryPool.h"
+#include "SnapshotRing.h"
 
 #include <Services.h>
 
+#include <AttributeInfoTable.h>
 #include <ContextRecord.h>
 #include <Node.h>
 #include <Log.h>
@@ -51,15 +53,19 @@
 
 #include <signal.h>
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstring>
 #include <cstdlib>
+#include <ctime>
 #include <functional>
 #include <iostream>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <thread>
 #include <vector>
 #include <utility>
 
@@ -73,7 +79,7 @@ namespace
 
     inline cali_context_scope_t 
     attr2caliscope(const Attribute& attr) {
-        switch (attr.properties() & CALI_ATTR_SCOPE_MASK) {
+        switch (attr.scope()) {
         case CALI_ATTR_SCOPE_THREAD:
             return CALI_SCOPE_THREAD;
         case CALI_ATTR_SCOPE_PROCESS:
@@ -94,6 +100,7 @@ namespace
         Caliper c = Caliper::instance();
 
         if (c) {
+            c.events().pre_flush_evt(&c, nullptr);
             c.events().flush(&c, nullptr);
             c.events().finish_evt(&c);
 
@@ -124,16 +131,152 @@ namespace
             return (m_lock > 0);
         }
     };
+
+    // Context tree node reclamation. While in the Caliper API, threads
+    // announce the epoch they entered in, because they may hold pointers
+    // to context tree nodes. Nodes unlinked from the tree in epoch E can
+    // be freed once no thread announces an epoch <= E.
+
+    bool                  s_reclaim_nodes = false;
+    std::atomic<uint64_t> s_reclaim_epoch { 1 };
     
 } // namespace
 
 
+//
+// --- Asynchronous snapshot processing
+//
+
+namespace
+{
+
+/// Per-thread snapshot queue. Owned by its async worker; the producer
+/// thread marks it retired when the thread scope is released.
+struct AsyncQueue {
+    SnapshotRing      ring;
+    std::atomic<bool> retired;
+
+    AsyncQueue(size_t size)
+        : ring(size), retired(false)
+        { }
+};
+
+struct AsyncWorker {
+    std::thread               thread;
+    std::mutex                lock;
+    std::vector<AsyncQueue*>  queues;
+
+    /// Number of drain_async_queues() calls waiting for the queues.
+    ///   The worker doesn't delete retired queues while it is non-zero.
+    std::atomic<unsigned>     drainers;
+    /// Set when the worker thread has left its processing loop
+    std::atomic<bool>         done;
+
+    AsyncWorker()
+        : drainers(0), done(false)
+        { }
+};
+
+enum AsyncOverflowPolicy {
+    ASYNC_BLOCK, ASYNC_DROP, ASYNC_INLINE
+};
+
+} // namespace [anonymous]
+
+
+//
+// Published thread context
+//
+
+struct Caliper::ContextHistory
+{
+    // The perf sampler looks up samples only after they waited in the
+    // ring buffer for up to its drain interval (10 msec). 8192 updates
+    // cover ~800k context updates/sec per thread over that interval,
+    // at 192 KiB per history.
+    static const unsigned SIZE = 8192;
+
+    // Written by the owning thread only. Readers check the slot's entry
+    // number before and after reading it, like a seqlock.
+    struct Update {
+        std::atomic<unsigned> entry; // entry number + 1; 0 while writing
+        std::atomic<uint64_t> time;
+        std::atomic<Node*>    node;
+    }                         updates[SIZE];
+
+    std::atomic<unsigned>     count;
+
+    ContextHistory()
+        : count(0)
+        {
+            for (Update& u : updates) {
+                u.entry.store(0);
+                u.time.store(0);
+                u.node.store(nullptr);
+            }
+        }
+
+    void publish(Node* node) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        unsigned n = count.load(std::memory_order_relaxed);
+        Update&  u = updates[n % SIZE];
+
+        u.entry.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        u.time.store(static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec,
+                     std::memory_order_relaxed);
+        u.node.store(node, std::memory_order_relaxed);
+
+        u.entry.store(n + 1, std::memory_order_release);
+        count.store(n + 1, std::memory_order_release);
+    }
+
+    bool find(uint64_t time, Node** node) const {
+        unsigned n = count.load(std::memory_order_acquire);
+
+        // go backwards from the latest update
+        for (unsigned i = n; i > 0 && n - i < SIZE; --i) {
+            const Update& u = updates[(i - 1) % SIZE];
+
+            if (u.entry.load(std::memory_order_acquire) != i)
+                return false; // overwritten
+
+            uint64_t t  = u.time.load(std::memory_order_relaxed);
+            Node*    nd = u.node.load(std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if (u.entry.load(std::memory_order_relaxed) != i)
+                return false;
+
+            if (t <= time) {
+                *node = nd;
+                return true;
+            }
+        }
+
+        // before the first update?
+        if (n < SIZE) {
+            *node = nullptr;
+            return true;
+        }
+
+        return false;
+    }
+};
+
+
 //
 // Caliper Scope data
 //
 
 struct Caliper::Scope
 {
+    static const size_t  MAX_ACCUMULATORS = 32;
+
     MemoryPool           mempool;
     ContextBuffer        blackboard;
     
@@ -141,10 +284,159 @@ struct Caliper::Scope
 
     ::siglock            lock;
 
+    // Pending accumulate() deltas; added to the next pushed snapshot
+    struct Accumulator {
+        cali_id_t        attr_id;
+        double           value;
+    }                    accumulators[MAX_ACCUMULATORS];
+    size_t               num_accumulators;
+
+    // Async snapshot queue of this thread, if any
+    AsyncQueue*          async_queue;
+    bool                 is_async_worker;
+
+    // Snapshots that signal handlers deferred while the lock was held.
+    // Single-producer (signal handler), single-consumer ring.
+    static const int     MAX_DEFERRED = 16;
+    static const size_t  MAX_DEFERRED_ENTRIES = 4;
+
+    struct DeferredSnapshot {
+        int              scopes;
+        size_t           n;
+        cali_id_t        attr[MAX_DEFERRED_ENTRIES];
+        cali_attr_type   type[MAX_DEFERRED_ENTRIES];
+        size_t           size[MAX_DEFERRED_ENTRIES];
+        uint64_t         value[MAX_DEFERRED_ENTRIES];
+    }                    deferred[MAX_DEFERRED];
+    volatile sig_atomic_t deferred_head;
+    volatile sig_atomic_t deferred_tail;
+    bool                 processing_deferred;
+
+    // Node reclamation epoch this thread entered the Caliper API in, or 0
+    std::atomic<uint64_t> epoch;
+
+    // Published context updates, if publish_context() was called
+    ContextHistory*      context_history;
+
     Scope(cali_context_scope_t s)
-        : scope(s) { }
+        : blackboard(s == CALI_SCOPE_PROCESS),
+          scope(s), num_accumulators(0), async_queue(nullptr), is_async_worker(false),
+          deferred_head(0), deferred_tail(0), processing_deferred(false), epoch(0),
+          context_history(nullptr) { }
+};
+
+
+namespace
+{
+
+/// \brief Announces the current node reclamation epoch in a thread scope
+///   for its lifetime, unless an enclosing guard already did. Use at every
+///   siglock site that handles context tree nodes, with the lock held:
+///   signal handlers don't enter then, so they never see the epoch change
+///   halfway.
+class epoch_guard
+{
+    Caliper::Scope* m_s;
+    bool            m_entered;
+
+public:
+
+    epoch_guard(Caliper::Scope* s)
+        : m_s(s), m_entered(false)
+        {
+            if (s_reclaim_nodes && !m_s->epoch.load(std::memory_order_relaxed)) {
+                m_s->epoch.store(s_reclaim_epoch.load());
+                m_entered = true;
+            }
+        }
+
+    ~epoch_guard() {
+        if (m_entered)
+            m_s->epoch.store(0);
+    }
 };
 
+/// \brief Lock guard for a thread scope's siglock.
+///   When the outermost lock is released, it pushes the snapshots that
+///   signal handlers deferred in the meantime.
+class deferred_snapshot_lock
+{
+    Caliper*        m_c;
+    Caliper::Scope* m_s;
+
+    void process_deferred() {
+        m_s->processing_deferred = true;
+
+        while (m_s->deferred_tail != m_s->deferred_head) {
+            int t = m_s->deferred_tail;
+
+            // Pairs with the release fence in defer_snapshot(): read the
+            // slot only after the handler published it
+            std::atomic_signal_fence(std::memory_order_acquire);
+
+            Caliper::Scope::DeferredSnapshot d = m_s->deferred[t % Caliper::Scope::MAX_DEFERRED];
+
+            // Finish the copy before a signal handler may reuse the slot
+            std::atomic_signal_fence(std::memory_order_release);
+
+            m_s->deferred_tail = t + 1;
+
+            Variant data[Caliper::Scope::MAX_DEFERRED_ENTRIES];
+
+            for (size_t i = 0; i < d.n; ++i)
+                data[i] = Variant(d.type[i], &d.value[i], d.size[i]);
+
+            EntryList trigger_info(d.n, d.attr, data);
+
+            m_c->push_snapshot(d.scopes, &trigger_info);
+        }
+
+        m_s->processing_deferred = false;
+    }
+
+public:
+
+    deferred_snapshot_lock(Caliper* c, Caliper::Scope* s)
+        : m_c(c), m_s(s)
+        {
+            m_s->lock.lock();
+        }
+
+    /// \brief Push the snapshots deferred so far. Call right before a 
+    ///   blackboard update, so that signals that arrived in the meantime
+    ///   are charged to the context they interrupted, not the new one.
+    void process_pending() {
+        if (!m_s->processing_deferred && m_s->deferred_tail != m_s->deferred_head)
+            process_deferred();
+    }
+
+    ~deferred_snapshot_lock() {
+        m_s->lock.unlock();
+
+        if (!m_s->lock.is_locked() && !m_s->processing_deferred &&
+            m_s->deferred_tail != m_s->deferred_head)
+            process_deferred();
+    }
+};
+
+/// \brief Siglock guard for the Caliper API: holds the lock, processes
+///   deferred snapshots on release, and announces the reclamation epoch
+///   while the lock is held (the base class is locked before, and 
+///   unlocked after, the epoch guard member).
+class deferred_snapshot_guard : public deferred_snapshot_lock
+{
+    epoch_guard     m_epoch;
+
+public:
+
+    deferred_snapshot_guard(Caliper* c, Caliper::Scope* s)
+        : deferred_snapshot_lock(c, s), m_epoch(s)
+        { }
+};
+
+} // namespace [anonymous]
+
+
 
 //
 // --- Caliper Global Data
@@ -177,13 +469,27 @@ struct Caliper::GlobalData
     ScopeCallbackFn        get_task_scope_cb;
 
     MetadataTree           tree;
+
+    // Attribute descriptors, indexed by attribute id
+    AttributeInfoTable     attribute_info;
     
     mutable std::mutex     attribute_lock;
     map<string, Node*>     attribute_nodes;
 
-    // are there new attributes since last snapshot recording? - temporary, will go away
-    std::atomic<bool>      new_attributes;
-    std::atomic<bool>      bootstrap_nodes_written;
+    // Serializes attribute creation, including the create_attr callbacks
+    std::recursive_mutex   attribute_create_lock;
+
+    // Journal position of the next node to write to the write_record stream
+    cali_id_t              node_cursor;
+    std::mutex             node_cursor_lock;
+
+    // All live scopes; their blackboards reference context tree nodes
+    std::vector<Scope*>    scopes;
+    std::mutex             scopes_lock;
+
+    // Epoch in which the pending retired context tree nodes were unlinked
+    uint64_t               reclaim_epoch;
+    std::mutex             reclaim_lock;
 
     Attribute              name_attr;
     Attribute              type_attr;
@@ -201,14 +507,25 @@ struct Caliper::GlobalData
 
     pthread_key_t          thread_scope_key;
 
+    // Asynchronous snapshot processing
+
+    bool                   async;
+    AsyncOverflowPolicy    async_overflow;
+    size_t                 async_buffer_size;
+
+    std::vector<AsyncWorker*> async_workers;
+    std::atomic<unsigned>  async_next_worker;
+    std::atomic<bool>      async_stopped;
+    std::atomic<size_t>    async_num_dropped;
+
     // --- constructor
 
     GlobalData()
         : config { RuntimeConfig::init("caliper", s_configdata) },
           get_thread_scope_cb { nullptr },
           get_task_scope_cb   { nullptr },
-          new_attributes          { true  },
-          bootstrap_nodes_written { false },
+          node_cursor { 0 },
+          reclaim_epoch { 0 },
           name_attr { Attribute::invalid }, 
           type_attr { Attribute::invalid },  
           prop_attr { Attribute::invalid },
@@ -216,15 +533,23 @@ struct Caliper::GlobalData
           automerge { true },
           process_scope        { new Scope(CALI_SCOPE_PROCESS) },
           default_thread_scope { new Scope(CALI_SCOPE_THREAD)  },
-          default_task_scope   { new Scope(CALI_SCOPE_TASK)    }
+          default_task_scope   { new Scope(CALI_SCOPE_TASK)    },
+          async                { false },
+          async_overflow       { ASYNC_BLOCK },
+          async_buffer_size    { 0 },
+          async_next_worker    { 0 },
+          async_stopped        { false },
+          async_num_dropped    { 0 }
     {
         automerge = config.get("automerge").to_bool();
 
+        scopes = { process_scope, default_thread_scope, default_task_scope };
+
         const MetaAttributeIDs* m = tree.meta_attribute_ids();
         
-        name_attr = Attribute::make_attribute(tree.node(m->name_attr_id), m);
-        type_attr = Attribute::make_attribute(tree.node(m->type_attr_id), m);
-        prop_attr = Attribute::make_attribute(tree.node(m->prop_attr_id), m);
+        name_attr = make_attribute(tree.node(m->name_attr_id));
+        type_attr = make_attribute(tree.node(m->type_attr_id));
+        prop_attr = make_attribute(tree.node(m->prop_attr_id));
 
         attribute_nodes.insert(make_pair(name_attr.name(), tree.node(name_attr.id())));
         attribute_nodes.insert(make_pair(type_attr.name(), tree.node(type_attr.id())));
@@ -268,10 +593,32 @@ struct Caliper::GlobalData
     void init() {
         Caliper c(this, default_thread_scope, default_task_scope);
 
+        if (config.get("reclaim_nodes").to_bool()) {
+            if (config.get("async").to_bool()) {
+                Log(0).stream() << "reclaim_nodes is not supported with async snapshot processing, disabling it"
+                                << endl;
+            } else {
+                s_reclaim_nodes = true;
+                tree.enable_reclamation();
+            }
+        }
+
         // Create and set key & version attributes
 
         key_attr =
             c.create_attribute("cali.key.attribute", CALI_TYPE_USR, CALI_ATTR_HIDDEN);
+
+        // Connect async queue drain/shutdown before any services, so that
+        // services' flush and finish callbacks see all snapshots
+
+        init_async(c);
+
+        // Write all new context tree nodes before the services write
+        // their snapshot records
+
+        c.events().flush.connect([this](Caliper*, const EntryList*){
+                write_new_nodes();
+            });
             
         c.set(c.create_attribute("cali.caliper.version", CALI_TYPE_STRING, CALI_ATTR_SCOPE_PROCESS),
               Variant(CALI_TYPE_STRING, CALIPER_VERSION, sizeof(CALIPER_VERSION)));
@@ -284,8 +631,240 @@ struct Caliper::GlobalData
             RuntimeConfig::print( Log(2).stream() << "Configuration:\n" );
 
         c.events().post_init_evt(&c);        
+
+        start_async_workers();
+    }
+
+    // --- async snapshot processing
+
+    void init_async(Caliper& c) {
+        async = config.get("async").to_bool();
+
+        if (!async)
+            return;
+
+        std::string overflow = config.get("async_overflow").to_string();
+
+        if (overflow == "drop")
+            async_overflow = ASYNC_DROP;
+        else if (overflow == "inline")
+            async_overflow = ASYNC_INLINE;
+        else if (overflow == "block")
+            async_overflow = ASYNC_BLOCK;
+        else
+            Log(0).stream() << "async: unknown overflow policy \"" << overflow
+                            << "\", using \"block\"" << endl;
+
+        async_buffer_size = 1024 * config.get("async_buffer_size").to_uint();
+
+        c.events().finish_evt.connect([this](Caliper*){
+                stop_async_workers();
+            });
+    }
+
+    void start_async_workers() {
+        if (!async)
+            return;
+
+        int n = std::max(1, config.get("async_threads").to_int());
+
+        for (int i = 0; i < n; ++i)
+            async_workers.push_back(new AsyncWorker);
+        for (AsyncWorker* w : async_workers)
+            w->thread = std::thread(&GlobalData::async_worker_loop, this, w);
+
+        Log(1).stream() << "async: started " << n << " snapshot processing thread(s)" << endl;
+    }
+
+    void async_worker_loop(AsyncWorker* w) {
+        Scope*  scope = acquire_thread_scope(true);
+        scope->is_async_worker = true;
+
+        Caliper c(this, scope);
+
+        SnapshotRing::ProcessFn fn =
+            [this,&c](const EntryList* trigger_info, const EntryList* snapshot){
+                events.process_snapshot(&c, trigger_info, snapshot);
+            };
+
+        while (true) {
+            // read the stop flag before draining, so we get everything
+            // pushed before the stop
+            bool   stop  = async_stopped.load();
+            size_t count = 0;
+
+            {
+                std::lock_guard<std::mutex>
+                    g(w->lock);
+                std::lock_guard<::siglock>
+                    gs(scope->lock);
+                epoch_guard
+                    eg(scope);
+
+                for (auto it = w->queues.begin(); it != w->queues.end(); ) {
+                    AsyncQueue* q = *it;
+                    bool retired  = q->retired.load();
+
+                    count += q->ring.pop(fn, 1024);
+
+                    if (retired && q->ring.empty() && w->drainers.load() == 0) {
+                        delete q;
+                        it = w->queues.erase(it);
+                    } else
+                        ++it;
+                }
+            }
+
+            if (count == 0) {
+                if (stop)
+                    break;
+
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+
+        w->done.store(true);
+    }
+
+    AsyncQueue* create_async_queue() {
+        if (async_workers.empty())
+            return nullptr;
+
+        AsyncQueue*  q = new AsyncQueue(async_buffer_size);
+        AsyncWorker* w = async_workers[async_next_worker++ % async_workers.size()];
+
+        std::lock_guard<std::mutex>
+            g(w->lock);
+
+        w->queues.push_back(q);
+
+        return q;
+    }
+
+    /// \brief Hand snapshot over to the async workers.
+    ///   Returns \c false if the snapshot must be processed inline.
+    bool enqueue_snapshot(Scope* s, bool is_signal, const EntryList* trigger_info, const EntryList* sbuf) {
+        if (s->is_async_worker || async_stopped.load())
+            return false;
+
+        AsyncQueue* q = s->async_queue;
+
+        if (!q) {
+            if (is_signal)
+                return false;
+
+            q = create_async_queue();
+
+            if (!q)
+                return false;
+
+            s->async_queue = q;
+        }
+
+        if (q->ring.push(trigger_info, sbuf))
+            return true;
+
+        switch (async_overflow) {
+        case ASYNC_BLOCK:
+            // Don't wait for the worker in a signal handler: we might 
+            // have interrupted this thread's own push. Drop instead.
+            if (is_signal) {
+                ++async_num_dropped;
+                return true;
+            }
+            if (!q->ring.fits(trigger_info, sbuf))
+                return false;
+
+            while (!q->ring.push(trigger_info, sbuf))
+                if (async_stopped.load())
+                    return false;
+                else
+                    std::this_thread::yield();
+
+            return true;
+        case ASYNC_DROP:
+            ++async_num_dropped;
+            return true;
+        case ASYNC_INLINE:
+            break;
+        }
+
+        return false;
+    }
+
+    /// \brief Wait until the async workers processed all snapshots
+    ///   queued before the call.
+    void drain_async_queues() {
+        for (AsyncWorker* w : async_workers) {
+            // Record how much was pushed into each queue so far, and wait
+            // until the worker popped that much. Threads that keep pushing
+            // don't hold us up. The worker keeps retired queues around
+            // while we look at them.
+
+            std::vector< std::pair<AsyncQueue*, size_t> > targets;
+
+            {
+                std::lock_guard<std::mutex>
+                    g(w->lock);
+
+                ++w->drainers;
+
+                for (AsyncQueue* q : w->queues)
+                    targets.push_back(std::make_pair(q, q->ring.pushed()));
+            }
+
+            for (auto const& t : targets)
+                while (t.first->ring.popped() < t.second && !w->done.load())
+                    std::this_thread::yield();
+
+            --w->drainers;
+        }
+    }
+
+    /// \brief Wait until the async workers processed all snapshots queued
+    ///   so far, and keep them from processing more until 
+    ///   resume_async_workers(). Services can then flush the data the
+    ///   workers write into.
+    void pause_async_workers() {
+        drain_async_queues();
+
+        for (AsyncWorker* w : async_workers)
+            w->lock.lock();
+    }
+
+    void resume_async_workers() {
+        for (AsyncWorker* w : async_workers)
+            w->lock.unlock();
+    }
+
+    void stop_async_workers() {
+        if (async_stopped.exchange(true))
+            return;
+
+        for (AsyncWorker* w : async_workers)
+            if (w->thread.joinable())
+                w->thread.join();
+
+        if (async_num_dropped.load() > 0)
+            Log(1).stream() << "async: dropped " << async_num_dropped.load()
+                            << " snapshots" << endl;
     }
     
+    Attribute
+    make_attribute(const Node* node) {
+        return Attribute::make_attribute(attribute_info.get_or_create(node, tree.meta_attribute_ids()));
+    }
+
+    Node*
+    find_attribute_node(const std::string& name) {
+        std::lock_guard<std::mutex>
+            g(attribute_lock);
+
+        auto it = attribute_nodes.find(name);
+
+        return it == attribute_nodes.end() ? nullptr : it->second;
+    }
+
     const Attribute&
     get_key(const Attribute& attr) const {
         if (!automerge || attr.store_as_value() || !attr.is_autocombineable())
@@ -294,25 +873,88 @@ struct Caliper::GlobalData
         return key_attr;
     }
 
-    // temporary - will go away
+    /// \brief Publish the merged context of scope \a s after an update of \a attr
     void
-    write_new_attribute_nodes(WriteRecordFn write_rec) {
-        if (new_attributes.exchange(false)) {
-            std::lock_guard<std::mutex>
-                g(attribute_lock);
+    publish_context(Scope* s, const Attribute& attr) {
+        if (s->context_history && get_key(attr) == key_attr)
+            s->context_history->publish(s->blackboard.get_node(key_attr));
+    }
 
-            // special handling for bootstrap nodes: write all nodes in-order
-            if (!bootstrap_nodes_written.exchange(true))
-                for (cali_id_t id = 0; id <= type_attr.id(); ++id) {
-                    Node* node = tree.node(id);
+    void
+    write_new_nodes() {
+        std::lock_guard<std::mutex>
+            g(node_cursor_lock);
 
-                    if (node && !node->check_written())
-                        node->push_record(write_rec);
-                }
-            
-            for (auto &p : attribute_nodes)
-                p.second->write_path(write_rec);
+        node_cursor = tree.write_nodes(node_cursor, events.write_record);
+    }
+
+    // --- context tree node reclamation
+
+    void
+    collect_referenced_nodes(std::vector<const Node*>& refs) {
+        std::lock_guard<std::mutex>
+            g(scopes_lock);
+
+        for (Scope* s : scopes)
+            s->blackboard.collect_nodes(refs);
+    }
+
+    bool
+    grace_period_over(uint64_t epoch) {
+        std::lock_guard<std::mutex>
+            g(scopes_lock);
+
+        for (Scope* s : scopes) {
+            uint64_t e = s->epoch.load();
+
+            if (e != 0 && e <= epoch)
+                return false;
         }
+
+        return true;
+    }
+
+    /// \brief Free the context tree nodes retired in the previous pass if
+    ///   possible, and retire nodes that no blackboard references now.
+    ///   Only nodes that were written already are retired, and node ids
+    ///   are never reused, so the record stream stays consistent.
+    void
+    reclaim_nodes() {
+        std::lock_guard<std::mutex>
+            g(reclaim_lock);
+
+        std::vector<const Node*> refs;
+        size_t num_reclaimed = 0;
+
+        if (tree.has_retired_nodes()) {
+            // Threads that were in the Caliper API when the nodes were
+            // unlinked may still use them
+            if (!grace_period_over(reclaim_epoch)) {
+                Log(2).stream() << "Node reclamation postponed: threads still active" << endl;
+                return;
+            }
+
+            collect_referenced_nodes(refs);
+            num_reclaimed = tree.reclaim_retired_nodes(refs);
+            refs.clear();
+        }
+
+        cali_id_t limit = 0;
+
+        {
+            std::lock_guard<std::mutex>
+                g(node_cursor_lock);
+
+            limit = node_cursor;
+        }
+
+        collect_referenced_nodes(refs);
+
+        size_t num_retired = tree.retire_unreferenced_nodes(limit, refs);
+        reclaim_epoch = s_reclaim_epoch.fetch_add(1);
+
+        Log(2).stream() << "Node reclamation: reclaimed " << num_reclaimed
+                        << ", retired " << num_retired << " nodes" << endl;
     }
 };
 
@@ -331,6 +973,37 @@ const ConfigSet::Entry Caliper::GlobalData::s_configdata[] = {
       "Decreases the size of context records, but may increase\n"
       "the amount of metadata and reduce performance." 
     },
+    { "async", CALI_TYPE_BOOL, "false",
+      "Process snapshots asynchronously in background threads",
+      "Process snapshots asynchronously in background threads.\n"
+      "Snapshots are copied into a per-thread queue, and the snapshot\n"
+      "processing services (e.g., aggregate, trace) run in separate threads."
+    },
+    { "async_threads", CALI_TYPE_INT, "1",
+      "Number of asynchronous snapshot processing threads",
+      "Number of asynchronous snapshot processing threads"
+    },
+    { "async_buffer_size", CALI_TYPE_UINT, "256",
+      "Size of the per-thread asynchronous snapshot queue in KiB",
+      "Size of the per-thread asynchronous snapshot queue in KiB"
+    },
+    { "async_overflow", CALI_TYPE_STRING, "block",
+      "What to do when a snapshot queue is full: block, drop, or inline",
+      "What to do when a snapshot queue is full:\n"
+      "  block:  wait until the snapshot processing threads made room\n"
+      "  drop:   drop the snapshot\n"
+      "  inline: process the snapshot in the application thread"
+    },
+    { "reclaim_nodes", CALI_TYPE_BOOL, "false",
+      "Reclaim context tree nodes that are no longer referenced",
+      "Reclaim context tree nodes that are no longer referenced.\n"
+      "At each flush, context tree nodes that no blackboard references\n"
+      "are unlinked from the tree; their memory is reused after the next\n"
+      "flush. Keeps node memory bounded in long-running programs.\n"
+      "Interned strings are never freed, so memory still grows with the\n"
+      "number of distinct string values.\n"
+      "Not available with async snapshot processing."
+    },
     ConfigSet::Terminator 
 };
 
@@ -433,6 +1106,13 @@ Caliper::create_scope(cali_context_scope_t st)
         return 0;
     }
 
+    {
+        std::lock_guard<std::mutex>
+            g(mG->scopes_lock);
+
+        mG->scopes.push_back(s);
+    }
+
     mG->events.create_scope_evt(this, st);
 
     return s;
@@ -471,7 +1151,22 @@ Caliper::release_scope(Caliper::Scope* s)
     
     std::lock_guard<::siglock>
         g(m_thread_scope->lock);
+    epoch_guard
+        eg(m_thread_scope);
+
+    // the async worker deletes the queue once it is drained
+    if (s->async_queue) {
+        s->async_queue->retired.store(true);
+        s->async_queue = nullptr;
+    }
     
+    {
+        std::lock_guard<std::mutex>
+            g(mG->scopes_lock);
+
+        mG->scopes.erase(std::remove(mG->scopes.begin(), mG->scopes.end(), s), mG->scopes.end());
+    }
+
     mG->events.release_scope_evt(this, s->scope);
     // do NOT delete this because we may still need the node data in the scope's memory pool
     // delete ctx;
@@ -486,73 +1181,63 @@ Caliper::create_attribute(const std::string& name, cali_attr_type type, int prop
 {
     assert(mG != 0);
 
-    std::lock_guard<::siglock>
-        g(m_thread_scope->lock);
+    deferred_snapshot_guard
+        g(this, m_thread_scope);
     
     // Add default SCOPE_THREAD property if no other is set
     if (!(prop & CALI_ATTR_SCOPE_PROCESS) && !(prop & CALI_ATTR_SCOPE_TASK))
         prop |= CALI_ATTR_SCOPE_THREAD;
 
-    Node* node        = nullptr;
-    bool  created_now = false;
-
     // Check if an attribute with this name already exists
 
-    mG->attribute_lock.lock();
-
-    auto it = mG->attribute_nodes.find(name);
-    if (it != mG->attribute_nodes.end())
-        node = it->second;
-
-    mG->attribute_lock.unlock();
+    Node* node = mG->find_attribute_node(name);
 
     // Create attribute nodes
 
     if (!node) {
-        mG->events.pre_create_attr_evt(this, name, &type, &prop);
+        // Publish the attribute only after the create_attr callbacks ran:
+        // otherwise, other threads could use it before the services set it
+        // up (e.g., before the event service registered its event
+        // attributes), and their updates would go unnoticed. Callbacks may
+        // create attributes themselves.
+        std::lock_guard<std::recursive_mutex>
+            gc(mG->attribute_create_lock);
 
-        assert(type >= 0 && type <= CALI_MAXTYPE);
-        node = mG->tree.type_node(type);
-        assert(node);
+        // Another thread might have created it in the meantime
+        node = mG->find_attribute_node(name);
 
-        if (meta > 0)
-            node = mG->tree.get_path(meta, meta_attr, meta_val, node, &mG->process_scope->mempool);
+        if (!node) {
+            mG->events.pre_create_attr_evt(this, name, &type, &prop);
 
-        Attribute attr[2] { mG->prop_attr, mG->name_attr };
-        Variant   data[2] { { prop },      { CALI_TYPE_STRING, name.c_str(), name.size() } };
+            assert(type >= 0 && type <= CALI_MAXTYPE);
+            node = mG->tree.type_node(type);
+            assert(node);
 
-        if (prop == CALI_ATTR_DEFAULT)
-            node = mG->tree.get_path(1, &attr[1], &data[1], node, &mG->process_scope->mempool);
-        else
-            node = mG->tree.get_path(2, &attr[0], &data[0], node, &mG->process_scope->mempool);
+            if (meta > 0)
+                node = mG->tree.get_path(meta, meta_attr, meta_val, node, &mG->process_scope->mempool);
 
-        if (node) {
-            // Check again if attribute already exists; might have been created by 
-            // another thread in the meantime.
-            // We've created some redundant nodes then, but that's fine
-            mG->attribute_lock.lock();
+            Attribute attr[2] { mG->prop_attr, mG->name_attr };
+            Variant   data[2] { { prop },      { CALI_TYPE_STRING, name.c_str(), name.size() } };
 
-            auto it = mG->attribute_nodes.lower_bound(name);
+            if (prop == CALI_ATTR_DEFAULT)
+                node = mG->tree.get_path(1, &attr[1], &data[1], node, &mG->process_scope->mempool);
+            else
+                node = mG->tree.get_path(2, &attr[0], &data[0], node, &mG->process_scope->mempool);
 
-            if (it == mG->attribute_nodes.end() || it->first != name) {
-                mG->attribute_nodes.emplace_hint(it, name, node);
-                mG->new_attributes.store(true);
-                created_now = true;
-            } else
-                node = it->second;
+            if (node) {
+                mG->events.create_attr_evt(this, mG->make_attribute(node));
 
-            mG->attribute_lock.unlock();
+                std::lock_guard<std::mutex>
+                    g(mG->attribute_lock);
+
+                mG->attribute_nodes.insert(std::make_pair(name, node));
+            }
         }
     }
 
     // Create attribute object
 
-    Attribute attr = Attribute::make_attribute(node, mG->tree.meta_attribute_ids());
-
-    if (created_now)
-        mG->events.create_attr_evt(this, attr);
-
-    return attr;
+    return mG->make_attribute(node);
 }
 
 Attribute
@@ -560,21 +1245,10 @@ Caliper::get_attribute(const string& name) const
 {
     assert(mG != 0);
 
-    std::lock_guard<::siglock>
-        g(m_thread_scope->lock);
+    deferred_snapshot_guard
+        g(const_cast<Caliper*>(this), m_thread_scope);
     
-    Node* node = nullptr;
-
-    mG->attribute_lock.lock();
-
-    auto it = mG->attribute_nodes.find(name);
-
-    if (it != mG->attribute_nodes.end())
-        node = it->second;
-
-    mG->attribute_lock.unlock();
-
-    return Attribute::make_attribute(node, mG->tree.meta_attribute_ids());
+    return mG->make_attribute(mG->find_attribute_node(name));
 }
 
 Attribute 
@@ -582,8 +1256,15 @@ Caliper::get_attribute(cali_id_t id) const
 {
     assert(mG != 0);
     // no signal lock necessary
+
+    const AttributeInfo* info = mG->attribute_info.get(id);
+
+    if (info)
+        return Attribute::make_attribute(info);
+
+    // slow path: look up node and create descriptor
     
-    return Attribute::make_attribute(mG->tree.node(id), mG->tree.meta_attribute_ids());
+    return mG->make_attribute(mG->tree.node(id));
 }
 
 
@@ -594,8 +1275,8 @@ Caliper::pull_snapshot(int scopes, const EntryList* trigger_info, EntryList* sbu
 {
     assert(mG != 0);
 
-    std::lock_guard<::siglock>
-        g(m_thread_scope->lock);
+    deferred_snapshot_guard
+        g(this, m_thread_scope);
 
     // Save trigger info in snapshot buf
 
@@ -616,16 +1297,33 @@ Caliper::push_snapshot(int scopes, const EntryList* trigger_info)
 {
     assert(mG != 0);
     
-    std::lock_guard<::siglock>
-        g(m_thread_scope->lock);
+    deferred_snapshot_guard
+        g(this, m_thread_scope);
 
     EntryList::FixedEntryList<64> snapshot_data;
     EntryList sbuf(snapshot_data);
 
     pull_snapshot(scopes, trigger_info, &sbuf);
 
-    if (!m_is_signal)
-        mG->write_new_attribute_nodes(mG->events.write_record);
+    // Emit and reset accumulated values. Accumulators that don't fit 
+    // into the remaining snapshot space are kept for the next snapshot.
+
+    if ((scopes & CALI_SCOPE_THREAD) && m_thread_scope->num_accumulators > 0) {
+        Scope* s    = m_thread_scope;
+        size_t room = sbuf.capacity().n_immediate; // free entries left
+        size_t n    = std::min(s->num_accumulators, room);
+
+        for (size_t i = 0; i < n; ++i)
+            sbuf.append(s->accumulators[i].attr_id, Variant(s->accumulators[i].value));
+
+        for (size_t i = n; i < s->num_accumulators; ++i)
+            s->accumulators[i-n] = s->accumulators[i];
+
+        s->num_accumulators -= n;
+    }
+
+    if (mG->async && mG->enqueue_snapshot(m_thread_scope, m_is_signal, trigger_info, &sbuf))
+        return;
 
     mG->events.process_snapshot(this, trigger_info, &sbuf);
 }
@@ -633,10 +1331,24 @@ Caliper::push_snapshot(int scopes, const EntryList* trigger_info)
 void
 Caliper::flush(const EntryList* entry)
 {
-    std::lock_guard<::siglock>
-        g(m_thread_scope->lock);
+    mG->events.pre_flush_evt(this, entry);
+
+    deferred_snapshot_guard
+        g(this, m_thread_scope);
+
+    // An async worker can't wait for itself
+    bool pause = mG->async && !m_thread_scope->is_async_worker;
+
+    if (pause)
+        mG->pause_async_workers();
 
     mG->events.flush(this, entry);
+
+    if (pause)
+        mG->resume_async_workers();
+
+    if (s_reclaim_nodes)
+        mG->reclaim_nodes();
 }
 
 // --- Annotation interface
@@ -649,8 +1361,8 @@ Caliper::begin(const Attribute& attr, const Variant& data)
     if (!mG || attr == Attribute::invalid)
         return CALI_EINV;
 
-    std::lock_guard<::siglock>
-        g(m_thread_scope->lock);
+    deferred_snapshot_guard
+        g(this, m_thread_scope);
 
     // invoke callbacks
     if (!attr.skip_events())
@@ -658,6 +1370,8 @@ Caliper::begin(const Attribute& attr, const Variant& data)
 
     Scope* s = scope(attr2caliscope(attr));
     ContextBuffer* sb = &s->blackboard;
+
+    g.process_pending();
     
     if (attr.store_as_value())
         ret = sb->set(attr, data);
@@ -667,6 +1381,57 @@ Caliper::begin(const Attribute& attr, const Variant& data)
                                              sb->get_node(mG->get_key(attr)),
                                              &s->mempool));
 
+    mG->publish_context(s, attr);
+
+    // invoke callbacks
+    if (!attr.skip_events())
+        mG->events.post_begin_evt(this, attr, data);
+
+    return ret;
+}
+
+cali_err
+Caliper::begin(const Attribute& attr, const Variant& data, std::atomic<Node*> cache[], size_t n)
+{
+    if (!mG || attr == Attribute::invalid)
+        return CALI_EINV;
+    // Cached nodes may have been reclaimed
+    if (attr.store_as_value() || n == 0 || s_reclaim_nodes)
+        return begin(attr, data);
+
+    deferred_snapshot_guard
+        g(this, m_thread_scope);
+
+    // invoke callbacks
+    if (!attr.skip_events())
+        mG->events.pre_begin_evt(this, attr, data);
+
+    Scope* s = scope(attr2caliscope(attr));
+    ContextBuffer* sb = &s->blackboard;
+
+    const Attribute& key = mG->get_key(attr);
+    Node* parent = sb->get_node(key);
+
+    if (!parent)
+        parent = mG->tree.root();
+
+    // The cache is indexed by parent node. Nodes never change their parent,
+    // so a cached node is valid iff its parent is our current node.
+
+    std::atomic<Node*>& slot = cache[(reinterpret_cast<uintptr_t>(parent) >> 4) % n];
+    Node* node = slot.load(std::memory_order_acquire);
+
+    if (!node || node->parent() != parent) {
+        node = mG->tree.get_path(1, &attr, &data, parent, &s->mempool);
+        slot.store(node, std::memory_order_release);
+    }
+
+    g.process_pending();
+
+    cali_err ret = sb->set_node(key, node);
+
+    mG->publish_context(s, attr);
+
     // invoke callbacks
     if (!attr.skip_events())
         mG->events.post_begin_evt(this, attr, data);
@@ -687,8 +1452,8 @@ Caliper::end(const Attribute& attr)
 
     Variant val;
 
-    std::lock_guard<::siglock>
-        g(m_thread_scope->lock);
+    deferred_snapshot_guard
+        g(this, m_thread_scope);
 
     // invoke callbacks
     if (!attr.skip_events()) {
@@ -697,6 +1462,8 @@ Caliper::end(const Attribute& attr)
         if (!e.is_empty()) // prevent callbacks in end-before-begin situations 
             mG->events.pre_end_evt(this, attr, e.value());
     }
+
+    g.process_pending();
     
     if (attr.store_as_value())
         ret = sb->unset(attr);
@@ -704,7 +1471,11 @@ Caliper::end(const Attribute& attr)
         Node* node = sb->get_node(mG->get_key(attr));
 
         if (node) {
-            node = mG->tree.remove_first_in_path(node, attr, &s->mempool);
+            // fast path: attr is innermost in path, so we can simply pop it
+            if (node->attribute() == attr.id())
+                node = node->parent();
+            else
+                node = mG->tree.remove_first_in_path(node, attr, &s->mempool);
                 
             if (node == mG->tree.root())
                 ret = sb->unset(mG->get_key(attr));
@@ -716,6 +1487,8 @@ Caliper::end(const Attribute& attr)
             Log(0).stream() << "error: trying to end inactive attribute " << attr.name() << endl;
     }
 
+    mG->publish_context(s, attr);
+
     // invoke callbacks
     if (!attr.skip_events())
         mG->events.post_end_evt(this, attr, val);
@@ -723,6 +1496,43 @@ Caliper::end(const Attribute& attr)
     return ret;
 }
 
+cali_err
+Caliper::accumulate(const Attribute& attr, double val)
+{
+    if (!mG || attr == Attribute::invalid)
+        return CALI_EINV;
+    if (!attr.store_as_value()) {
+        Log(0).stream() << "error: accumulate() invoked with non-immediate attribute " << attr.name() << endl;
+        return CALI_EINV;
+    }
+    if (attr.type() != CALI_TYPE_DOUBLE) {
+        Log(0).stream() << "error: accumulate() invoked with non-double attribute " << attr.name() << endl;
+        return CALI_ETYPE;
+    }
+
+    deferred_snapshot_guard
+        g(this, m_thread_scope);
+
+    Scope*    s  = m_thread_scope;
+    cali_id_t id = attr.id();
+
+    for (size_t i = 0; i < s->num_accumulators; ++i)
+        if (s->accumulators[i].attr_id == id) {
+            s->accumulators[i].value += val;
+            return CALI_SUCCESS;
+        }
+
+    if (s->num_accumulators >= Scope::MAX_ACCUMULATORS)
+        return CALI_EBUSY;
+
+    s->accumulators[s->num_accumulators].attr_id = id;
+    s->accumulators[s->num_accumulators].value   = val;
+
+    ++s->num_accumulators;
+
+    return CALI_SUCCESS;
+}
+
 cali_err 
 Caliper::set(const Attribute& attr, const Variant& data)
 {
@@ -731,8 +1541,8 @@ Caliper::set(const Attribute& attr, const Variant& data)
     if (!mG || attr == Attribute::invalid)
         return CALI_EINV;
 
-    std::lock_guard<::siglock>
-        g(m_thread_scope->lock);
+    deferred_snapshot_guard
+        g(this, m_thread_scope);
 
     Scope* s = scope(attr2caliscope(attr));
     ContextBuffer* sb = &s->blackboard;
@@ -741,6 +1551,8 @@ Caliper::set(const Attribute& attr, const Variant& data)
     if (!attr.skip_events())
         mG->events.pre_set_evt(this, attr, data);
 
+    g.process_pending();
+
     if (attr.store_as_value())
         ret = sb->set(attr, data);
     else {
@@ -748,6 +1560,8 @@ Caliper::set(const Attribute& attr, const Variant& data)
         
         ret = sb->set_node(key, mG->tree.replace_first_in_path(sb->get_node(key), attr, data, &s->mempool));
     }
+
+    mG->publish_context(s, attr);
     
     // invoke callbacks
     if (!attr.skip_events())
@@ -765,8 +1579,8 @@ Caliper::set_path(const Attribute& attr, size_t n, const Variant* data) {
     if (!mG || attr == Attribute::invalid)
         return CALI_EINV;
 
-    std::lock_guard<::siglock>
-        g(m_thread_scope->lock);
+    deferred_snapshot_guard
+        g(this, m_thread_scope);
 
     Scope* s = scope(attr2caliscope(attr));
     ContextBuffer* sb = &s->blackboard;
@@ -775,6 +1589,8 @@ Caliper::set_path(const Attribute& attr, size_t n, const Variant* data) {
     if (!attr.skip_events())
         mG->events.pre_set_evt(this, attr, data[n-1]);
 
+    g.process_pending();
+
     if (attr.store_as_value()) {
         Log(0).stream() << "error: set_path() invoked with immediate-value attribute " << attr.name() << endl;
         ret = CALI_EINV;
@@ -784,6 +1600,8 @@ Caliper::set_path(const Attribute& attr, size_t n, const Variant* data) {
         ret = sb->set_node(key,
                            mG->tree.replace_all_in_path(sb->get_node(key), attr, n, data, &s->mempool));
     }
+
+    mG->publish_context(s, attr);
     
     // invoke callbacks
     if (!attr.skip_events())
@@ -802,8 +1620,8 @@ Caliper::get(const Attribute& attr)
     if (!mG || attr == Attribute::invalid)
         return Entry::empty;
 
-    std::lock_guard<::siglock>
-        g(m_thread_scope->lock);
+    deferred_snapshot_guard
+        g(this, m_thread_scope);
 
     ContextBuffer* sb = &(scope(attr2caliscope(attr))->blackboard);
 
@@ -815,13 +1633,37 @@ Caliper::get(const Attribute& attr)
     return e;
 }
 
+// --- Published context API
+
+Caliper::ContextHistory*
+Caliper::publish_context()
+{
+    deferred_snapshot_guard
+        g(this, m_thread_scope);
+
+    Scope* s = m_thread_scope;
+
+    if (!s->context_history) {
+        s->context_history = new ContextHistory;
+        s->context_history->publish(s->blackboard.get_node(mG->key_attr));
+    }
+
+    return s->context_history;
+}
+
+bool
+Caliper::find_context(const ContextHistory* history, uint64_t time, Node** node)
+{
+    return history->find(time, node);
+}
+
 // --- Generic entry API
 
 void
 Caliper::make_entrylist(size_t n, const Attribute* attr, const Variant* value, EntryList& list) 
 {
-    std::lock_guard<::siglock>
-        g(m_thread_scope->lock);
+    deferred_snapshot_guard
+        g(this, m_thread_scope);
 
     Node* node = 0;
 
@@ -841,8 +1683,8 @@ Caliper::make_entry(const Attribute& attr, const Variant& value)
     if (attr == Attribute::invalid)
         return Entry::empty;
     
-    std::lock_guard<::siglock>
-        g(m_thread_scope->lock);
+    deferred_snapshot_guard
+        g(this, m_thread_scope);
 
     Entry entry { Entry::empty };
 
@@ -857,8 +1699,8 @@ Caliper::make_entry(const Attribute& attr, const Variant& value)
 Node*
 Caliper::make_tree_entry(size_t n, const Node* nodelist[])
 {
-    std::lock_guard<::siglock>
-        g(m_thread_scope->lock);
+    deferred_snapshot_guard
+        g(this, m_thread_scope);
 
     return mG->tree.get_path(n, nodelist, nullptr, &m_thread_scope->mempool);
 }
@@ -870,6 +1712,23 @@ Caliper::node(cali_id_t id)
     return mG->tree.node(id);
 }
 
+void
+Caliper::write_new_nodes()
+{
+    mG->write_new_nodes();
+}
+
+const char*
+Caliper::intern_string(const char* str, size_t len)
+{
+    assert(mG != 0);
+    
+    deferred_snapshot_guard
+        g(this, m_thread_scope);
+
+    return mG->tree.intern_string(str, len);
+}
+
 // --- Events interface
 
 Caliper::Events&
@@ -881,8 +1740,10 @@ Caliper::events()
 Variant
 Caliper::exchange(const Attribute& attr, const Variant& data)
 {
-    std::lock_guard<::siglock>
-        g(m_thread_scope->lock);
+    deferred_snapshot_guard
+        g(this, m_thread_scope);
+
+    g.process_pending();
 
     return scope(attr2caliscope(attr))->blackboard.exchange(attr, data);
 }
@@ -935,6 +1796,63 @@ Caliper::sigsafe_instance()
     return Caliper(GlobalData::sG, thread_scope, task_scope, true /* is signal */);
 }
 
+bool
+Caliper::defer_snapshot(int scopes, const EntryList* trigger_info)
+{
+    if (GlobalData::s_init_lock != 0)
+        return false;
+
+    Scope* s = GlobalData::sG->acquire_thread_scope(false);
+
+    if (!s || !s->lock.is_locked())
+        return false;
+
+    int h = s->deferred_head;
+
+    if (h - s->deferred_tail >= Scope::MAX_DEFERRED)
+        return false;
+
+    // Pairs with the release fence in process_deferred(): don't write
+    // the slot before the thread finished copying it out
+    std::atomic_signal_fence(std::memory_order_acquire);
+
+    Scope::DeferredSnapshot* d = &s->deferred[h % Scope::MAX_DEFERRED];
+
+    d->scopes = scopes;
+    d->n      = 0;
+
+    if (trigger_info) {
+        EntryList::Sizes sizes = trigger_info->size();
+        EntryList::Data  addr  = trigger_info->data();
+
+        if (sizes.n_nodes > 0 || sizes.n_immediate > Scope::MAX_DEFERRED_ENTRIES)
+            return false;
+
+        for (size_t i = 0; i < sizes.n_immediate; ++i) {
+            const Variant& v = addr.immediate_data[i];
+
+            // can't keep pointers to (likely stack-allocated) strings
+            if (v.type() == CALI_TYPE_STRING || v.type() == CALI_TYPE_USR || v.type() == CALI_TYPE_INV)
+                return false;
+
+            d->attr[i]  = addr.immediate_attr[i];
+            d->type[i]  = v.type();
+            d->size[i]  = v.size();
+            d->value[i] = 0;
+
+            memcpy(&d->value[i], v.data(), std::min<size_t>(v.size(), sizeof(uint64_t)));
+        }
+
+        d->n = sizes.n_immediate;
+    }
+
+    std::atomic_signal_fence(std::memory_order_release);
+
+    s->deferred_head = h + 1;
+
+    return true;
+}
+
 void
 Caliper::release()
 {
@@ -43,6 +43,7 @@
 #include "Variant.h"
 #include "util/callback.hpp"
 
+#include <atomic>
 #include <utility>
 
 
@@ -61,6 +62,7 @@ class Caliper
 public:
 
     struct Scope;
+    struct ContextHistory;
 
     typedef Scope* (*ScopeCallbackFn)(Caliper*, bool can_create);
 
@@ -140,6 +142,7 @@ public:
         snapshot_cbvec         snapshot;
         process_snapshot_cbvec process_snapshot;
 
+        flush_cbvec            pre_flush_evt;
         flush_cbvec            flush;
         write_record_cbvec     write_record;
     };
@@ -165,12 +168,37 @@ public:
     // --- Annotation API
 
     cali_err  begin(const Attribute& attr, const Variant& data);
+    /// \brief Begin \a attr : \a data, using the \a n -entry \a cache of
+    ///   previously created child nodes to avoid the context tree search.
+    ///   The cache must only be used with the same attribute and value.
+    cali_err  begin(const Attribute& attr, const Variant& data, std::atomic<Node*> cache[], size_t n);
     cali_err  end(const Attribute& attr);
     cali_err  set(const Attribute& attr, const Variant& data);
     cali_err  set_path(const Attribute& attr, size_t n, const Variant data[]);
 
     Variant   exchange(const Attribute& attr, const Variant& data);
 
+    /// \brief Add \a val to the thread-local accumulator for \a attr.
+    ///   The accumulated value is added to the next snapshot pushed on this
+    ///   thread as an immediate entry, and then reset. Does not trigger
+    ///   events. \a attr must be an immediate (\c CALI_ATTR_ASVALUE)
+    ///   attribute of type double.
+    cali_err  accumulate(const Attribute& attr, double val);
+
+    // --- Published context API
+
+    /// \brief Start publishing the calling thread's context. From now on,
+    ///   each change of the thread's merged context tree path is recorded
+    ///   with its \c CLOCK_MONOTONIC time in the returned history. Other
+    ///   threads can look up the context at a given time with
+    ///   find_context(), e.g. to attribute samples taken by the kernel.
+    ContextHistory* publish_context();
+    /// \brief Find the context tree node \a history's thread was in at
+    ///   \c CLOCK_MONOTONIC time \a time (in nanoseconds), and store it in
+    ///   \a node (\c nullptr for no context). Returns \c false if \a time
+    ///   is older than the history.
+    static bool     find_context(const ContextHistory* history, uint64_t time, Node** node);
+
     // --- Direct metadata / data access API
 
     void      make_entrylist(size_t n, const Attribute* attr, const Variant* value, EntryList& list);
@@ -180,7 +208,19 @@ public:
     Node*     make_tree_entry(size_t n, const Node* nodelist[]);
 
     /// \brief return node by id
-    Node*     node(cali_id_t id); // EXTREMELY SLOW, use with caution!
+    Node*     node(cali_id_t id);
+
+    /// \brief Write records of all context tree nodes created since the
+    ///   last call to the write_record stream. The flush event does this
+    ///   before any service's flush callbacks run. Services that write
+    ///   snapshot records must call it again once they stopped recording
+    ///   into the buffer they write, so that all referenced nodes precede
+    ///   the records.
+    void      write_new_nodes();
+
+    /// \brief Return the process-wide interned copy of string \a str.
+    ///   Interned strings are compared by address in the context tree.
+    const char* intern_string(const char* str, size_t len);
 
     // --- Query API
 
@@ -211,6 +251,17 @@ public:
     
     static Caliper sigsafe_instance();
 
+    /// \brief Defer a snapshot from a signal handler that could not get a
+    ///   sigsafe_instance() because the thread's Caliper data was locked.
+    ///   The snapshot is pushed when the thread releases the lock, or
+    ///   right before the interrupted update changes the blackboard.
+    ///   \a trigger_info may contain up to four non-string immediate entries.
+    ///   Snapshot callbacks (e.g., the timestamp service) run when the 
+    ///   snapshot is pushed, so they see that time, not the time the 
+    ///   snapshot was deferred. Returns \c false if the snapshot could
+    ///   not be deferred.
+    static bool    defer_snapshot(int scopes, const EntryList* trigger_info);
+
     friend struct GlobalData;
 };
 
@@ -44,7 +44,9 @@
 #include <util/spinlock.hpp>
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstring>
 #include <mutex>
 #include <vector>
 
@@ -60,6 +62,33 @@ struct ContextBuffer::ContextBufferImpl
 
     mutable util::spinlock m_lock;
 
+    // Seqlock-versioned copy of the snapshot entries for lock-free
+    // snapshot(). Only kept for versioned buffers (e.g., process scope).
+    // Values are kept as raw bits so that torn reads are harmless.
+
+    struct Version {
+        static const size_t MAX_ENTRIES = 64;
+
+        std::atomic<unsigned> seq;
+
+        bool           valid; // false if the entries don't fit
+        size_t         n_nodes;
+        size_t         n_immediate;
+
+        Node*          nodes[MAX_ENTRIES];
+        cali_id_t      attr[MAX_ENTRIES];
+        cali_attr_type type[MAX_ENTRIES];
+        size_t         size[MAX_ENTRIES];
+        const void*    ptr[MAX_ENTRIES];
+        uint64_t       value[MAX_ENTRIES];
+
+        Version()
+            : seq(0), valid(true), n_nodes(0), n_immediate(0)
+            { }
+    };
+
+    std::unique_ptr<Version> m_version;
+
     // m_attr array stores attribute ids for context nodes, hidden entries, and immediate entries
     // m_data array stores context node ids, hidden values, and immediate data
     // boundaries within the arrays are defined by m_num_nodes and m_num_hidden
@@ -80,8 +109,9 @@ struct ContextBuffer::ContextBufferImpl
     
     // --- constructor
 
-    ContextBufferImpl() 
-        : m_num_nodes   { 0 },
+    ContextBufferImpl(bool versioned) 
+        : m_version     { versioned ? new Version : nullptr },
+          m_num_nodes   { 0 },
           m_num_hidden  { 0 },
           m_max_entries { 0 }
         {
@@ -92,6 +122,114 @@ struct ContextBuffer::ContextBufferImpl
             m_nodes.reserve(32);
         }
 
+    // --- seqlock versioning
+
+    /// \brief Publish current snapshot entries. Must hold m_lock.
+    void publish() {
+        Version* v = m_version.get();
+
+        if (!v)
+            return;
+
+        unsigned seq = v->seq.load(std::memory_order_relaxed);
+
+        v->seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        size_t p = m_num_nodes + m_num_hidden;
+        size_t n = m_data.size() - p;
+
+        v->valid = (m_num_nodes <= Version::MAX_ENTRIES && n <= Version::MAX_ENTRIES);
+
+        if (v->valid) {
+            std::copy(m_nodes.begin(), m_nodes.begin() + m_num_nodes, v->nodes);
+            std::copy(m_keys.begin() + p, m_keys.end(), v->attr);
+
+            for (size_t i = 0; i < n; ++i) {
+                const Variant& d = m_data[p+i];
+
+                v->type[i]  = d.type();
+                v->size[i]  = d.size();
+                v->ptr[i]   = nullptr;
+                v->value[i] = 0;
+
+                switch (d.type()) {
+                case CALI_TYPE_INV:
+                    if (!d.empty()) // string-constructed variants can't be copied raw
+                        v->valid = false;
+                    break;
+                case CALI_TYPE_USR:
+                case CALI_TYPE_STRING:
+                    v->ptr[i]   = d.data();
+                    break;
+                default:
+                    memcpy(&v->value[i], d.data(), std::min(d.size(), sizeof(uint64_t)));
+                }
+            }
+
+            v->n_nodes     = m_num_nodes;
+            v->n_immediate = n;
+        }
+
+        v->seq.store(seq + 2, std::memory_order_release);
+    }
+
+    /// \brief Read published snapshot entries without locking.
+    ///   Returns \c false if the versioned copy can't be used.
+    bool versioned_snapshot(EntryList* sbuf) const {
+        const Version* v = m_version.get();
+
+        Node*          nodes[Version::MAX_ENTRIES];
+        cali_id_t      attr[Version::MAX_ENTRIES];
+        cali_attr_type type[Version::MAX_ENTRIES];
+        size_t         size[Version::MAX_ENTRIES];
+        const void*    ptr[Version::MAX_ENTRIES];
+        uint64_t       value[Version::MAX_ENTRIES];
+
+        size_t         n_nodes = 0, n_immediate = 0;
+        unsigned       seq;
+
+        do {
+            seq = v->seq.load(std::memory_order_acquire);
+
+            if (seq & 1)
+                continue;
+            if (!v->valid)
+                return false;
+
+            n_nodes     = std::min(v->n_nodes,     Version::MAX_ENTRIES);
+            n_immediate = std::min(v->n_immediate, Version::MAX_ENTRIES);
+
+            memcpy(nodes, v->nodes, n_nodes     * sizeof(Node*));
+            memcpy(attr,  v->attr,  n_immediate * sizeof(cali_id_t));
+            memcpy(type,  v->type,  n_immediate * sizeof(cali_attr_type));
+            memcpy(size,  v->size,  n_immediate * sizeof(size_t));
+            memcpy(ptr,   v->ptr,   n_immediate * sizeof(const void*));
+            memcpy(value, v->value, n_immediate * sizeof(uint64_t));
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((seq & 1) || v->seq.load(std::memory_order_relaxed) != seq);
+
+        Variant data[Version::MAX_ENTRIES];
+
+        for (size_t i = 0; i < n_immediate; ++i)
+            switch (type[i]) {
+            case CALI_TYPE_INV:
+                break;
+            case CALI_TYPE_USR:
+            case CALI_TYPE_STRING:
+                data[i] = Variant(type[i], ptr[i], size[i]);
+                break;
+            default:
+                data[i] = Variant(type[i], &value[i], size[i]);
+            }
+
+        if (n_nodes + n_immediate > 0)
+            sbuf->append(n_nodes, nodes, n_immediate, attr, data);
+
+        return true;
+    }
+
     // --- interface
 
     Variant get(const Attribute& attr) const {
@@ -137,6 +275,8 @@ struct ContextBuffer::ContextBufferImpl
             if (it != m_keys.end()) {
                 ret = m_data[it-m_keys.begin()];
                 m_data[it-m_keys.begin()] = value;
+
+                publish();
             }
         }
         
@@ -190,6 +330,8 @@ struct ContextBuffer::ContextBufferImpl
         }
 
         m_max_entries = std::max(m_max_entries, m_attr.size());
+
+        publish();
         
         return CALI_SUCCESS;
     }
@@ -239,6 +381,8 @@ struct ContextBuffer::ContextBufferImpl
 
         m_max_entries = std::max(m_max_entries, m_attr.size());
 
+        publish();
+
         return CALI_SUCCESS;
     }
 
@@ -263,12 +407,17 @@ struct ContextBuffer::ContextBufferImpl
                 --m_num_nodes;
             else if (n < m_num_nodes + m_num_hidden)
                 --m_num_hidden;
+
+            publish();
         }
 
         return ret;
     }
 
     void snapshot(EntryList* sbuf) const {
+        if (m_version && versioned_snapshot(sbuf))
+            return;
+
         std::lock_guard<util::spinlock> lock(m_lock);
 
         cali::Node* const*   nodeptr = m_num_nodes > 0 ? m_nodes.data() : nullptr;
@@ -283,6 +432,12 @@ struct ContextBuffer::ContextBufferImpl
             sbuf->append(m_num_nodes, nodeptr, n, attrptr, dataptr);
     }
 
+    void collect_nodes(std::vector<const Node*>& nodes) const {
+        std::lock_guard<util::spinlock> lock(m_lock);
+
+        nodes.insert(nodes.end(), m_nodes.begin(), m_nodes.end());
+    }
+
     void push_record(WriteRecordFn fn) {
         std::lock_guard<util::spinlock> lock(m_lock);
 
@@ -303,13 +458,15 @@ struct ContextBuffer::ContextBufferImpl
     }
 };
 
+const size_t ContextBuffer::ContextBufferImpl::Version::MAX_ENTRIES;
+
 
 //
 // --- ContextBuffer public interface
 //
 
-ContextBuffer::ContextBuffer()
-    : mP(new ContextBufferImpl)
+ContextBuffer::ContextBuffer(bool versioned)
+    : mP(new ContextBufferImpl(versioned))
 { }
 
 ContextBuffer::~ContextBuffer()
@@ -352,6 +509,11 @@ void ContextBuffer::snapshot(EntryList* sbuf) const
     mP->snapshot(sbuf);
 }
 
+void ContextBuffer::collect_nodes(std::vector<const Node*>& nodes) const
+{
+    mP->collect_nodes(nodes);
+}
+
 void ContextBuffer::push_record(WriteRecordFn fn) const
 {
     mP->push_record(fn);
@@ -41,6 +41,7 @@
 
 #include <iostream>
 #include <memory>
+#include <vector>
 
 namespace cali
 {
@@ -57,7 +58,12 @@ class ContextBuffer
 
 public:
 
-    ContextBuffer();
+    /// \brief Create a context buffer.
+    /// \param versioned Keep a seqlock-versioned copy of the snapshot
+    ///   entries, so that snapshot() does not need to take the lock. This
+    ///   makes updates more expensive; use it for rarely updated buffers
+    ///   that many threads read, like the process scope.
+    ContextBuffer(bool versioned = false);
     ~ContextBuffer();
 
     /// @name set / unset entries
@@ -78,6 +84,9 @@ public:
 
     void     snapshot(EntryList* sbuf) const;
 
+    /// \brief Append all context tree nodes in the buffer to \a nodes
+    void     collect_nodes(std::vector<const Node*>& nodes) const;
+
     /// @}
     /// @name Serialization API
     /// @{
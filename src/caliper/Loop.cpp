@@ -0,0 +1,187 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file Loop.cpp
+/// Loop class implementation
+
+#include "Loop.h"
+#include "Region.h"
+
+#include "Caliper.h"
+
+#include <Log.h>
+#include <Variant.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+using namespace std;
+using namespace cali;
+
+
+struct Loop::Impl {
+    std::string            m_iter_attr_name;
+
+    cali_loop_bucketing    m_mode;
+    int                    m_bucket_size;
+
+    Region                 m_region;
+
+    std::atomic<cali_id_t> m_iter_attr_id;
+    std::mutex             m_init_lock;
+
+    Impl(const char* name, cali_loop_bucketing mode, int bucket_size)
+        : m_iter_attr_name(std::string("iteration#") + name),
+          m_mode(mode),
+          m_bucket_size(bucket_size > 0 ? bucket_size : 1),
+          m_region(name, "loop"),
+          m_iter_attr_id(CALI_INV_ID)
+        { }
+
+    Attribute get_iteration_attribute(Caliper& c) {
+        cali_id_t id = m_iter_attr_id.load();
+
+        if (id != CALI_INV_ID)
+            return c.get_attribute(id);
+
+        std::lock_guard<std::mutex>
+            g(m_init_lock);
+
+        id = m_iter_attr_id.load();
+
+        if (id != CALI_INV_ID)
+            return c.get_attribute(id);
+
+        Attribute attr =
+            c.create_attribute(m_iter_attr_name, CALI_TYPE_INT, CALI_ATTR_ASVALUE);
+
+        if (attr.type() != CALI_TYPE_INT) {
+            Log(0).stream() << "Loop: attribute " << m_iter_attr_name
+                            << " is not an integer attribute" << endl;
+            return Attribute::invalid;
+        }
+
+        m_iter_attr_id.store(attr.id());
+
+        return attr;
+    }
+
+    int bucket(int i) const {
+        if (i <= 0)
+            return i;
+        if (m_mode == CALI_LOOP_BUCKET_LOG2) {
+            int b = 1;
+
+            while (b <= i / 2)
+                b *= 2;
+
+            return b;
+        }
+
+        return i - i % m_bucket_size;
+    }
+
+    bool is_bucketed() const {
+        return m_mode == CALI_LOOP_BUCKET_LOG2 || m_bucket_size > 1;
+    }
+
+    void iteration(int i) {
+        Caliper   c;
+        Attribute attr = get_iteration_attribute(c);
+
+        if (attr == Attribute::invalid)
+            return;
+
+        Variant   v(bucket(i));
+
+        // Only update at bucket boundaries. The blackboard holds the
+        // current bucket for this thread, so handles can be shared between
+        // threads.
+        if (is_bucketed() && c.get(attr).value() == v)
+            return;
+
+        c.set(attr, v);
+    }
+
+    void end() {
+        Caliper   c;
+        Attribute attr = get_iteration_attribute(c);
+
+        if (attr != Attribute::invalid && !c.get(attr).value().empty())
+            c.end(attr);
+
+        m_region.end();
+    }
+};
+
+
+/// \class Loop
+///
+/// \brief Annotation handle for loops
+///
+/// Like Regions, Loops are meant to be created once and used many times.
+/// Example:
+/// \code
+/// static cali::Loop mainloop("mainloop", CALI_LOOP_BUCKET_LINEAR, 10);
+///
+/// mainloop.begin();
+/// for (int i = 0; i < N; ++i) {
+///     mainloop.iteration(i);
+///     // ...
+/// }
+/// mainloop.end();
+/// \endcode
+
+Loop::Loop(const char* name, cali_loop_bucketing mode, int bucket_size)
+    : pI(new Impl(name, mode, bucket_size))
+{ }
+
+Loop::~Loop()
+{
+    delete pI;
+}
+
+void Loop::begin()
+{
+    pI->m_region.begin();
+}
+
+void Loop::iteration(int i)
+{
+    pI->iteration(i);
+}
+
+void Loop::end()
+{
+    pI->end();
+}
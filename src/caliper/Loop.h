@@ -0,0 +1,90 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file Loop.h
+/// Caliper C++ loop annotation interface
+
+//
+// --- NOTE: This interface must be C++98 only!
+//
+
+#ifndef CALI_LOOP_H
+#define CALI_LOOP_H
+
+#include "cali_types.h"
+
+namespace cali
+{
+
+/// \brief Annotation handle for a loop
+///
+/// A Loop marks a loop region \a name of the \c loop attribute, and records
+/// the current iteration number as an immediate value of the
+/// \c iteration#name attribute. Iteration numbers do not create context
+/// tree nodes.
+///
+/// Optionally, iterations are grouped into buckets: the recorded value is
+/// the first iteration number of the current bucket, and the iteration
+/// attribute is only updated (and snapshots triggered by the event service
+/// only taken) when a new bucket starts. Without bucketing (the default),
+/// each iteration() call updates the attribute, so the event service takes
+/// a snapshot per iteration.
+
+class Loop
+{
+    struct Impl;
+    Impl*  pI;
+
+    Loop(const Loop&);
+    Loop& operator = (const Loop&);
+
+public:
+
+    /// \brief Create a handle for loop \a name.
+    /// \param mode Bucketing mode. With \c CALI_LOOP_BUCKET_LINEAR, each
+    ///   bucket holds \a bucket_size iterations. With \c CALI_LOOP_BUCKET_LOG2,
+    ///   buckets start at iteration 0, 1, 2, 4, 8, ...
+
+    Loop(const char* name,
+         cali_loop_bucketing mode = CALI_LOOP_BUCKET_LINEAR,
+         int bucket_size = 1);
+
+    ~Loop();
+
+    void begin();
+    void iteration(int i);
+    void end();
+};
+
+} // namespace cali
+
+#endif
@@ -38,16 +38,71 @@
 #include "MetadataTree.h"
 
 #include "MemoryPool.h"
+#include "StringTable.h"
 
 #include "Attribute.h"
+#include "Log.h"
 #include "Node.h"
 #include "Variant.h"
 
+#include "util/spinlock.hpp"
+
+#include <algorithm>
 #include <atomic>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 using namespace cali;
 
+namespace
+{
+
+// The node journal maps node ids onto a two-level table of fixed-size
+// chunks. Node ids are handed out sequentially, so the journal lists all
+// nodes in creation order, and parents always precede their children.
+
+constexpr size_t JOURNAL_CHUNK_BITS = 14;
+constexpr size_t JOURNAL_CHUNK_SIZE = 1 << JOURNAL_CHUNK_BITS;
+constexpr size_t JOURNAL_NUM_CHUNKS = 16384;
+
+struct JournalChunk {
+    std::atomic<Node*> nodes[JOURNAL_CHUNK_SIZE];
+    size_t             num_reclaimed;
+
+    JournalChunk()
+        : num_reclaimed(0)
+    {
+        for (size_t i = 0; i < JOURNAL_CHUNK_SIZE; ++i)
+            nodes[i].store(nullptr, std::memory_order_relaxed);
+    }
+};
+
+// With node reclamation, nodes are allocated individually in power-of-two
+// sized slots, and reclaimed slots are kept in per-size free lists.
+
+constexpr size_t MIN_SLOT_SIZE  = 64;
+constexpr size_t NUM_SLOT_SIZES = 8; // 64 bytes .. 8 KiB
+
+struct FreeSlot {
+    FreeSlot* next;
+};
+
+inline size_t
+slot_class(size_t size)
+{
+    size_t k = 0;
+
+    while (k < NUM_SLOT_SIZES && (MIN_SLOT_SIZE << k) < size)
+        ++k;
+
+    return k;
+}
+
+} // namespace [anonymous]
+
 struct MetadataTree::MetadataTreeImpl
 {
     Node                   m_root;
@@ -57,6 +112,32 @@ struct MetadataTree::MetadataTreeImpl
 
     MetaAttributeIDs       m_meta_attributes;
 
+    /// Interned strings: all string-type node data in the tree points here
+    StringTable            m_strings;
+
+    /// Bootstrap nodes (ids 0-10): type nodes and the meta-attributes.
+    /// The attribute names point into m_strings, so these are initialized
+    /// after it.
+    Node                   m_bootstrap_type_nodes[9];
+    Node                   m_bootstrap_attr_nodes[4];
+
+    /// Append-only journal of all nodes, indexed by id
+    std::atomic<JournalChunk*> m_journal[JOURNAL_NUM_CHUNKS];
+    std::atomic<bool>          m_journal_full;
+
+    /// Node reclamation. Nodes with ids below m_reclaim_limit may have been
+    /// reclaimed; their journal entries are null.
+    bool                   m_reclaim;
+    std::atomic<cali_id_t> m_reclaim_limit;
+
+    FreeSlot*              m_free_slots[NUM_SLOT_SIZES];
+    util::spinlock         m_free_lock;
+
+    /// Topmost nodes of unlinked subtrees waiting to be reclaimed
+    std::vector<Node*>              m_retired_units;
+    std::unordered_set<const Node*> m_retired;
+    std::vector<JournalChunk*>      m_retired_chunks;
+
     //
     // --- Constructor
     //
@@ -64,8 +145,33 @@ struct MetadataTree::MetadataTreeImpl
     MetadataTreeImpl()
         : m_root(CALI_INV_ID, CALI_INV_ID, Variant()),
           m_node_id(0),
-          m_meta_attributes(MetaAttributeIDs::invalid)
+          m_meta_attributes(MetaAttributeIDs::invalid),
+          m_bootstrap_type_nodes {
+              {  0, 9, { CALI_TYPE_USR    },  },
+              {  1, 9, { CALI_TYPE_INT    },  },
+              {  2, 9, { CALI_TYPE_UINT   },  },
+              {  3, 9, { CALI_TYPE_STRING },  },
+              {  4, 9, { CALI_TYPE_ADDR   },  },
+              {  5, 9, { CALI_TYPE_DOUBLE },  },
+              {  6, 9, { CALI_TYPE_BOOL   },  },
+              {  7, 9, { CALI_TYPE_TYPE   },  },
+              { CALI_INV_ID, CALI_INV_ID, { } } 
+          },
+          m_bootstrap_attr_nodes {
+              {  8, 8,  { CALI_TYPE_STRING, m_strings.intern("cali.attribute.name", 19), 19 } },
+              {  9, 8,  { CALI_TYPE_STRING, m_strings.intern("cali.attribute.type", 19), 19 } },
+              { 10, 8,  { CALI_TYPE_STRING, m_strings.intern("cali.attribute.prop", 19), 19 } },
+              { CALI_INV_ID, CALI_INV_ID, { } } 
+          },
+          m_journal_full(false),
+          m_reclaim(false),
+          m_reclaim_limit(0)
         {
+            for (size_t c = 0; c < JOURNAL_NUM_CHUNKS; ++c)
+                m_journal[c].store(nullptr, std::memory_order_relaxed);
+            for (size_t k = 0; k < NUM_SLOT_SIZES; ++k)
+                m_free_slots[k] = nullptr;
+
             bootstrap();
         }
 
@@ -82,25 +188,10 @@ struct MetadataTree::MetadataTreeImpl
 
     void
     bootstrap() {
-        // Create initial nodes
-
-        static Node bootstrap_type_nodes[] = {
-            {  0, 9, { CALI_TYPE_USR    },  },
-            {  1, 9, { CALI_TYPE_INT    },  },
-            {  2, 9, { CALI_TYPE_UINT   },  },
-            {  3, 9, { CALI_TYPE_STRING },  },
-            {  4, 9, { CALI_TYPE_ADDR   },  },
-            {  5, 9, { CALI_TYPE_DOUBLE },  },
-            {  6, 9, { CALI_TYPE_BOOL   },  },
-            {  7, 9, { CALI_TYPE_TYPE   },  },
-            { CALI_INV_ID, CALI_INV_ID, { } } 
-        };
-        static Node bootstrap_attr_nodes[] = {
-            {  8, 8,  { CALI_TYPE_STRING, "cali.attribute.name",  19 } },
-            {  9, 8,  { CALI_TYPE_STRING, "cali.attribute.type",  19 } },
-            { 10, 8,  { CALI_TYPE_STRING, "cali.attribute.prop",  19 } },
-            { CALI_INV_ID, CALI_INV_ID, { } } 
-        };
+        // Link the initial nodes
+
+        Node* bootstrap_type_nodes = m_bootstrap_type_nodes;
+        Node* bootstrap_attr_nodes = m_bootstrap_attr_nodes;
 
         m_node_id.store(11);
 
@@ -126,12 +217,279 @@ struct MetadataTree::MetadataTreeImpl
             // Append to type node
             m_type_nodes[p.type]->append(p.node);
         }
+
+        for (Node* node = bootstrap_type_nodes ; node->id() != CALI_INV_ID; ++node)
+            journal_append(node);
+        for (Node* node = bootstrap_attr_nodes ; node->id() != CALI_INV_ID; ++node)
+            journal_append(node);
+    }
+
+    //
+    // --- Node journal
+    //
+
+    /// \brief Publish \a node in the journal. Call once the node is linked
+    ///   into the tree.
+    void
+    journal_append(Node* node) {
+        cali_id_t id = node->id();
+        size_t    c  = id >> JOURNAL_CHUNK_BITS;
+
+        if (c >= JOURNAL_NUM_CHUNKS) {
+            if (!m_journal_full.exchange(true))
+                Log(0).stream() << "Node journal is full: context tree nodes with id "
+                                << JOURNAL_NUM_CHUNKS * JOURNAL_CHUNK_SIZE
+                                << " and above will not be written" << std::endl;
+
+            return;
+        }
+
+        JournalChunk* chunk = m_journal[c].load(std::memory_order_acquire);
+
+        if (!chunk) {
+            JournalChunk* tmp = new JournalChunk;
+
+            if (m_journal[c].compare_exchange_strong(chunk, tmp, std::memory_order_acq_rel))
+                chunk = tmp;
+            else
+                delete tmp;
+        }
+
+        chunk->nodes[id & (JOURNAL_CHUNK_SIZE-1)].store(node, std::memory_order_release);
+    }
+
+    Node*
+    journal_get(cali_id_t id) const {
+        size_t c = id >> JOURNAL_CHUNK_BITS;
+
+        if (c >= JOURNAL_NUM_CHUNKS)
+            return nullptr;
+
+        JournalChunk* chunk = m_journal[c].load(std::memory_order_acquire);
+
+        return chunk ? chunk->nodes[id & (JOURNAL_CHUNK_SIZE-1)].load(std::memory_order_acquire) : nullptr;
+    }
+
+    cali_id_t
+    write_nodes(cali_id_t from, WriteRecordFn fn) const {
+        // Ids below the current id counter are taken; wait for nodes still
+        // under construction to show up so that we write them in order.
+        // Missing nodes below the reclaim limit have been reclaimed.
+        cali_id_t end   = std::min<cali_id_t>(m_node_id.load(), JOURNAL_NUM_CHUNKS * JOURNAL_CHUNK_SIZE);
+        cali_id_t limit = m_reclaim_limit.load();
+        cali_id_t id    = from;
+
+        for ( ; id < end; ++id) {
+            Node* node = nullptr;
+
+            while (!(node = journal_get(id)) && id >= limit)
+                std::this_thread::yield();
+
+            if (node)
+                node->push_record(fn);
+        }
+
+        return id;
+    }
+
+    //
+    // --- Node memory
+    //
+
+    /// \brief Size of the node object, including padding
+    static size_t
+    node_size() {
+        return sizeof(Node) + (8 - sizeof(Node)%8);
+    }
+
+    /// \brief Size of the memory block \a node was created in
+    static size_t
+    node_block_size(const Node* node) {
+        size_t      size = node_size();
+        const char* dptr = static_cast<const char*>(node->data().data());
+
+        // Copied data is stored right behind the node
+        if (dptr == reinterpret_cast<const char*>(node) + size)
+            size += node->data().size() + (8 - node->data().size()%8);
+
+        return size;
+    }
+
+    void*
+    allocate_node(MemoryPool* pool, size_t size) {
+        size_t k = slot_class(size);
+
+        if (k >= NUM_SLOT_SIZES)
+            return pool->allocate(size);
+
+        // Never block here: we may be in a signal handler
+
+        if (m_free_lock.try_lock()) {
+            FreeSlot* slot = m_free_slots[k];
+
+            if (slot)
+                m_free_slots[k] = slot->next;
+
+            m_free_lock.unlock();
+
+            if (slot)
+                return slot;
+        }
+
+        return pool->allocate(MIN_SLOT_SIZE << k);
+    }
+
+    void
+    free_node(Node* node) {
+        size_t k = slot_class(node_block_size(node));
+
+        node->~Node();
+
+        // Oversized blocks stay in the memory pool
+        if (k >= NUM_SLOT_SIZES)
+            return;
+
+        FreeSlot* slot = reinterpret_cast<FreeSlot*>(node);
+
+        std::lock_guard<util::spinlock>
+            g(m_free_lock);
+
+        slot->next = m_free_slots[k];
+        m_free_slots[k] = slot;
+    }
+
+    //
+    // --- Node reclamation
+    //
+
+    static void
+    collect_subtree(Node* node, std::vector<Node*>& nodes) {
+        size_t first = nodes.size();
+
+        nodes.push_back(node);
+
+        for (size_t i = first; i < nodes.size(); ++i)
+            for (Node* child = nodes[i]->first_child(); child; child = child->next_sibling())
+                nodes.push_back(child);
+    }
+
+    size_t
+    retire_unreferenced_nodes(cali_id_t limit, const std::vector<const Node*>& refs) {
+        if (!m_retired_units.empty())
+            return 0;
+
+        std::unordered_set<const Node*> live;
+
+        live.insert(&m_root);
+
+        auto mark = [&live](const Node* node) {
+            for ( ; node && live.insert(node).second; node = node->parent())
+                ;
+        };
+
+        for (const Node* node : refs)
+            mark(node);
+
+        // Only context nodes below the root are candidates. Nodes that
+        // weren't written yet are live.
+
+        std::vector<Node*> nodes;
+
+        for (Node* node = m_root.first_child(); node; node = node->next_sibling())
+            collect_subtree(node, nodes);
+
+        for (const Node* node : nodes)
+            if (node->id() >= limit)
+                mark(node);
+
+        if (m_reclaim_limit.load() < limit)
+            m_reclaim_limit.store(limit);
+
+        size_t num_retired = 0;
+
+        for (Node* node : nodes)
+            if (live.count(node) == 0) {
+                m_retired.insert(node);
+                ++num_retired;
+
+                if (live.count(node->parent()) > 0) {
+                    node->parent()->remove(node);
+                    m_retired_units.push_back(node);
+                }
+            }
+
+        return num_retired;
+    }
+
+    size_t
+    reclaim_retired_nodes(const std::vector<const Node*>& refs) {
+        // Journal chunks retired in the previous pass are unreachable now
+
+        for (JournalChunk* chunk : m_retired_chunks)
+            delete chunk;
+
+        m_retired_chunks.clear();
+
+        std::unordered_set<const Node*> refset(refs.begin(), refs.end());
+
+        size_t num_reclaimed = 0;
+
+        for (Node* unit : m_retired_units) {
+            std::vector<Node*> nodes;
+            bool               keep = false;
+
+            collect_subtree(unit, nodes);
+
+            // Keep the subtree if it is referenced again, or if new nodes
+            // were created in it since it was unlinked
+
+            for (const Node* node : nodes) {
+                if (m_retired.count(node) == 0 || refset.count(node) > 0)
+                    keep = true;
+
+                m_retired.erase(node);
+            }
+
+            if (keep) {
+                unit->parent()->append(unit);
+                continue;
+            }
+
+            for (Node* node : nodes) {
+                cali_id_t     id    = node->id();
+                JournalChunk* chunk = m_journal[id >> JOURNAL_CHUNK_BITS].load();
+
+                chunk->nodes[id & (JOURNAL_CHUNK_SIZE-1)].store(nullptr);
+
+                if (++chunk->num_reclaimed == JOURNAL_CHUNK_SIZE) {
+                    m_journal[id >> JOURNAL_CHUNK_BITS].store(nullptr);
+                    m_retired_chunks.push_back(chunk);
+                }
+
+                free_node(node);
+                ++num_reclaimed;
+            }
+        }
+
+        m_retired_units.clear();
+        m_retired.clear();
+
+        return num_reclaimed;
     }
 
     //
     // --- Modifying tree operations
     //
 
+    /// \brief Do we need to deep-copy \a data into node memory?
+    /// Interned strings are referenced directly.
+
+    bool
+    needs_copy(cali_attr_type type, const Variant& data) const {
+        return type == CALI_TYPE_USR || 
+            (type == CALI_TYPE_STRING && !m_strings.is_interned(static_cast<const char*>(data.data()), data.size()));
+    }
+
     /// \brief Creates \param n new nodes hierarchically under \param parent 
 
     Node*
@@ -142,21 +500,26 @@ struct MetadataTree::MetadataTreeImpl
         const size_t pad   = align - sizeof(Node)%align;
         size_t total_size  = n * (sizeof(Node) + pad);
 
-        bool   copy        = (attr.type() == CALI_TYPE_USR || attr.type() == CALI_TYPE_STRING);
-
-        if (copy)
-            for (size_t i = 0; i < n; ++i)
+        for (size_t i = 0; i < n; ++i)
+            if (needs_copy(attr.type(), data[i]))
                 total_size += data[i].size() + (align - data[i].size()%align);
 
-        char* ptr  = static_cast<char*>(pool->allocate(total_size));
+        // With reclamation, nodes are allocated individually
+
+        char* ptr  = m_reclaim ? nullptr : static_cast<char*>(pool->allocate(total_size));
         Node* node = nullptr;
 
         // Create nodes
 
         for (size_t i = 0; i < n; ++i) {
+            bool   copy      { needs_copy(attr.type(), data[i]) };
+
             const void* dptr { data[i].data() };
             size_t size      { data[i].size() }; 
 
+            if (m_reclaim)
+                ptr = static_cast<char*>(allocate_node(pool, sizeof(Node)+pad + (copy ? size+(align-size%align) : 0)));
+
             if (copy)
                 dptr = memcpy(ptr+sizeof(Node)+pad, dptr, size);
 
@@ -166,6 +529,8 @@ struct MetadataTree::MetadataTreeImpl
             if (parent)
                 parent->append(node);
 
+            journal_append(node);
+
             ptr   += sizeof(Node)+pad + (copy ? size+(align-size%align) : 0);
             parent = node;
         }
@@ -173,47 +538,34 @@ struct MetadataTree::MetadataTreeImpl
         return node;
     }
 
-    /// \brief Creates \param n new nodes (with different attributes) hierarchically under \param parent
+    /// \brief Retreive the child node with \param attr : \param data under \param parent.
+    /// Creates a new node if necessary. String values are interned and compared by address.
 
     Node*
-    create_path(MemoryPool* pool, size_t n, const Attribute* attr, const Variant* data, Node* parent = nullptr) {
-        // Calculate and allocate required memory
-
-        const size_t align = 8;
-        const size_t pad   = align - sizeof(Node)%align;
-
-        size_t total_size  = 0;
-
-        for (size_t i = 0; i < n; ++i) {
-            total_size += n * (sizeof(Node) + pad);
-
-            if (attr[i].type() == CALI_TYPE_USR || attr[i].type() == CALI_TYPE_STRING)
-                total_size += data[i].size() + (align - data[i].size()%align);
-        }
-
-        char* ptr  = static_cast<char*>(pool->allocate(total_size));
+    get_child(MemoryPool* pool, const Attribute& attr, const Variant& data, Node* parent) {
         Node* node = nullptr;
 
-        // Create nodes
+        if (attr.type() == CALI_TYPE_STRING) {
+            const char* str = m_strings.intern(static_cast<const char*>(data.data()), data.size());
 
-        for (size_t i = 0; i < n; ++i) {
-            bool   copy { attr[i].type() == CALI_TYPE_USR || attr[i].type() == CALI_TYPE_STRING };
+            if (str) {
+                for (node = parent->first_child(); node && !node->equals_ptr(attr.id(), str); node = node->next_sibling())
+                    ;
 
-            const void* dptr { data[i].data() };
-            size_t size      { data[i].size() }; 
-
-            if (copy)
-                dptr = memcpy(ptr+sizeof(Node)+pad, dptr, size);
+                if (!node) {
+                    Variant v(CALI_TYPE_STRING, str, data.size());
+                    node = create_path(pool, attr, 1, &v, parent);
+                }
 
-            node = new(ptr) 
-                Node(m_node_id.fetch_add(1), attr[i].id(), Variant(attr[i].type(), dptr, size));
+                return node;
+            }
+        }
 
-            if (parent)
-                parent->append(node);
+        for (node = parent->first_child(); node && !node->equals(attr.id(), data); node = node->next_sibling())
+            ;
 
-            ptr   += sizeof(Node)+pad + (copy ? size+(align-size%align) : 0);
-            parent = node;
-        }
+        if (!node)
+            node = create_path(pool, attr, 1, &data, parent);
 
         return node;
     }
@@ -226,6 +578,13 @@ struct MetadataTree::MetadataTreeImpl
         Node*  node = parent ? parent : &m_root;
         size_t base = 0;
 
+        if (attr.type() == CALI_TYPE_STRING) {
+            for (size_t i = 0; node && i < n; ++i)
+                node = get_child(pool, attr, data[i], node);
+
+            return node;
+        }
+
         for (size_t i = 0; i < n; ++i) {
             parent = node;
 
@@ -250,22 +609,9 @@ struct MetadataTree::MetadataTreeImpl
     Node*
     get_path(MemoryPool* pool, size_t n, const Attribute* attr, const Variant* data, Node* parent = nullptr) {
         Node*  node = parent ? parent : &m_root;
-        size_t base = 0;
 
-        for (size_t i = 0; i < n; ++i) {
-            parent = node;
-
-            for (node = parent->first_child(); node && !node->equals(attr[i].id(), data[i]); node = node->next_sibling())
-                ;
-
-            if (!node)
-                break;
-
-            ++base;
-        }
-
-        if (!node)
-            node = create_path(pool, n-base, attr+base, data+base, parent);
+        for (size_t i = 0; node && i < n; ++i)
+            node = get_child(pool, attr[i], data[i], node);
 
         return node;
     }
@@ -295,12 +641,27 @@ struct MetadataTree::MetadataTreeImpl
             ;
 
         if (!node) {
-            char* ptr = static_cast<char*>(pool->allocate(sizeof(Node)));
+            Variant data = from->data();
+            char*   ptr  = nullptr;
+
+            if (m_reclaim) {
+                // The original node may be reclaimed before the copy:
+                // deep-copy data stored in the original node's memory block
+                size_t size = node_block_size(from);
+
+                ptr = static_cast<char*>(allocate_node(pool, size));
+
+                if (size > node_size())
+                    data = Variant(data.type(), memcpy(ptr+node_size(), data.data(), data.size()), data.size());
+            } else {
+                ptr = static_cast<char*>(pool->allocate(sizeof(Node)));
+            }
 
             node = new(ptr) 
-                Node(m_node_id.fetch_add(1), from->attribute(), from->data());
+                Node(m_node_id.fetch_add(1), from->attribute(), data);
             
             parent->append(node);
+            journal_append(node);
         }
 
         return node;
@@ -371,23 +732,7 @@ struct MetadataTree::MetadataTreeImpl
     
     Node* 
     node(cali_id_t id) {
-        Node* ret = nullptr;
-
-        for (Node* typenode : m_type_nodes)
-            for (auto &n : *typenode)
-                if (n.id() == id) {
-                    ret = &n;
-                    break;
-                }
-
-        if (!ret) 
-            for (auto &n : m_root)
-                if (n.id() == id) {
-                    ret = &n;
-                    break;
-                }
-
-        return ret;
+        return journal_get(id);
     }
 
     //
@@ -482,6 +827,52 @@ MetadataTree::meta_attribute_ids() const
     return &(mP->m_meta_attributes);
 }
 
+const char*
+MetadataTree::intern_string(const char* str, size_t len)
+{
+    return mP->m_strings.intern(str, len);
+}
+
 //
 // --- I/O ---
 //
+
+cali_id_t
+MetadataTree::write_nodes(cali_id_t from, WriteRecordFn fn) const
+{
+    return mP->write_nodes(from, fn);
+}
+
+cali_id_t
+MetadataTree::num_nodes() const
+{
+    return mP->m_node_id.load();
+}
+
+//
+// --- Node reclamation ---
+//
+
+void
+MetadataTree::enable_reclamation()
+{
+    mP->m_reclaim = true;
+}
+
+size_t
+MetadataTree::retire_unreferenced_nodes(cali_id_t limit, const std::vector<const Node*>& refs)
+{
+    return mP->retire_unreferenced_nodes(limit, refs);
+}
+
+size_t
+MetadataTree::reclaim_retired_nodes(const std::vector<const Node*>& refs)
+{
+    return mP->reclaim_retired_nodes(refs);
+}
+
+bool
+MetadataTree::has_retired_nodes() const
+{
+    return !mP->m_retired_units.empty();
+}
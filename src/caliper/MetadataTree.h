@@ -36,6 +36,7 @@
 #include "cali_types.h"
 
 #include <memory>
+#include <vector>
 
 namespace cali
 {
@@ -98,7 +99,46 @@ namespace cali
         const MetaAttributeIDs*
         meta_attribute_ids() const;
 
+        /// \brief Return interned copy of string \a str with length \a len
+        const char*
+        intern_string(const char* str, size_t len);
+
         // --- I/O ---
+
+        /// \brief Write records of all nodes with ids from \a from up to
+        ///   the current number of nodes, in creation order.
+        ///   Returns the id to continue from next time.
+        cali_id_t
+        write_nodes(cali_id_t from, WriteRecordFn fn) const;
+
+        /// \brief Number of node ids handed out so far
+        cali_id_t
+        num_nodes() const;
+
+        // --- Node reclamation ---
+
+        /// \brief Allocate nodes individually so that they can be
+        ///   reclaimed. Call before any context nodes are created.
+        void
+        enable_reclamation();
+
+        /// \brief Unlink all context nodes with ids below \a limit that are
+        ///   neither in \a refs nor ancestors of nodes in \a refs or of nodes
+        ///   with ids from \a limit. Does nothing while previously retired
+        ///   nodes are pending. Returns the number of retired nodes.
+        size_t
+        retire_unreferenced_nodes(cali_id_t limit, const std::vector<const Node*>& refs);
+
+        /// \brief Free the nodes unlinked by retire_unreferenced_nodes().
+        ///   No thread may still use nodes it found in the tree before they
+        ///   were unlinked. Unlinked subtrees with nodes in \a refs, or with
+        ///   new child nodes, are linked back into the tree instead.
+        ///   Returns the number of freed nodes.
+        size_t
+        reclaim_retired_nodes(const std::vector<const Node*>& refs);
+
+        bool
+        has_retired_nodes() const;
     };
 
 } // namespace cali
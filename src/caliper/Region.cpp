@@ -0,0 +1,172 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file Region.cpp
+/// Region class implementation
+
+#include "Region.h"
+
+#include "Caliper.h"
+
+#include <Log.h>
+#include <Variant.h>
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <string>
+
+using namespace std;
+using namespace cali;
+
+
+struct Region::Impl {
+    static const size_t CACHE_SIZE = 8;
+
+    std::string            m_attr_name;
+    std::string            m_name;
+    Variant                m_data;
+
+    std::atomic<cali_id_t> m_attr_id;
+    std::atomic<bool>      m_failed; // attribute has the wrong type
+    std::mutex             m_init_lock;
+    std::atomic<Node*>     m_cache[CACHE_SIZE];
+
+    Impl(const char* name, const char* attr_name)
+        : m_attr_name(attr_name),
+          m_name(name),
+          m_data(CALI_TYPE_STRING, m_name.c_str(), m_name.size()),
+          m_attr_id(CALI_INV_ID),
+          m_failed(false)
+        {
+            for (size_t i = 0; i < CACHE_SIZE; ++i)
+                m_cache[i].store(nullptr);
+        }
+
+    Attribute get_attribute(Caliper& c) {
+        cali_id_t id = m_attr_id.load();
+
+        if (id != CALI_INV_ID)
+            return c.get_attribute(id);
+        if (m_failed.load())
+            return Attribute::invalid;
+
+        std::lock_guard<std::mutex>
+            g(m_init_lock);
+
+        id = m_attr_id.load();
+
+        if (id != CALI_INV_ID)
+            return c.get_attribute(id);
+        if (m_failed.load())
+            return Attribute::invalid;
+
+        Attribute attr = c.create_attribute(m_attr_name, CALI_TYPE_STRING);
+
+        if (attr == Attribute::invalid)
+            return attr;
+
+        if (attr.type() != CALI_TYPE_STRING) {
+            // Don't try (and complain) again on every begin/end
+            Log(0).stream() << "Region: attribute " << m_attr_name
+                            << " is not a string attribute" << endl;
+            m_failed.store(true);
+
+            return Attribute::invalid;
+        }
+
+        // Point our data to the interned string, so the tree can
+        // compare it by address
+        m_data = Variant(CALI_TYPE_STRING, c.intern_string(m_name.c_str(), m_name.size()), m_name.size());
+        m_attr_id.store(attr.id());
+
+        return attr;
+    }
+
+    void begin() {
+        Caliper   c;
+        Attribute attr = get_attribute(c);
+
+        if (attr != Attribute::invalid)
+            c.begin(attr, m_data, m_cache, CACHE_SIZE);
+    }
+
+    void end() {
+        Caliper   c;
+        Attribute attr = get_attribute(c);
+
+        if (attr != Attribute::invalid)
+            c.end(attr);
+    }
+};
+
+
+/// \class Region
+///
+/// \brief Annotation handle for regions with a constant name
+///
+/// Regions are meant to be created once, e.g. as static objects, and used
+/// many times. Example:
+/// \code
+/// static cali::Region solve_region("solve");
+///
+/// solve_region.begin();
+///   // ...
+/// solve_region.end();
+/// \endcode
+/// The \c CALI_REGION(name) macro creates a static Region object and a
+/// guard that marks the rest of the enclosing C++ scope:
+/// \code
+/// void solve() {
+///     CALI_REGION("solve");
+///     // ...
+/// }
+/// \endcode
+
+Region::Region(const char* name, const char* attr_name)
+    : pI(new Impl(name, attr_name))
+{ }
+
+Region::~Region()
+{
+    delete pI;
+}
+
+void Region::begin()
+{
+    pI->begin();
+}
+
+void Region::end()
+{
+    pI->end();
+}
@@ -0,0 +1,104 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// \file Region.h
+/// Caliper C++ static region annotation interface
+
+//
+// --- NOTE: This interface must be C++98 only!
+//
+
+#ifndef CALI_REGION_H
+#define CALI_REGION_H
+
+#include "cali_types.h"
+
+namespace cali
+{
+
+/// \brief Annotation handle for a region with a constant name
+///
+/// A Region looks up its attribute and value only once, and caches the
+/// context tree nodes it creates. Entering and leaving a region that was
+/// seen before under the same parent context does not search the tree.
+
+class Region
+{
+    struct Impl;
+    Impl*  pI;
+
+    Region(const Region&);
+    Region& operator = (const Region&);
+
+public:
+
+    /// \brief Create a handle for region \a name of the string attribute \a attr_name.
+    ///   The default attribute is \c region.
+
+    Region(const char* name, const char* attr_name = "region");
+
+    ~Region();
+
+    /// \brief Scope guard to \c begin() a region and automatically \c end() it at
+    ///   the end of the C++ scope.
+
+    class Guard {
+        Region& m_region;
+
+        Guard(const Guard&);
+        Guard& operator = (const Guard&);
+
+    public:
+
+        Guard(Region& r)
+            : m_region(r)
+            { m_region.begin(); }
+
+        ~Guard()
+            { m_region.end(); }
+    };
+
+    void begin();
+    void end();
+};
+
+} // namespace cali
+
+#define CALI_REGION_CONCAT_(a, b) a##b
+#define CALI_REGION_CONCAT(a, b)  CALI_REGION_CONCAT_(a, b)
+
+/// \brief Mark the rest of the enclosing C++ scope as region \a name
+#define CALI_REGION(name) \
+    static cali::Region CALI_REGION_CONCAT(cali_region_, __LINE__)(name); \
+    cali::Region::Guard CALI_REGION_CONCAT(cali_region_guard_, __LINE__)(CALI_REGION_CONCAT(cali_region_, __LINE__))
+
+#endif
@@ -0,0 +1,340 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///
+/// @file SnapshotRing.cpp
+/// SnapshotRing class implementation
+///
+
+#include "SnapshotRing.h"
+
+#include "EntryList.h"
+
+#include <Variant.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+using namespace cali;
+
+namespace
+{
+
+const std::size_t MAX_ENTRIES = 64;
+const std::size_t ALIGN       = 16;
+
+/// Record header. Records are ALIGN-byte aligned, so a header always fits
+/// before the end of the buffer.
+struct RecordHeader {
+    uint32_t len;       ///< total record length in bytes, including header
+    uint32_t kind;      ///< PAD, or SNAPSHOT with or without trigger info
+    uint16_t n[4];      ///< trigger nodes, trigger immediates, snapshot nodes, snapshot immediates
+};
+
+enum RecordKind {
+    PAD              = 0,
+    SNAPSHOT         = 1,
+    SNAPSHOT_TRIGGER = 3
+};
+
+/// Immediate entry header, followed by the (8-byte aligned) value payload
+struct ImmediateHeader {
+    uint64_t attr;
+    uint64_t type;
+    uint64_t size;
+};
+
+inline std::size_t
+align(std::size_t n, std::size_t a)
+{
+    return (n + a - 1) & ~(a - 1);
+}
+
+inline std::size_t
+payload_size(const Variant& v)
+{
+    switch (v.type()) {
+    case CALI_TYPE_INV:
+        return 0;
+    case CALI_TYPE_USR:
+    case CALI_TYPE_STRING:
+        return align(v.size(), 8);
+    default:
+        return 8;
+    }
+}
+
+std::size_t
+list_size(const EntryList* list)
+{
+    if (!list)
+        return 0;
+
+    EntryList::Sizes sizes = list->size();
+    EntryList::Data  addr  = list->data();
+
+    std::size_t len = sizes.n_nodes * sizeof(const Node*);
+
+    for (std::size_t i = 0; i < sizes.n_immediate; ++i)
+        len += sizeof(ImmediateHeader) + payload_size(addr.immediate_data[i]);
+
+    return len;
+}
+
+unsigned char*
+write_list(const EntryList* list, unsigned char* p)
+{
+    if (!list)
+        return p;
+
+    EntryList::Sizes sizes = list->size();
+    EntryList::Data  addr  = list->data();
+
+    std::size_t nbytes = sizes.n_nodes * sizeof(const Node*);
+
+    std::memcpy(p, addr.node_entries, nbytes);
+    p += nbytes;
+
+    for (std::size_t i = 0; i < sizes.n_immediate; ++i) {
+        const Variant&  v   = addr.immediate_data[i];
+        ImmediateHeader hdr = { addr.immediate_attr[i],
+                                static_cast<uint64_t>(v.type()),
+                                static_cast<uint64_t>(v.size()) };
+
+        std::memcpy(p, &hdr, sizeof(hdr));
+        p += sizeof(hdr);
+
+        std::size_t plen = payload_size(v);
+
+        if (plen > 0) {
+            std::size_t n = (v.type() == CALI_TYPE_USR || v.type() == CALI_TYPE_STRING) ? v.size() : 8;
+
+            if (v.data() && n > 0)
+                std::memcpy(p, v.data(), n);
+
+            p += plen;
+        }
+    }
+
+    return p;
+}
+
+const unsigned char*
+read_list(const unsigned char* p, std::size_t n_nodes, std::size_t n_immediate, EntryList* list)
+{
+    Node*     nodes[MAX_ENTRIES];
+    cali_id_t attr[MAX_ENTRIES];
+    Variant   data[MAX_ENTRIES];
+
+    std::memcpy(nodes, p, n_nodes * sizeof(Node*));
+    p += n_nodes * sizeof(Node*);
+
+    for (std::size_t i = 0; i < n_immediate; ++i) {
+        ImmediateHeader hdr;
+
+        std::memcpy(&hdr, p, sizeof(hdr));
+        p += sizeof(hdr);
+
+        cali_attr_type type = static_cast<cali_attr_type>(hdr.type);
+
+        attr[i] = hdr.attr;
+
+        if (type != CALI_TYPE_INV)
+            data[i] = Variant(type, p, static_cast<std::size_t>(hdr.size));
+
+        p += payload_size(data[i]);
+    }
+
+    list->append(n_nodes, nodes, n_immediate, attr, data);
+
+    return p;
+}
+
+} // namespace [anonymous]
+
+
+struct SnapshotRing::SnapshotRingImpl
+{
+    unsigned char*           buf;
+    std::size_t              mask;
+
+    std::atomic<std::size_t> head; // written by producer
+    std::atomic<std::size_t> tail; // written by consumer
+
+    SnapshotRingImpl(std::size_t size)
+        : head(0), tail(0)
+        {
+            std::size_t cap = 4096;
+
+            while (cap < size)
+                cap *= 2;
+
+            buf  = new unsigned char[cap];
+            mask = cap - 1;
+        }
+
+    ~SnapshotRingImpl() {
+        delete[] buf;
+    }
+
+    static std::size_t record_size(const EntryList* trigger_info, const EntryList* snapshot) {
+        return align(sizeof(RecordHeader) + list_size(trigger_info) + list_size(snapshot), ALIGN);
+    }
+
+    static bool entries_fit(const EntryList* list) {
+        return !list || (list->size().n_nodes <= MAX_ENTRIES && list->size().n_immediate <= MAX_ENTRIES);
+    }
+
+    bool fits(const EntryList* trigger_info, const EntryList* snapshot) const {
+        return entries_fit(trigger_info) && entries_fit(snapshot) &&
+            record_size(trigger_info, snapshot) <= (mask + 1) / 2;
+    }
+
+    bool push(const EntryList* trigger_info, const EntryList* snapshot) {
+        if (!fits(trigger_info, snapshot))
+            return false;
+
+        std::size_t len  = record_size(trigger_info, snapshot);
+        std::size_t cap  = mask + 1;
+        std::size_t h    = head.load(std::memory_order_relaxed);
+        std::size_t t    = tail.load(std::memory_order_acquire);
+        std::size_t pos  = h & mask;
+        std::size_t cont = cap - pos;
+        std::size_t pad  = (len > cont ? cont : 0);
+
+        if (cap - (h - t) < pad + len)
+            return false;
+
+        if (pad > 0) {
+            RecordHeader phdr = { static_cast<uint32_t>(pad), PAD, { 0, 0, 0, 0 } };
+            std::memcpy(buf + pos, &phdr, sizeof(phdr));
+            pos = 0;
+        }
+
+        RecordHeader hdr = { static_cast<uint32_t>(len),
+                             static_cast<uint32_t>(trigger_info ? SNAPSHOT_TRIGGER : SNAPSHOT),
+                             { static_cast<uint16_t>(trigger_info ? trigger_info->size().n_nodes     : 0),
+                               static_cast<uint16_t>(trigger_info ? trigger_info->size().n_immediate : 0),
+                               static_cast<uint16_t>(snapshot->size().n_nodes),
+                               static_cast<uint16_t>(snapshot->size().n_immediate) } };
+
+        unsigned char* p = buf + pos;
+
+        std::memcpy(p, &hdr, sizeof(hdr));
+        p = write_list(trigger_info, p + sizeof(hdr));
+        write_list(snapshot, p);
+
+        head.store(h + pad + len, std::memory_order_release);
+
+        return true;
+    }
+
+    std::size_t pop(const ProcessFn& fn, std::size_t max) {
+        std::size_t t     = tail.load(std::memory_order_relaxed);
+        std::size_t h     = head.load(std::memory_order_acquire);
+        std::size_t count = 0;
+
+        while (t != h && count < max) {
+            RecordHeader hdr;
+            std::memcpy(&hdr, buf + (t & mask), sizeof(hdr));
+
+            if (hdr.kind != PAD) {
+                const unsigned char* p = buf + (t & mask) + sizeof(hdr);
+
+                EntryList::FixedEntryList<MAX_ENTRIES> trigger_data;
+                EntryList::FixedEntryList<MAX_ENTRIES> snapshot_data;
+
+                EntryList trigger_info(trigger_data);
+                EntryList snapshot(snapshot_data);
+
+                p = read_list(p, hdr.n[0], hdr.n[1], &trigger_info);
+                read_list(p, hdr.n[2], hdr.n[3], &snapshot);
+
+                fn(hdr.kind == SNAPSHOT_TRIGGER ? &trigger_info : nullptr, &snapshot);
+
+                ++count;
+            }
+
+            t += hdr.len;
+            tail.store(t, std::memory_order_release);
+        }
+
+        return count;
+    }
+};
+
+
+SnapshotRing::SnapshotRing(std::size_t size)
+    : mP(new SnapshotRingImpl(size))
+{ }
+
+SnapshotRing::~SnapshotRing()
+{
+    mP.reset();
+}
+
+bool
+SnapshotRing::push(const EntryList* trigger_info, const EntryList* snapshot)
+{
+    return mP->push(trigger_info, snapshot);
+}
+
+std::size_t
+SnapshotRing::pop(const ProcessFn& fn, std::size_t max)
+{
+    return mP->pop(fn, max);
+}
+
+bool
+SnapshotRing::fits(const EntryList* trigger_info, const EntryList* snapshot) const
+{
+    return mP->fits(trigger_info, snapshot);
+}
+
+bool
+SnapshotRing::empty() const
+{
+    return mP->tail.load(std::memory_order_acquire) == mP->head.load(std::memory_order_acquire);
+}
+
+std::size_t
+SnapshotRing::pushed() const
+{
+    return mP->head.load(std::memory_order_acquire);
+}
+
+std::size_t
+SnapshotRing::popped() const
+{
+    return mP->tail.load(std::memory_order_acquire);
+}
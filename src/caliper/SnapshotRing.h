@@ -0,0 +1,99 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///
+/// @file SnapshotRing.h
+/// SnapshotRing class declaration
+///
+
+#ifndef CALI_SNAPSHOTRING_H
+#define CALI_SNAPSHOTRING_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+
+namespace cali
+{
+
+class EntryList;
+
+///
+/// class SnapshotRing
+/// Single-producer, single-consumer ring buffer of snapshots. Snapshots
+/// are stored as context tree node pointers and packed immediate entries;
+/// string and blob immediate values are copied into the ring. push() is
+/// lock-free and signal-safe.
+
+class SnapshotRing
+{
+    struct SnapshotRingImpl;
+
+    std::unique_ptr<SnapshotRingImpl> mP;
+
+public:
+
+    typedef std::function<void(const EntryList*,const EntryList*)> ProcessFn;
+
+    /// \brief Create ring buffer of (at least) \a size bytes
+    SnapshotRing(std::size_t size);
+
+    ~SnapshotRing();
+
+    SnapshotRing(const SnapshotRing&) = delete;
+    SnapshotRing& operator = (const SnapshotRing&) = delete;
+
+    /// \brief Copy \a trigger_info (may be null) and \a snapshot into the ring.
+    ///   Producer side. Returns \c false if there is not enough space.
+    bool push(const EntryList* trigger_info, const EntryList* snapshot);
+
+    /// \brief Invoke \a fn on up to \a max queued snapshots in FIFO order,
+    ///   and remove them. Consumer side. Returns the number of snapshots processed.
+    std::size_t pop(const ProcessFn& fn, std::size_t max);
+
+    /// \brief Return \c true if a snapshot with the given entries can ever fit
+    ///   into the ring.
+    bool fits(const EntryList* trigger_info, const EntryList* snapshot) const;
+
+    bool empty() const;
+
+    /// \brief Return the total amount of data pushed so far. Once popped()
+    ///   reaches a value returned by pushed(), all snapshots pushed before
+    ///   have been processed.
+    std::size_t pushed() const;
+    /// \brief Return the total amount of data popped and processed so far.
+    std::size_t popped() const;
+};
+
+} // namespace cali
+
+#endif // CALI_SNAPSHOTRING_H
@@ -0,0 +1,324 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///
+/// @file StringTable.cpp
+/// StringTable class implementation
+///
+
+#include "StringTable.h"
+
+#include "Log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <vector>
+
+using namespace cali;
+
+namespace
+{
+
+inline uint64_t
+hash_string(const char* str, size_t len)
+{
+    // FNV-1a
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < len; ++i)
+        h = (h ^ static_cast<unsigned char>(str[i])) * 0x100000001b3ULL;
+
+    return h;
+}
+
+/// Header preceding each interned string in the string arena
+struct Entry {
+    uint64_t    hash;
+    size_t      len;
+    const char* str;
+};
+
+/// Open-addressing hash table of entry pointers
+struct Table {
+    size_t                    mask;
+    std::atomic<const Entry*> slots[1];
+
+    static Table* create(size_t capacity) {
+        void*  mem = std::malloc(sizeof(Table) + (capacity-1) * sizeof(std::atomic<const Entry*>));
+        Table* t   = static_cast<Table*>(mem);
+
+        t->mask = capacity - 1;
+
+        for (size_t i = 0; i < capacity; ++i)
+            new(&t->slots[i]) std::atomic<const Entry*>(nullptr);
+
+        return t;
+    }
+
+    void insert(const Entry* e) {
+        size_t i = e->hash & mask;
+
+        while (slots[i].load(std::memory_order_relaxed))
+            i = (i + 1) & mask;
+
+        slots[i].store(e, std::memory_order_release);
+    }
+};
+
+const size_t MAX_CHUNKS      = 48;
+const size_t MIN_CHUNK_SIZE  = 64 * 1024;
+const size_t INITIAL_ENTRIES = 1024;
+
+} // namespace
+
+struct StringTable::StringTableImpl
+{
+    std::atomic<Table*>       m_table;
+    std::vector<Table*>       m_old_tables;
+    size_t                    m_count;
+
+    // The string arena: Chunk ranges are published so that we can quickly
+    // check if a pointer refers to interned memory
+
+    struct Chunk {
+        std::atomic<char*>    begin;
+        std::atomic<char*>    end;
+    }                         m_chunks[MAX_CHUNKS];
+    std::atomic<size_t>       m_num_chunks;
+
+    // Strings that didn't fit into the arena anymore
+    std::vector<char*>        m_overflow;
+    std::atomic<bool>         m_arena_full;
+
+    char*                     m_pos;
+    char*                     m_end;
+
+    std::mutex                m_lock;
+
+    StringTableImpl()
+        : m_table(Table::create(2 * INITIAL_ENTRIES)),
+          m_count(0),
+          m_num_chunks(0),
+          m_arena_full(false),
+          m_pos(nullptr),
+          m_end(nullptr)
+        {
+            for (size_t c = 0; c < MAX_CHUNKS; ++c) {
+                m_chunks[c].begin.store(nullptr);
+                m_chunks[c].end.store(nullptr);
+            }
+        }
+
+    ~StringTableImpl() {
+        std::free(m_table.load());
+
+        for (Table* t : m_old_tables)
+            std::free(t);
+
+        for (size_t c = 0; c < m_num_chunks.load(); ++c)
+            std::free(m_chunks[c].begin.load());
+        for (char* ptr : m_overflow)
+            std::free(ptr);
+    }
+
+    const Entry* find_entry(const char* str, size_t len) const {
+        size_t n = m_num_chunks.load(std::memory_order_acquire);
+
+        for (size_t c = 0; c < n; ++c) {
+            const char* b = m_chunks[c].begin.load(std::memory_order_relaxed);
+            const char* e = m_chunks[c].end.load(std::memory_order_relaxed);
+
+            if (str >= b + sizeof(Entry) && str < e) {
+                Entry hdr;
+                std::memcpy(&hdr, str - sizeof(Entry), sizeof(Entry));
+
+                return (hdr.str == str && hdr.len == len) ? 
+                    reinterpret_cast<const Entry*>(str - sizeof(Entry)) : nullptr;
+            }
+        }
+
+        return nullptr;
+    }
+
+    const char* lookup(uint64_t hash, const char* str, size_t len) const {
+        const Table* t = m_table.load(std::memory_order_acquire);
+
+        for (size_t i = hash & t->mask; ; i = (i + 1) & t->mask) {
+            const Entry* e = t->slots[i].load(std::memory_order_acquire);
+
+            if (!e)
+                return nullptr;
+            if (e->hash == hash && e->len == len && std::memcmp(e->str, str, len) == 0)
+                return e->str;
+        }
+    }
+
+    // must hold m_lock
+    char* allocate(size_t bytes) {
+        if (m_pos + bytes > m_end) {
+            size_t c = m_num_chunks.load(std::memory_order_relaxed);
+
+            if (c >= MAX_CHUNKS)
+                return nullptr;
+
+            size_t chunksize = std::max(MIN_CHUNK_SIZE << std::min<size_t>(c, 8), bytes);
+            char*  ptr       = static_cast<char*>(std::malloc(chunksize));
+
+            if (!ptr)
+                return nullptr;
+
+            m_chunks[c].begin.store(ptr, std::memory_order_relaxed);
+            m_chunks[c].end.store(ptr + chunksize, std::memory_order_relaxed);
+            m_num_chunks.store(c + 1, std::memory_order_release);
+
+            m_pos = ptr;
+            m_end = ptr + chunksize;
+        }
+
+        char* ret = m_pos;
+        m_pos += (bytes + alignof(Entry) - 1) & ~(alignof(Entry) - 1);
+
+        return ret;
+    }
+
+    const char* intern(const char* str, size_t len) {
+        if (!str)
+            str = "";
+        if (find_entry(str, len))
+            return str;
+
+        uint64_t    hash = hash_string(str, len);
+        const char* ret  = lookup(hash, str, len);
+
+        if (ret)
+            return ret;
+
+        std::lock_guard<std::mutex>
+            g(m_lock);
+
+        // check again: string may have been added in the meantime
+        ret = lookup(hash, str, len);
+
+        if (ret)
+            return ret;
+
+        char* ptr = allocate(sizeof(Entry) + len + 1);
+
+        if (!ptr) {
+            // Arena is full: keep interning into individual heap blocks
+            ptr = static_cast<char*>(std::malloc(sizeof(Entry) + len + 1));
+
+            if (!ptr)
+                return nullptr;
+
+            m_overflow.push_back(ptr);
+
+            if (!m_arena_full.exchange(true))
+                Log(0).stream() << "String table: arena is full, interning strings on the heap" << std::endl;
+        }
+
+        Entry* e = reinterpret_cast<Entry*>(ptr);
+        char*  s = ptr + sizeof(Entry);
+
+        std::memcpy(s, str, len);
+        s[len] = '\0';
+
+        e->hash = hash;
+        e->len  = len;
+        e->str  = s;
+
+        Table* t = m_table.load(std::memory_order_relaxed);
+
+        if (2 * (m_count + 1) > t->mask + 1) {
+            // grow: readers may still use the old table, so keep it around
+
+            Table* newt = Table::create(2 * (t->mask + 1));
+
+            for (size_t i = 0; i <= t->mask; ++i) {
+                const Entry* olde = t->slots[i].load(std::memory_order_relaxed);
+
+                if (olde)
+                    newt->insert(olde);
+            }
+
+            m_old_tables.push_back(t);
+            m_table.store(newt, std::memory_order_release);
+
+            t = newt;
+        }
+
+        t->insert(e);
+        ++m_count;
+
+        return s;
+    }
+};
+
+
+StringTable::StringTable()
+    : mP(new StringTableImpl)
+{ }
+
+StringTable::~StringTable()
+{
+    mP.reset();
+}
+
+const char*
+StringTable::intern(const char* str, size_t len)
+{
+    return mP->intern(str, len);
+}
+
+bool
+StringTable::is_interned(const char* str, size_t len) const
+{
+    if (mP->find_entry(str, len))
+        return true;
+
+    // Strings interned after the arena filled up are only in the hash table
+    return mP->m_arena_full.load() && mP->lookup(hash_string(str, len), str, len) == str;
+}
+
+size_t
+StringTable::size() const
+{
+    std::lock_guard<std::mutex>
+        g(mP->m_lock);
+
+    return mP->m_count;
+}
@@ -0,0 +1,81 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+///
+/// @file StringTable.h
+/// StringTable class declaration
+///
+
+#ifndef CALI_STRINGTABLE_H
+#define CALI_STRINGTABLE_H
+
+#include <cstddef>
+#include <memory>
+
+namespace cali
+{
+
+///
+/// class StringTable
+/// Process-wide table of interned strings. Each distinct string is stored
+/// exactly once, so interned strings can be compared by pointer.
+/// Lookups of existing strings are lock-free; interned strings are never
+/// released during the lifetime of the table.
+
+class StringTable
+{
+    struct StringTableImpl;
+
+    std::unique_ptr<StringTableImpl> mP;
+
+public:
+
+    StringTable();
+
+    ~StringTable();
+
+    StringTable(const StringTable&) = delete;
+    StringTable& operator = (const StringTable&) = delete;
+
+    /// \brief Return the interned copy of the \a len -character string \a str.
+    ///   If \a str itself was returned by intern() before, it is returned as is.
+    const char* intern(const char* str, std::size_t len);
+
+    /// \brief Return \c true if \a str is an interned string of length \a len
+    bool is_interned(const char* str, std::size_t len) const;
+
+    std::size_t size() const;
+};
+
+} // namespace cali
+
+#endif // CALI_STRINGTABLE_H
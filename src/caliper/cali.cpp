@@ -37,55 +37,17 @@
 
 #include "Caliper.h"
 #include "EntryList.h"
+#include "Loop.h"
+#include "Region.h"
 
 #include <Variant.h>
 
 #include <cstring>
-#include <unordered_map>
-#include <mutex>
 
 
 using namespace cali;
 
 
-namespace
-{
-    // Put attributes into a local map until we get fast by-id lookup in the runtime again
-
-    typedef std::unordered_map<cali_id_t, Attribute> attr_map_t;
-
-    attr_map_t attr_map;
-    std::mutex attr_map_mutex;
-
-    void 
-    store_attribute(const Attribute& attr) {
-        if (!(attr == Attribute::invalid)) {
-            std::lock_guard<std::mutex> lock(attr_map_mutex);
-            attr_map.insert(std::make_pair(attr.id(), attr));;
-        }
-    }
-
-    Attribute 
-    lookup_attribute(Caliper& c, cali_id_t attr_id) {
-        Attribute attr { Attribute::invalid };
-
-        std::lock_guard<std::mutex> lock(attr_map_mutex);
-        auto f = attr_map.find(attr_id);
-
-        if (f != attr_map.end()) { 
-            attr = f->second;
-        } else {
-            attr = c.get_attribute(attr_id);
-
-            if (!(attr == Attribute::invalid))
-                attr_map.insert(std::make_pair(attr_id, attr));
-        }
-
-        return attr;
-    }
-}
-
-
 //
 // --- Attribute interface
 //
@@ -94,7 +56,6 @@ cali_id_t
 cali_create_attribute(const char* name, cali_attr_type type, int properties)
 {
     Attribute a = Caliper::instance().create_attribute(name, type, properties);
-    ::store_attribute(a);
 
     return a.id();
 }
@@ -115,7 +76,7 @@ cali_create_attribute_with_metadata(const char* name, cali_attr_type type, int p
     Variant*   meta_data = new Variant[n];
 
     for (int i = 0; i < n; ++i) {
-        meta_attr[i] = ::lookup_attribute(c, meta_attr_list[i]);
+        meta_attr[i] = c.get_attribute(meta_attr_list[i]);
 
         if (meta_attr[i] == Attribute::invalid)
             continue;
@@ -125,8 +86,6 @@ cali_create_attribute_with_metadata(const char* name, cali_attr_type type, int p
 
     Attribute attr =
         c.create_attribute(name, type, properties, n, meta_attr, meta_data);
-    
-    ::store_attribute(attr);
 
     delete[] meta_data;
     delete[] meta_attr;
@@ -138,7 +97,6 @@ cali_id_t
 cali_find_attribute(const char* name)
 {
     Attribute a = Caliper::instance().get_attribute(name);
-    ::store_attribute(a);
 
     return a.id();
 }
@@ -162,7 +120,7 @@ cali_push_snapshot(int scope, int n,
     n = std::min(std::max(n, 0), 64);
 
     for (int i = 0; i < n; ++i) {
-        attr[i] = ::lookup_attribute(c, trigger_info_attr_list[i]);
+        attr[i] = c.get_attribute(trigger_info_attr_list[i]);
         data[i]  = Variant(attr[i].type(), trigger_info_val_list[i], trigger_info_size_list[i]);
     }
 
@@ -181,7 +139,7 @@ cali_err
 cali_begin(cali_id_t attr_id)
 {
     Caliper   c;
-    Attribute attr = ::lookup_attribute(c, attr_id);
+    Attribute attr = c.get_attribute(attr_id);
     
     if (attr.type() == CALI_TYPE_BOOL)
         return c.begin(attr, Variant(true));
@@ -193,7 +151,7 @@ cali_err
 cali_end(cali_id_t attr_id)
 {
     Caliper   c;
-    Attribute attr = ::lookup_attribute(c, attr_id);
+    Attribute attr = c.get_attribute(attr_id);
 
     return c.end(attr);
 }
@@ -202,16 +160,25 @@ cali_err
 cali_set(cali_id_t attr_id, const void* value, size_t size)
 {
     Caliper   c;
-    Attribute attr = ::lookup_attribute(c, attr_id);
+    Attribute attr = c.get_attribute(attr_id);
 
     return c.set(attr, Variant(attr.type(), value, size));
 }
 
+cali_err
+cali_accumulate(cali_id_t attr_id, double val)
+{
+    Caliper   c;
+    Attribute attr = c.get_attribute(attr_id);
+
+    return c.accumulate(attr, val);
+}
+
 cali_err
 cali_begin_double(cali_id_t attr_id, double val)
 {
     Caliper   c;
-    Attribute attr = ::lookup_attribute(c, attr_id);
+    Attribute attr = c.get_attribute(attr_id);
 
     if (attr.type() != CALI_TYPE_DOUBLE)
         return CALI_ETYPE;
@@ -223,7 +190,7 @@ cali_err
 cali_begin_int(cali_id_t attr_id, int val)
 {
     Caliper   c;
-    Attribute attr = ::lookup_attribute(c, attr_id);
+    Attribute attr = c.get_attribute(attr_id);
 
     if (attr.type() != CALI_TYPE_INT)
         return CALI_ETYPE;
@@ -235,7 +202,7 @@ cali_err
 cali_begin_string(cali_id_t attr_id, const char* val)
 {
     Caliper   c;
-    Attribute attr = ::lookup_attribute(c, attr_id);
+    Attribute attr = c.get_attribute(attr_id);
 
     if (attr.type() != CALI_TYPE_STRING)
         return CALI_ETYPE;
@@ -247,7 +214,7 @@ cali_err
 cali_set_double(cali_id_t attr_id, double val)
 {
     Caliper   c;
-    Attribute attr = ::lookup_attribute(c, attr_id);
+    Attribute attr = c.get_attribute(attr_id);
 
     if (attr.type() != CALI_TYPE_DOUBLE)
         return CALI_ETYPE;
@@ -259,7 +226,7 @@ cali_err
 cali_set_int(cali_id_t attr_id, int val)
 {
     Caliper   c;
-    Attribute attr = ::lookup_attribute(c, attr_id);
+    Attribute attr = c.get_attribute(attr_id);
 
     if (attr.type() != CALI_TYPE_INT)
         return CALI_ETYPE;
@@ -271,7 +238,7 @@ cali_err
 cali_set_string(cali_id_t attr_id, const char* val)
 {
     Caliper   c;
-    Attribute attr = ::lookup_attribute(c, attr_id);
+    Attribute attr = c.get_attribute(attr_id);
 
     if (attr.type() != CALI_TYPE_STRING)
         return CALI_ETYPE;
@@ -384,3 +351,111 @@ cali_end_byname(const char* attr_name)
 
     return c.end(attr);
 }
+
+const char*
+cali_intern_string(const char* str)
+{
+    Caliper c;
+
+    return c.intern_string(str, strlen(str));
+}
+
+//
+// --- Static regions
+//
+
+cali_region_t
+cali_make_region(const char* attr_name, const char* name)
+{
+    return reinterpret_cast<cali_region_t>(new Region(name, attr_name));
+}
+
+cali_region_t
+cali_make_region_once(cali_region_t* handle, const char* attr_name, const char* name)
+{
+    cali_region_t region = __atomic_load_n(handle, __ATOMIC_ACQUIRE);
+
+    if (region)
+        return region;
+
+    // Several threads may get here at once: the first one to install its
+    // handle wins, the others discard theirs
+
+    Region*       r        = new Region(name, attr_name);
+    cali_region_t expected = 0;
+
+    region = reinterpret_cast<cali_region_t>(r);
+
+    if (!__atomic_compare_exchange_n(handle, &expected, region, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        delete r;
+        region = expected;
+    }
+
+    return region;
+}
+
+cali_err
+cali_region_begin(cali_region_t region)
+{
+    if (!region)
+        return CALI_EINV;
+
+    reinterpret_cast<Region*>(region)->begin();
+
+    return CALI_SUCCESS;
+}
+
+cali_err
+cali_region_end(cali_region_t region)
+{
+    if (!region)
+        return CALI_EINV;
+
+    reinterpret_cast<Region*>(region)->end();
+
+    return CALI_SUCCESS;
+}
+
+//
+// --- Loops
+//
+
+cali_loop_t
+cali_make_loop(const char* name, cali_loop_bucketing mode, int bucket_size)
+{
+    return reinterpret_cast<cali_loop_t>(new Loop(name, mode, bucket_size));
+}
+
+cali_err
+cali_loop_begin(cali_loop_t loop)
+{
+    if (!loop)
+        return CALI_EINV;
+
+    reinterpret_cast<Loop*>(loop)->begin();
+
+    return CALI_SUCCESS;
+}
+
+cali_err
+cali_loop_iteration(cali_loop_t loop, int i)
+{
+    if (!loop)
+        return CALI_EINV;
+
+    reinterpret_cast<Loop*>(loop)->iteration(i);
+
+    return CALI_SUCCESS;
+}
+
+cali_err
+cali_loop_end(cali_loop_t loop)
+{
+    if (!loop)
+        return CALI_EINV;
+
+    reinterpret_cast<Loop*>(loop)->end();
+
+    return CALI_SUCCESS;
+}
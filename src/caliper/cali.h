@@ -169,6 +169,18 @@ cali_set_int(cali_id_t attr, int val);
 cali_err  
 cali_set_string(cali_id_t attr, const char* val);
 
+/**
+ * Add \param val to the thread-local accumulator for attribute \param attr.
+ * The accumulated value is added as a delta to the next snapshot taken on
+ * this thread (e.g., at the end of the enclosing region), and then reset.
+ * This does not create a snapshot or any context tree nodes.
+ * \param attr An attribute of type CALI_TYPE_DOUBLE with CALI_ATTR_ASVALUE.
+ *   Add it to the aggregate service's attribute list to sum it up.
+ */
+
+cali_err
+cali_accumulate(cali_id_t attr, double val);
+
 /**
  * Put attribute with name \param attr_name on the blackboard.
  */
@@ -207,6 +219,123 @@ cali_set_string_byname(const char* attr_name, const char* val);
 cali_err
 cali_end_byname(const char* attr_name);
 
+/**
+ * Return the process-wide interned copy of the string \param str.
+ * Context tree nodes compare interned strings by address, so passing
+ * interned strings to cali_begin_string() etc. avoids repeated string
+ * hashing and comparisons at hot annotation sites.
+ * Interned strings are never freed.
+ */
+
+const char*
+cali_intern_string(const char* str);
+
+/*
+ * --- Static regions --------------------------------------------------
+ */
+
+/**
+ * Opaque handle for a region with a constant name
+ */
+
+typedef struct cali_region* cali_region_t;
+
+/**
+ * Create a handle for region \param name of string attribute 
+ * \param attr_name. The handle looks up attribute and value only once and
+ * caches context tree nodes, which makes cali_region_begin() and 
+ * cali_region_end() cheaper than the generic cali_begin_string()/cali_end().
+ * Region handles are meant to be created once and are never freed.
+ */
+
+cali_region_t
+cali_make_region(const char* attr_name, const char* name);
+
+/**
+ * Return the region handle stored in \param handle. If \param handle is
+ * 0, create a handle for region \param name of attribute \param attr_name
+ * and store it in \param handle. Safe to call concurrently on the same 
+ * handle variable: all callers get the same handle.
+ */
+
+cali_region_t
+cali_make_region_once(cali_region_t* handle, const char* attr_name, const char* name);
+
+/**
+ * Begin region \param region on the blackboard.
+ */
+
+cali_err
+cali_region_begin(cali_region_t region);
+
+/**
+ * End region \param region.
+ */
+
+cali_err
+cali_region_end(cali_region_t region);
+
+/**
+ * Begin region \param name of the "region" attribute, using a static handle
+ * variable \param handle. Use CALI_REGION_END(handle) to end the region.
+ */
+
+#define CALI_REGION_BEGIN(handle, name) \
+    static cali_region_t handle = 0; \
+    cali_region_begin(cali_make_region_once(&handle, "region", (name)))
+
+#define CALI_REGION_END(handle) \
+    cali_region_end(handle)
+
+/*
+ * --- Loops -----------------------------------------------------------
+ */
+
+/**
+ * Opaque handle for a loop
+ */
+
+typedef struct cali_loop* cali_loop_t;
+
+/**
+ * Create a handle for loop \param name. Loops are marked as \param name
+ * of the "loop" attribute. Iteration numbers are recorded as immediate
+ * values of the "iteration#name" attribute, so they do not create context
+ * tree nodes.
+ * With bucketing, the recorded iteration number is the first iteration of 
+ * the current bucket, and it is only updated when a new bucket starts.
+ * Without bucketing (CALI_LOOP_BUCKET_LINEAR with \param bucket_size 1),
+ * each iteration updates the attribute, and the event service takes a
+ * snapshot per iteration.
+ * \param mode CALI_LOOP_BUCKET_LINEAR for buckets of \param bucket_size
+ *   iterations, or CALI_LOOP_BUCKET_LOG2 for power-of-two sized buckets.
+ * Loop handles are meant to be created once and are never freed.
+ */
+
+cali_loop_t
+cali_make_loop(const char* name, cali_loop_bucketing mode, int bucket_size);
+
+/**
+ * Begin loop \param loop.
+ */
+
+cali_err
+cali_loop_begin(cali_loop_t loop);
+
+/**
+ * Mark iteration \param i of loop \param loop.
+ */
+
+cali_err
+cali_loop_iteration(cali_loop_t loop, int i);
+
+/**
+ * End loop \param loop and clear its iteration number.
+ */
+
+cali_err
+cali_loop_end(cali_loop_t loop);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
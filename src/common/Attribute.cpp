@@ -94,63 +94,15 @@ namespace
 */
 
 Attribute 
-Attribute::make_attribute(const Node* node, const MetaAttributeIDs* keys)
+Attribute::make_attribute(const AttributeInfo* info)
 {
-    // sanity check: make sure we have the necessary attributes (name and type)
-
-    // Given node must be attribute name 
-
-    if (!node || !keys || node->attribute() == CALI_INV_ID || node->attribute() != keys->name_attr_id)
-        return Attribute::invalid;
-
-    // Find type attribute
-    for (const Node* p = node; p && p->attribute() != CALI_INV_ID; p = p->parent()) 
-        if (p->attribute() == keys->type_attr_id)
-            return Attribute(node, keys);
-
-    return Attribute::invalid;
-}
-
-cali_id_t
-Attribute::id() const
-{ 
-    return m_node ? m_node->id() : CALI_INV_ID;
-}
-
-std::string
-Attribute::name() const 
-{
-    for (const Node* node = m_node; node && node->attribute() != CALI_INV_ID; node = node->parent())
-        if (node->attribute() == m_keys->name_attr_id)
-            return node->data().to_string();
-
-    return std::string();
-}
-
-cali_attr_type
-Attribute::type() const 
-{
-    for (const Node* node = m_node; node && node->attribute() != CALI_INV_ID; node = node->parent())
-        if (node->attribute() == m_keys->type_attr_id)
-            return node->data().to_attr_type();
-
-    return CALI_TYPE_INV;
-}
-
-int
-Attribute::properties() const 
-{
-    for (const Node* node = m_node; node && node->attribute() != CALI_INV_ID; node = node->parent())
-        if (node->attribute() == m_keys->prop_attr_id)
-            return node->data().to_int();
-
-    return CALI_ATTR_DEFAULT;
+    return info ? Attribute(info) : Attribute::invalid;
 }
 
 Variant
 Attribute::get(const Attribute& attr) const
 {
-    for (const Node* node = m_node; node; node = node->parent())
+    for (const Node* node = m_info->node; node; node = node->parent())
         if (node->attribute() == attr.id())
             return node->data();
 
@@ -159,4 +111,8 @@ Attribute::get(const Attribute& attr) const
 
 const MetaAttributeIDs MetaAttributeIDs::invalid { CALI_INV_ID, CALI_INV_ID, CALI_INV_ID };
 
-const Attribute Attribute::invalid { 0, 0 };
+const AttributeInfo AttributeInfo::invalid {
+    CALI_INV_ID, CALI_TYPE_INV, CALI_ATTR_DEFAULT, CALI_ATTR_SCOPE_THREAD, "", 0, nullptr
+};
+
+const Attribute Attribute::invalid;
@@ -57,42 +57,74 @@ struct MetaAttributeIDs {
     static const MetaAttributeIDs invalid;
 };    
 
+/// \brief Immutable, pre-computed attribute metadata
+///
+/// Descriptors are created once per attribute by an AttributeInfoTable
+/// and never change afterwards, so Attribute objects can simply hold a
+/// pointer to them.
+struct AttributeInfo {
+    cali_id_t      id;
+    cali_attr_type type;
+    int            properties;
+    int            scope;    ///< CALI_ATTR_SCOPE_* bits (defaults to thread scope)
+    const char*    name;     ///< Name string, owned by the AttributeInfoTable
+    size_t         name_len;
+    const Node*    node;     ///< Attribute node in the metadata tree
+
+    static const AttributeInfo invalid;
+};
+
 class Attribute
 {
 
 public:
 
     constexpr Attribute()
-        : m_node(0), m_keys(0)
+        : m_info(&AttributeInfo::invalid)
         { }
 
-    cali_id_t      id() const;
+    cali_id_t      id() const {
+        return m_info->id;
+    }
 
-    std::string    name() const;
-    cali_attr_type type() const;
+    std::string    name() const {
+        return std::string(m_info->name, m_info->name_len);
+    }
+    const char*    name_c_str() const {
+        return m_info->name;
+    }
 
-    int            properties() const;
+    cali_attr_type type() const {
+        return m_info->type;
+    }
+
+    int            properties() const {
+        return m_info->properties;
+    }
+    int            scope() const {
+        return m_info->scope;
+    }
 
     const Node*    node() const {
-        return m_node;
+        return m_info->node;
     }
 
     bool store_as_value() const { 
-        return properties() & CALI_ATTR_ASVALUE; 
+        return m_info->properties & CALI_ATTR_ASVALUE; 
     }
     bool is_autocombineable() const   { 
-        return !store_as_value() && !(properties() & CALI_ATTR_NOMERGE);
+        return !(m_info->properties & (CALI_ATTR_ASVALUE | CALI_ATTR_NOMERGE));
     }
     bool skip_events() const {
-        return properties() & CALI_ATTR_SKIP_EVENTS;
+        return m_info->properties & CALI_ATTR_SKIP_EVENTS;
     }
     bool is_hidden() const {
-        return properties() & CALI_ATTR_HIDDEN;
+        return m_info->properties & CALI_ATTR_HIDDEN;
     }
 
     Variant        get(const Attribute& attr) const;
     
-    static Attribute make_attribute(const Node* node, const MetaAttributeIDs* keys);
+    static Attribute make_attribute(const AttributeInfo* info);
 
     // RecordMap record() const;
 
@@ -100,11 +132,10 @@ public:
 
 private:
 
-    const Node*            m_node;
-    const MetaAttributeIDs* m_keys;
+    const AttributeInfo* m_info;
 
-    Attribute(const Node* node, const MetaAttributeIDs* keys)
-        : m_node(node), m_keys(keys)
+    Attribute(const AttributeInfo* info)
+        : m_info(info)
         { }
 
     friend bool operator <  (const cali::Attribute& a, const cali::Attribute& b);
@@ -117,12 +148,12 @@ inline bool operator < (const cali::Attribute& a, const cali::Attribute& b) {
 }
 
 inline bool operator == (const cali::Attribute& a, const cali::Attribute& b) {
-    // we don't have copies of nodes, so the ptr should be unique
-    return a.m_node == b.m_node;
+    // there is only one descriptor per attribute, so the ptr should be unique
+    return a.m_info == b.m_info;
 }
 
 inline bool operator != (const cali::Attribute& a, const cali::Attribute& b) {
-    return a.m_node != b.m_node;
+    return a.m_info != b.m_info;
 }
 
 } // namespace cali
@@ -0,0 +1,230 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @file AttributeInfoTable.cpp
+/// AttributeInfoTable class implementation
+
+#include "AttributeInfoTable.h"
+
+#include "Node.h"
+
+#include <atomic>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+
+using namespace cali;
+using namespace std;
+
+namespace
+{
+
+// Ids are mapped onto a two-level table of fixed-size chunks, so that
+// existing entries never move and can be read without a lock.
+
+constexpr size_t CHUNK_BITS = 12;
+constexpr size_t CHUNK_SIZE = 1 << CHUNK_BITS;
+constexpr size_t NUM_CHUNKS = 4096;
+
+struct Chunk {
+    std::atomic<const AttributeInfo*> entries[CHUNK_SIZE];
+
+    Chunk() {
+        for (size_t i = 0; i < CHUNK_SIZE; ++i)
+            entries[i].store(nullptr, std::memory_order_relaxed);
+    }
+};
+
+struct InfoRecord {
+    AttributeInfo info;
+    std::string   name;
+};
+
+} // namespace
+
+struct AttributeInfoTable::AttributeInfoTableImpl
+{
+    std::atomic<Chunk*>   chunks[NUM_CHUNKS];
+
+    /// Descriptors for ids outside the chunk table (slow path)
+    map<cali_id_t, const AttributeInfo*> overflow;
+
+    /// Descriptor storage. Elements in a deque don't move on push_back.
+    deque<InfoRecord>     records;
+
+    mutable std::mutex    lock;
+
+    const AttributeInfo* get(cali_id_t id) const {
+        if (id == CALI_INV_ID)
+            return nullptr;
+
+        size_t c = id >> CHUNK_BITS;
+
+        if (c < NUM_CHUNKS) {
+            Chunk* chunk = chunks[c].load(std::memory_order_acquire);
+            return chunk ? chunk->entries[id & (CHUNK_SIZE-1)].load(std::memory_order_acquire) : nullptr;
+        }
+
+        std::lock_guard<std::mutex>
+            g(lock);
+
+        auto it = overflow.find(id);
+        return it == overflow.end() ? nullptr : it->second;
+    }
+
+    // must hold lock
+    void insert(cali_id_t id, const AttributeInfo* info) {
+        size_t c = id >> CHUNK_BITS;
+
+        if (c < NUM_CHUNKS) {
+            Chunk* chunk = chunks[c].load(std::memory_order_relaxed);
+
+            if (!chunk) {
+                chunk = new Chunk;
+                chunks[c].store(chunk, std::memory_order_release);
+            }
+
+            chunk->entries[id & (CHUNK_SIZE-1)].store(info, std::memory_order_release);
+        } else
+            overflow.emplace(id, info);
+    }
+
+    const AttributeInfo* get_or_create(const Node* node, const MetaAttributeIDs* keys) {
+        if (!node || !keys || node->attribute() == CALI_INV_ID || node->attribute() != keys->name_attr_id)
+            return nullptr;
+
+        const AttributeInfo* info = get(node->id());
+
+        if (info)
+            return info;
+
+        // Collect name, type, and properties from the node path.
+        // The given node must be the attribute name node.
+
+        cali_attr_type type = CALI_TYPE_INV;
+        int            prop = CALI_ATTR_DEFAULT;
+
+        for (const Node* p = node; p && p->attribute() != CALI_INV_ID; p = p->parent())
+            if (p->attribute() == keys->type_attr_id)
+                type = p->data().to_attr_type();
+            else if (p->attribute() == keys->prop_attr_id)
+                prop = p->data().to_int();
+
+        if (type == CALI_TYPE_INV)
+            return nullptr;
+
+        int scope = prop & CALI_ATTR_SCOPE_MASK;
+
+        if (scope != CALI_ATTR_SCOPE_PROCESS && scope != CALI_ATTR_SCOPE_TASK)
+            scope = CALI_ATTR_SCOPE_THREAD;
+
+        std::lock_guard<std::mutex>
+            g(lock);
+
+        // check again: another thread may have created it in the meantime
+
+        size_t c = node->id() >> CHUNK_BITS;
+
+        if (c < NUM_CHUNKS) {
+            Chunk* chunk = chunks[c].load(std::memory_order_relaxed);
+
+            if (chunk && (info = chunk->entries[node->id() & (CHUNK_SIZE-1)].load(std::memory_order_relaxed)))
+                return info;
+        } else {
+            auto it = overflow.find(node->id());
+
+            if (it != overflow.end())
+                return it->second;
+        }
+
+        records.emplace_back();
+
+        InfoRecord& r = records.back();
+
+        r.name = node->data().to_string();
+        r.info = AttributeInfo { node->id(), type, prop, scope, r.name.c_str(), r.name.size(), node };
+
+        insert(node->id(), &r.info);
+
+        return &r.info;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex>
+            g(lock);
+
+        for (size_t c = 0; c < NUM_CHUNKS; ++c)
+            delete chunks[c].exchange(nullptr);
+
+        overflow.clear();
+        records.clear();
+    }
+
+    AttributeInfoTableImpl() {
+        for (size_t c = 0; c < NUM_CHUNKS; ++c)
+            chunks[c].store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~AttributeInfoTableImpl() {
+        for (size_t c = 0; c < NUM_CHUNKS; ++c)
+            delete chunks[c].load();
+    }
+};
+
+
+AttributeInfoTable::AttributeInfoTable()
+    : mP(new AttributeInfoTableImpl)
+{ }
+
+AttributeInfoTable::~AttributeInfoTable()
+{
+    mP.reset();
+}
+
+const AttributeInfo*
+AttributeInfoTable::get(cali_id_t id) const
+{
+    return mP->get(id);
+}
+
+const AttributeInfo*
+AttributeInfoTable::get_or_create(const Node* node, const MetaAttributeIDs* keys)
+{
+    return mP->get_or_create(node, keys);
+}
+
+void
+AttributeInfoTable::clear()
+{
+    mP->clear();
+}
@@ -0,0 +1,80 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+/// @file AttributeInfoTable.h
+/// AttributeInfoTable class declaration
+
+#ifndef CALI_ATTRIBUTEINFOTABLE_H
+#define CALI_ATTRIBUTEINFOTABLE_H
+
+#include "Attribute.h"
+
+#include <memory>
+
+namespace cali
+{
+
+/// \brief Dense, id-indexed table of attribute descriptors
+///
+/// Descriptors are computed once from the attribute's metadata node path
+/// and stay valid for the lifetime of the table. Lookups by id are
+/// lock-free and async-signal safe; creation is serialized internally.
+class AttributeInfoTable
+{
+    struct AttributeInfoTableImpl;
+
+    std::unique_ptr<AttributeInfoTableImpl> mP;
+
+public:
+
+    AttributeInfoTable();
+
+    ~AttributeInfoTable();
+
+    AttributeInfoTable(const AttributeInfoTable&) = delete;
+    AttributeInfoTable& operator = (const AttributeInfoTable&) = delete;
+
+    /// \brief Return descriptor for attribute \a id, or \c nullptr if none exists yet
+    const AttributeInfo* get(cali_id_t id) const;
+
+    /// \brief Return descriptor for attribute node \a node, creating it if necessary.
+    /// Returns \c nullptr if \a node is not a valid attribute node.
+    const AttributeInfo* get_or_create(const Node* node, const MetaAttributeIDs* keys);
+
+    /// \brief Remove all descriptors. Not thread-safe: previously returned
+    ///   descriptors become invalid.
+    void clear();
+};
+
+} // namespace cali
+
+#endif // CALI_ATTRIBUTEINFOTABLE_H
@@ -75,18 +75,6 @@ void Node::push_record(WriteRecordFn fn) const
     fn(s_record, n, data);
 }
 
-// temporary - will go away
-void Node::write_path(WriteRecordFn fn)
-{
-    if (!written()) {
-        if (parent() && parent()->id() != CALI_INV_ID)
-            parent()->write_path(fn);
-            
-        push_record(fn);
-        m_written.store(true);
-    }
-}
-
 RecordMap Node::record() const
 {
     RecordMap recmap = {
@@ -63,8 +63,6 @@ class Node : public IdType, public util::LockfreeIntrusiveTree<Node>
     cali_id_t         m_attribute;
     Variant           m_data;
 
-    std::atomic<bool> m_written; // temporary implementation - will go away
-
     static const RecordDescriptor s_record;
 
 public:
@@ -72,7 +70,7 @@ public:
     Node(cali_id_t id, cali_id_t attr, const Variant& data)
         : IdType(id),
           util::LockfreeIntrusiveTree<Node>(this, &Node::m_treenode), 
-        m_attribute { attr }, m_data { data }, m_written { false }
+        m_attribute { attr }, m_data { data }
         { }
 
     Node(const Node&) = delete;
@@ -87,14 +85,15 @@ public:
 
     bool equals(cali_id_t attr, const void* data, size_t size) const;
 
+    /// \brief Compare attribute and data address. Only meaningful for data
+    ///   with unique addresses, e.g. interned strings.
+    bool equals_ptr(cali_id_t attr, const void* ptr) const {
+        return m_attribute == attr ? m_data.data() == ptr : false;
+    }
+
     cali_id_t attribute() const { return m_attribute; }
     Variant   data() const      { return m_data;      }    
 
-    // Temporary implementation - will go away
-    bool      written() const   { return m_written.load(); }
-    bool      check_written()   { return m_written.exchange(true); }
-    void      write_path(WriteRecordFn recfn);
-    
     /// @name Serialization API
     /// @{
 
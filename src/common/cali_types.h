@@ -89,6 +89,11 @@ typedef enum {
   CALI_OP_MAX = 3
 } cali_op;
 
+typedef enum {
+  CALI_LOOP_BUCKET_LINEAR = 0, /* fixed-size buckets of N iterations */
+  CALI_LOOP_BUCKET_LOG2   = 1  /* power-of-two sized buckets */
+} cali_loop_bucketing;
+
 typedef enum {
   CALI_SUCCESS = 0,
   CALI_EBUSY,
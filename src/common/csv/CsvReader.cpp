@@ -61,6 +61,24 @@ struct CsvReader::CsvReaderImpl
 
         return true;
     }
+
+    bool read(function<void(const RecordMap&)> rec_handler, const LineFilterFn& filter) {
+        ifstream is(m_filename.c_str());
+
+        if (!is)
+            return false;
+
+        for (string line ; getline(is, line); ) {
+            LineAction action = filter(line);
+
+            if (action == Stop)
+                break;
+            if (action == Parse)
+                rec_handler(CsvSpec::read_record(line));
+        }
+
+        return true;
+    }
 };
 
 CsvReader::CsvReader(const string& filename)
@@ -75,3 +93,9 @@ CsvReader::read(function<void(const RecordMap&)> rec_handler)
 {
     return mP->read(rec_handler);
 }
+
+bool
+CsvReader::read(function<void(const RecordMap&)> rec_handler, LineFilterFn filter)
+{
+    return mP->read(rec_handler, filter);
+}
@@ -54,11 +54,20 @@ class CsvReader
 
 public:
 
+    /// Result of a line filter: parse the line, skip it, or stop reading
+    enum LineAction { Parse, Skip, Stop };
+
+    typedef std::function<LineAction(const std::string&)> LineFilterFn;
+
     CsvReader(const std::string& filename);
 
     ~CsvReader();
 
     bool read(std::function<void(const RecordMap&)>);
+
+    /// Read records, but pass each raw line through @param filter first.
+    /// Skipped lines are never parsed into a RecordMap.
+    bool read(std::function<void(const RecordMap&)>, LineFilterFn filter);
 };
 
 } // namespace cali
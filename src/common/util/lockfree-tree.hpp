@@ -13,7 +13,7 @@ public:
 
     struct Node {
         T* parent;
-        T* next;
+        std::atomic<T*> next;
         std::atomic<T*> head;
 
         Node()
@@ -68,6 +68,33 @@ public:
                                                std::memory_order_relaxed));
     }
 
+    /// \brief Unlink child \a sub from this node's child list.
+    ///
+    /// Safe with concurrent append() calls and traversals, but only one
+    /// thread may remove children at any time. \a sub keeps its own
+    /// parent and sibling links, so traversals currently at \a sub can
+    /// continue. Returns \c false if \a sub is not a child of this node.
+    bool remove(T* sub) {
+        LockfreeIntrusiveTree<T>::Node& n = node(m_me);
+
+        T* next = node(sub).next.load();
+        T* head = sub;
+
+        if (n.head.compare_exchange_strong(head, next))
+            return true;
+
+        // append() only adds nodes at the head, so the predecessor of sub
+        // is somewhere between the current head and sub
+
+        for (T* p = head; p; p = node(p).next.load())
+            if (node(p).next.load() == sub) {
+                node(p).next.store(next);
+                return true;
+            }
+
+        return false;
+    }
+
     // 
     // --- Iterators ---------------------------------------------------------
     //
@@ -24,6 +24,10 @@ public:
             ;
     }
 
+    bool try_lock() {
+        return !m_lock.test_and_set(std::memory_order_acquire);
+    }
+
     void unlock() {
         m_lock.clear(std::memory_order_release);
     }
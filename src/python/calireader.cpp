@@ -36,13 +36,300 @@
 // Include Python.h first because it may redefine some C stdlib macros
 #include <Python.h>
 
+#if PY_MAJOR_VERSION < 3
+#error "calireader requires Python 3"
+#endif
+
 #include <SimpleReader.h>
+
+#include <Node.h>
 using namespace cali;
 
+#include <cmath>
+#include <cstring>
 #include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+
+/// A typed column. Numeric attributes are stored as native arrays,
+/// everything else (strings, nested node paths) as dictionary-encoded 
+/// int32 codes. Each column has a validity mask (one byte per row).
+struct Column
+{
+    union Value {
+        double   d;
+        int64_t  i;
+        uint64_t u;
+        int32_t  code;
+    };
+
+    std::string                name;
+    cali_attr_type             type;
+    char                       format; ///< Python buffer format character
+
+    std::vector<Value>         data;   ///< One value per row (narrowed on export)
+    std::vector<unsigned char> valid;
+
+    std::vector<std::string>                 dictionary;
+    std::unordered_map<std::string, int32_t> codes;
+
+    Column(const std::string& n, cali_attr_type t)
+        : name(n), type(t)
+        {
+            switch (type) {
+            case CALI_TYPE_DOUBLE:
+                format = 'd';
+                break;
+            case CALI_TYPE_INT:
+                format = 'q';
+                break;
+            case CALI_TYPE_UINT:
+            case CALI_TYPE_ADDR:
+                format = 'Q';
+                break;
+            default:
+                format = 'i';
+            }
+        }
+
+    bool is_numeric() const {
+        return format != 'i';
+    }
+
+    Value make_value(const Variant& v) {
+        Value val;
+
+        switch (format) {
+        case 'd':
+            val.d = v.to_double();
+            break;
+        case 'q':
+            val.i = v.to_int();
+            break;
+        case 'Q':
+            val.u = v.to_uint();
+            break;
+        default:
+            val.code = encode(v.to_string());
+        }
+
+        return val;
+    }
+
+    int32_t encode(const std::string& str) {
+        auto it = codes.find(str);
+
+        if (it != codes.end())
+            return it->second;
+
+        int32_t code = static_cast<int32_t>(dictionary.size());
+
+        dictionary.push_back(str);
+        codes.insert(std::make_pair(str, code));
+
+        return code;
+    }
+
+    /// Fill rows up to (excluding) @param row with missing values
+    void pad(size_t row) {
+        Value missing;
+
+        if (format == 'd')
+            missing.d = NAN;
+        else if (format == 'i')
+            missing.code = -1;
+        else
+            missing.u = 0;
+
+        data.resize(row, missing);
+        valid.resize(row, 0);
+    }
+
+    void set(size_t row, Value v) {
+        if (data.size() > row) // keep first value per row
+            return;
+
+        pad(row);
+        data.push_back(v);
+        valid.push_back(1);
+    }
+
+    /// Export as (format, data, valid, dictionary) tuple of Python objects
+    PyObject* to_python() const {
+        size_t      n = data.size();
+        std::string buf;
+
+        if (format == 'i') {
+            buf.resize(n * sizeof(int32_t));
+
+            for (size_t i = 0; i < n; ++i)
+                memcpy(&buf[i * sizeof(int32_t)], &data[i].code, sizeof(int32_t));
+        } else {
+            buf.resize(n * sizeof(Value));
+            
+            if (n > 0)
+                memcpy(&buf[0], data.data(), n * sizeof(Value));
+        }
+
+        PyObject* py_dict = Py_None;
+
+        if (format == 'i') {
+            py_dict = PyList_New(dictionary.size());
+
+            for (size_t i = 0; i < dictionary.size(); ++i)
+                PyList_SET_ITEM(py_dict, i, PyUnicode_FromString(dictionary[i].c_str()));
+        } else {
+            Py_INCREF(py_dict);
+        }
+
+        return Py_BuildValue("(NNNN)",
+                             PyUnicode_FromStringAndSize(&format, 1),
+                             PyByteArray_FromStringAndSize(buf.data(), buf.size()),
+                             PyByteArray_FromStringAndSize(reinterpret_cast<const char*>(valid.data()), valid.size()),
+                             py_dict);
+    }
+};
+
+class ColumnReader
+{
+    CaliperMetadataDB&                      m_db;
+
+    std::vector<Column*>                    m_columns;
+    std::unordered_map<cali_id_t, Column*>  m_column_map;
+
+    struct NodeValue {
+        Column*       column;
+        Column::Value value;
+    };
+
+    /// Decoded values of the node paths seen so far
+    std::unordered_map<const Node*, std::vector<NodeValue> > m_node_values;
+
+    Column* column(cali_id_t attr_id) {
+        auto it = m_column_map.find(attr_id);
+
+        if (it != m_column_map.end())
+            return it->second;
+
+        Attribute attr = m_db.attribute(attr_id);
+        Column*   col  = new Column(attr.name(), attr.type());
+
+        m_columns.push_back(col);
+        m_column_map.insert(std::make_pair(attr_id, col));
+
+        return col;
+    }
+
+    const std::vector<NodeValue>& node_values(const Node* node) {
+        auto it = m_node_values.find(node);
+
+        if (it != m_node_values.end())
+            return it->second;
+
+        // Collect path per attribute. Numeric columns take the innermost 
+        // value, others join all values top-down with '/'
+
+        std::vector<NodeValue> values;
+        std::vector< std::pair<Column*, std::string> > paths;
+
+        for (const Node* n = node; n && n->attribute() != CALI_INV_ID; n = n->parent()) {
+            Column* col = column(n->attribute());
+
+            if (col->is_numeric()) {
+                bool found = false;
+
+                for (const NodeValue& nv : values)
+                    found = found || (nv.column == col);
+
+                if (!found)
+                    values.push_back(NodeValue { col, col->make_value(n->data()) });
+            } else {
+                auto pit = paths.begin();
+
+                for ( ; pit != paths.end() && pit->first != col; ++pit)
+                    ;
+
+                if (pit == paths.end())
+                    paths.push_back(std::make_pair(col, n->data().to_string()));
+                else
+                    pit->second = n->data().to_string() + "/" + pit->second;
+            }
+        }
+
+        for (auto &p : paths) {
+            Column::Value v;
+            v.code = p.first->encode(p.second);
+            values.push_back(NodeValue { p.first, v });
+        }
+
+        return m_node_values.insert(std::make_pair(node, values)).first->second;
+    }
+
+public:
+
+    ColumnReader(CaliperMetadataDB& db)
+        : m_db(db)
+        { }
+
+    ~ColumnReader() {
+        for (Column* col : m_columns)
+            delete col;
+    }
+
+    void add_row(size_t row, const EntryList& list) {
+        for (const Entry& e : list)
+            if (e.node()) {
+                for (const NodeValue& nv : node_values(e.node()))
+                    nv.column->set(row, nv.value);
+            } else if (e.is_immediate()) {
+                Column* col = column(e.attribute());
+                col->set(row, col->make_value(e.value()));
+            }
+    }
+
+    PyObject* to_python(size_t rows) {
+        PyObject* result = PyDict_New();
+
+        for (Column* col : m_columns) {
+            col->pad(rows);
+
+            PyObject* value = col->to_python();
+            PyDict_SetItemString(result, col->name.c_str(), value);
+            Py_DECREF(value);
+        }
+
+        return result;
+    }
+};
+
+} // namespace [anonymous]
 
 extern "C" {
 
+/// Read a cali file into columns. Returns a dict that maps attribute names 
+/// to (format, data, valid, dictionary) tuples. data and valid are 
+/// bytearrays; format is the buffer format character of data ('d', 'q', 
+/// 'Q', or 'i' for dictionary codes into the dictionary list). 
+PyObject* read_cali_file_columns(const char *filename) {
+    SimpleReader sr;
+    sr.open(std::string(filename));
+
+    ColumnReader reader(sr.metadb());
+    EntryList    list;
+    size_t       rows = 0;
+
+    while (sr.next_snapshot(list))
+        reader.add_row(rows++, list);
+
+    PyObject* columns = reader.to_python(rows);
+    PyObject* result  = Py_BuildValue("(nN)", static_cast<Py_ssize_t>(rows), columns);
+
+    return result;
+}
+
 PyObject* read_cali_file(const char *filename) {
 
     PyObject *result = PyDict_New();
@@ -58,21 +345,12 @@ PyObject* read_cali_file(const char *filename) {
         PyObject *row = PyDict_New();
 
         for (auto attr : rec) {
-#if PY_MAJOR_VERSION < 3
-            PyObject *key = PyString_FromString(attr.first.c_str());
-            PyObject *value = PyString_FromString(attr.second.to_string().c_str());
-#else
             PyObject *key = PyUnicode_FromString(attr.first.c_str());
-            PyObject *value = PyUnicode_FromString(attr.second.to_string().c_str());            
-#endif
+            PyObject *value = PyUnicode_FromString(attr.second.to_string().c_str());
             PyDict_SetItem(row, key, value);
         }
 
-#if PY_MAJOR_VERSION < 3        
-        PyObject *rowkey = PyInt_FromLong(i++);
-#else
         PyObject *rowkey = PyLong_FromLong(i++);
-#endif
         
         PyDict_SetItem(result, rowkey, row);
     }
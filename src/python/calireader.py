@@ -1,8 +1,72 @@
-from ctypes import cdll, py_object
-lib = cdll.LoadLibrary('./libcalireader.so')
+# Python 3 only: columns are exported through memoryview.cast()
+
+import os
+from ctypes import PyDLL, py_object, c_char_p
+lib = PyDLL(os.path.join(os.path.dirname(os.path.abspath(__file__)), 'libcalireader.so'))
 
 lib.read_cali_file.restype = py_object
+lib.read_cali_file.argtypes = [ c_char_p ]
+
+lib.read_cali_file_columns.restype = py_object
+lib.read_cali_file_columns.argtypes = [ c_char_p ]
+
+def _encode(filename):
+        if isinstance(filename, bytes):
+                return filename
+        return filename.encode()
 
 def read_cali_file(filename):
-        return lib.read_cali_file(filename)
-    
+        return lib.read_cali_file(_encode(filename))
+
+class DictionaryColumn(object):
+        """A dictionary-encoded string column.
+
+        codes is an int32 buffer with one index into dictionary per row,
+        or -1 for missing values.
+        """
+        def __init__(self, codes, dictionary, valid):
+                self.codes      = codes
+                self.dictionary = dictionary
+                self.valid      = valid
+
+        def __len__(self):
+                return len(self.codes)
+
+        def __getitem__(self, i):
+                code = self.codes[i]
+                return self.dictionary[code] if code >= 0 else None
+
+class NumericColumn(object):
+        """A typed numeric column. values is a buffer of doubles ('d'),
+        int64 ('q') or uint64 ('Q'); valid holds one byte per row.
+        """
+        def __init__(self, values, valid):
+                self.values = values
+                self.valid  = valid
+
+        def __len__(self):
+                return len(self.values)
+
+        def __getitem__(self, i):
+                return self.values[i] if self.valid[i] else None
+
+def read_cali_file_columns(filename):
+        """Read a cali file into a dict of columns, keyed by attribute name.
+
+        Column data is exported through the buffer protocol, e.g.
+        numpy.frombuffer(col.values, dtype='f8') or
+        numpy.asarray(col.codes) give arrays without copying.
+        """
+        rows, columns = lib.read_cali_file_columns(_encode(filename))
+        result = {}
+
+        for name, (fmt, data, valid, dictionary) in columns.items():
+                values = memoryview(data).cast(fmt)
+                valid  = memoryview(valid)
+
+                if dictionary is None:
+                        result[name] = NumericColumn(values, valid)
+                else:
+                        result[name] = DictionaryColumn(values, dictionary, valid)
+
+        return rows, result
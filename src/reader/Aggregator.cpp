@@ -49,33 +49,218 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <mutex>
 
 using namespace cali;
 using namespace std;
 
-#define MAX_KEYLEN 32
+#define MAX_KEYLEN       32
+#define SPILL_PARTITIONS 16
+#define SPILL_MAX_LEVEL  15
 
-class AggregateKernel {
-public:
+//
+// --- Inline kernel state
+//
 
-    virtual ~AggregateKernel()
-        { }
+/// Aggregation state of one kernel for one key.
+/// Stored inline in the aggregation table, and written as-is to spill files.
+struct AggregateState {
+    union Value {
+        double   d;
+        int64_t  i;
+        uint64_t u;
+    };
     
-    virtual void aggregate(CaliperMetadataDB& db, const EntryList& list) = 0;
-    virtual void append_result(CaliperMetadataDB& db, EntryList& list) = 0;
+    uint64_t count;
+    Value    sum;
+    Value    min;
+    Value    max;
+    double   sqsum; ///< Sum of squares, for sampling error estimates
 };
 
-class AggregateKernelConfig
+namespace
+{
+
+Variant make_variant(cali_attr_type type, const AggregateState::Value& v)
+{
+    switch (type) {
+    case CALI_TYPE_DOUBLE:
+        return Variant(v.d);
+    case CALI_TYPE_INT:
+        return Variant(CALI_TYPE_INT,  &v.i, sizeof(int64_t));
+    case CALI_TYPE_UINT:
+        return Variant(CALI_TYPE_UINT, &v.u, sizeof(uint64_t));
+    default:
+        return Variant();
+    }
+}
+
+bool is_numeric(cali_attr_type type)
+{
+    return type == CALI_TYPE_DOUBLE || type == CALI_TYPE_INT || type == CALI_TYPE_UINT;
+}
+
+void add(cali_attr_type type, AggregateState::Value& a, const AggregateState::Value& b)
 {
+    switch (type) {
+    case CALI_TYPE_DOUBLE:
+        a.d += b.d;
+        break;
+    case CALI_TYPE_INT:
+        a.i += b.i;
+        break;
+    case CALI_TYPE_UINT:
+        a.u += b.u;
+        break;
+    default:
+        ;
+    }
+}
+
+void set_min(cali_attr_type type, AggregateState::Value& a, const AggregateState::Value& b)
+{
+    switch (type) {
+    case CALI_TYPE_DOUBLE:
+        a.d = std::min(a.d, b.d);
+        break;
+    case CALI_TYPE_INT:
+        a.i = std::min(a.i, b.i);
+        break;
+    case CALI_TYPE_UINT:
+        a.u = std::min(a.u, b.u);
+        break;
+    default:
+        ;
+    }
+}
+
+void set_max(cali_attr_type type, AggregateState::Value& a, const AggregateState::Value& b)
+{
+    switch (type) {
+    case CALI_TYPE_DOUBLE:
+        a.d = std::max(a.d, b.d);
+        break;
+    case CALI_TYPE_INT:
+        a.i = std::max(a.i, b.i);
+        break;
+    case CALI_TYPE_UINT:
+        a.u = std::max(a.u, b.u);
+        break;
+    default:
+        ;
+    }
+}
+
+AggregateState::Value to_value(cali_attr_type type, const Variant& v)
+{
+    AggregateState::Value ret;
+
+    switch (type) {
+    case CALI_TYPE_DOUBLE:
+        ret.d = v.to_double();
+        break;
+    case CALI_TYPE_INT:
+        ret.i = v.to_int();
+        break;
+    default:
+        ret.u = v.to_uint();
+    }
+
+    return ret;
+}
+
+/// Scale value @param v by @param f
+AggregateState::Value scale(cali_attr_type type, const AggregateState::Value& v, double f)
+{
+    AggregateState::Value ret;
+
+    switch (type) {
+    case CALI_TYPE_DOUBLE:
+        ret.d = v.d * f;
+        break;
+    case CALI_TYPE_INT:
+        ret.i = static_cast<int64_t>(std::llround(v.i * f));
+        break;
+    default:
+        ret.u = static_cast<uint64_t>(std::llround(v.u * f));
+    }
+
+    return ret;
+}
+
+double to_double(cali_attr_type type, const AggregateState::Value& v)
+{
+    switch (type) {
+    case CALI_TYPE_DOUBLE:
+        return v.d;
+    case CALI_TYPE_INT:
+        return static_cast<double>(v.i);
+    default:
+        return static_cast<double>(v.u);
+    }
+}
+
+uint64_t hash_key(const unsigned char* key, size_t len)
+{
+    // FNV-1a
+    uint64_t h = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < len; ++i) {
+        h ^= key[i];
+        h *= 1099511628211ULL;
+    }
+
+    return h;
+}
+
+} // namespace [anonymous]
+
+//
+// --- Kernels
+//   A kernel object exists once per aggregation operator. It operates on the
+// AggregateState stored for each key in the aggregation table.
+//
+
+class AggregateKernel {
+protected:
+
+    double m_sample_rate;
+
+    /// Standard error of a sum estimated from a Bernoulli sample of
+    /// rate p, given the sample's sum of squares
+    double sampling_error(double sqsum) const {
+        return std::sqrt((1.0 - m_sample_rate) * sqsum) / m_sample_rate;
+    }
+
+    Attribute error_attribute(CaliperMetadataDB& db, const std::string& name) {
+        return db.create_attribute("aggregate.stderr#" + name, CALI_TYPE_DOUBLE,
+                                   CALI_ATTR_SKIP_EVENTS | CALI_ATTR_ASVALUE);
+    }
+
 public:
 
-    virtual ~AggregateKernelConfig()
+    AggregateKernel()
+        : m_sample_rate(1.0)
+        { }
+
+    virtual ~AggregateKernel()
         { }
 
-    virtual AggregateKernel* make_kernel() = 0;
+    /// Set the rate at which the input snapshots were sampled. Count and
+    /// sum results are scaled accordingly, and come with error estimates.
+    void set_sample_rate(double rate) {
+        m_sample_rate = rate;
+    }
+
+    virtual void aggregate(CaliperMetadataDB& db, const EntryList& list, AggregateState* state) = 0;
+    virtual void merge(AggregateState* state, const AggregateState* from) = 0;
+    virtual void append_result(CaliperMetadataDB& db, const AggregateState* state, EntryList& list) = 0;
 };
 
 
@@ -83,54 +268,50 @@ public:
 // --- CountKernel
 //
 
-class CountKernel : public AggregateKernel {    
-public:
-
-    class Config : public AggregateKernelConfig {
-        Attribute m_attr;
+class CountKernel : public AggregateKernel {
+    Attribute m_attr;
 
-    public:
+public:
 
-        Attribute attribute(CaliperMetadataDB& db) {
-            if (m_attr == Attribute::invalid)
-                m_attr = db.create_attribute("aggregate.count", CALI_TYPE_UINT, CALI_ATTR_ASVALUE);
+    Attribute attribute(CaliperMetadataDB& db) {
+        if (m_attr == Attribute::invalid)
+            m_attr = db.create_attribute("aggregate.count", CALI_TYPE_UINT, CALI_ATTR_ASVALUE);
 
-            return m_attr;
-        }        
-        
-        AggregateKernel* make_kernel() {
-            return new CountKernel(this);
-        }
+        return m_attr;
+    }        
 
-        Config()
-            : m_attr { Attribute::invalid }
-            { }
+    CountKernel()
+        : m_attr { Attribute::invalid }
+        { }
 
-        static AggregateKernelConfig* create(const std::string&) {
-            return new Config;
-        }
-    };
+    static AggregateKernel* create(const std::string&) {
+        return new CountKernel;
+    }
 
-    CountKernel(Config* config)
-        : m_count(0), m_config(config)
-        { }
-    
-    virtual void aggregate(CaliperMetadataDB&, const EntryList&) {
-        ++m_count;
+    virtual void aggregate(CaliperMetadataDB&, const EntryList&, AggregateState* state) {
+        ++state->count;
     }
 
-    virtual void append_result(CaliperMetadataDB& db, EntryList& list) {
-        uint64_t count = m_count.load();
-        
-        if (count > 0)
-            list.push_back(Entry(m_config->attribute(db),
-                                 Variant(CALI_TYPE_UINT, &count, sizeof(uint64_t))));
+    virtual void merge(AggregateState* state, const AggregateState* from) {
+        state->count += from->count;
     }
 
-private:
+    virtual void append_result(CaliperMetadataDB& db, const AggregateState* state, EntryList& list) {
+        uint64_t count = state->count;
+
+        if (count == 0)
+            return;
 
-    std::atomic<uint64_t> m_count;
-    Config*  m_config;
+        if (m_sample_rate < 1.0) {
+            list.push_back(Entry(error_attribute(db, "aggregate.count"),
+                                 Variant(sampling_error(static_cast<double>(count)))));
+
+            count = static_cast<uint64_t>(std::llround(count / m_sample_rate));
+        }
+
+        list.push_back(Entry(attribute(db),
+                             Variant(CALI_TYPE_UINT, &count, sizeof(uint64_t))));
+    }
 };
 
 
@@ -139,268 +320,294 @@ private:
 //
 
 class SumKernel : public AggregateKernel {
-public:
+protected:
+    
+    std::string    m_aggr_attr_name;
+    Attribute      m_aggr_attr;
+    cali_attr_type m_aggr_type;
+
+    Attribute get_aggr_attr(CaliperMetadataDB& db) {
+        if (m_aggr_attr == Attribute::invalid) {
+            m_aggr_attr = db.attribute(m_aggr_attr_name);
+            m_aggr_type = m_aggr_attr.type();
+        }
 
-    class Config : public AggregateKernelConfig {
-        std::string m_aggr_attr_name;
-        Attribute   m_aggr_attr;
-        
-    public:
+        return m_aggr_attr;
+    }
 
-        Attribute get_aggr_attr(CaliperMetadataDB& db) {
-            if (m_aggr_attr == Attribute::invalid)
-                m_aggr_attr = db.attribute(m_aggr_attr_name);
+    /// Find value of the aggregation attribute in @param list
+    bool find_value(CaliperMetadataDB& db, const EntryList& list, AggregateState::Value& val) {
+        Attribute aggr_attr = get_aggr_attr(db);
 
-            return m_aggr_attr;
-        }
-        
-        AggregateKernel* make_kernel() {
-            return new SumKernel(this);
-        }
+        if (aggr_attr == Attribute::invalid || !is_numeric(m_aggr_type))
+            return false;
 
-        Config(const std::string& name)
-            : m_aggr_attr_name(name),
-              m_aggr_attr(Attribute::invalid)
-            {
-                Log(2).stream() << "aggregate: creating sum kernel for attribute " << m_aggr_attr_name << std::endl;
+        for (const Entry& e : list)
+            if (e.attribute() == aggr_attr.id()) {
+                val = to_value(m_aggr_type, e.value());
+                return true;
             }
 
-        static AggregateKernelConfig* create(const std::string& cfg) {
-            return new Config(cfg);
-        }        
-    };
-
-    SumKernel(Config* config)
-        : m_count(0), m_config(config)
-        { }
-    
-    virtual void aggregate(CaliperMetadataDB& db, const EntryList& list) {
-        std::lock_guard<std::mutex>
-            g(m_lock);
+        return false;
+    }
         
-        Attribute aggr_attr = m_config->get_aggr_attr(db);
+public:
+
+    SumKernel(const std::string& name)
+        : m_aggr_attr_name(name),
+          m_aggr_attr(Attribute::invalid),
+          m_aggr_type(CALI_TYPE_INV)
+        {
+            Log(2).stream() << "aggregate: creating sum kernel for attribute " << m_aggr_attr_name << std::endl;
+        }
 
-        if (aggr_attr == Attribute::invalid)
+    static AggregateKernel* create(const std::string& cfg) {
+        return new SumKernel(cfg);
+    }
+
+    virtual void aggregate(CaliperMetadataDB& db, const EntryList& list, AggregateState* state) {
+        AggregateState::Value val;
+
+        if (!find_value(db, list, val))
             return;
-            
-        for (const Entry& e : list) {
-            if (e.attribute() == aggr_attr.id()) {
-                switch (aggr_attr.type()) {
-                case CALI_TYPE_DOUBLE:
-                    m_sum = Variant(m_sum.to_double() + e.value().to_double());
-                    break;
-                case CALI_TYPE_INT:
-                    m_sum = Variant(m_sum.to_int()    + e.value().to_int()   );
-                    break;
-                case CALI_TYPE_UINT:
-                    m_sum = Variant(m_sum.to_uint()   + e.value().to_uint()  );
-                    break;
-                default:
-                    ;
-                    // Some error?!
-                }
 
-                ++m_count;
-                
-                break;
-            }
-        }
+        if (state->count == 0)
+            state->sum = val;
+        else
+            add(m_aggr_type, state->sum, val);
+
+        double d = to_double(m_aggr_type, val);
+
+        state->sqsum += d * d;
+        ++state->count;
     }
 
-    virtual void append_result(CaliperMetadataDB& db, EntryList& list) {
-        if (m_count > 0)
-            list.push_back(Entry(m_config->get_aggr_attr(db), m_sum));
+    virtual void merge(AggregateState* state, const AggregateState* from) {
+        if (from->count == 0)
+            return;
+
+        if (state->count == 0)
+            state->sum = from->sum;
+        else
+            add(m_aggr_type, state->sum, from->sum);
+
+        state->sqsum += from->sqsum;
+        state->count += from->count;
     }
 
-private:
+    virtual void append_result(CaliperMetadataDB& db, const AggregateState* state, EntryList& list) {
+        if (state->count == 0)
+            return;
 
-    unsigned   m_count;
-    Variant    m_sum;
-    std::mutex m_lock;
-    Config*    m_config;
+        if (m_sample_rate < 1.0) {
+            list.push_back(Entry(error_attribute(db, m_aggr_attr_name),
+                                 Variant(sampling_error(state->sqsum))));
+            list.push_back(Entry(get_aggr_attr(db),
+                                 make_variant(m_aggr_type, scale(m_aggr_type, state->sum, 1.0/m_sample_rate))));
+        } else {
+            list.push_back(Entry(get_aggr_attr(db), make_variant(m_aggr_type, state->sum)));
+        }
+    }
 };
 
 //
 // --- StatisticsKernel
 //
 
-class StatisticsKernel : public AggregateKernel {
-public:
+class StatisticsKernel : public SumKernel {
+    Attribute   m_avg_attr;
+    Attribute   m_min_attr;
+    Attribute   m_max_attr;
 
-    class Config : public AggregateKernelConfig {
-        std::string m_aggr_attr_name;
-        Attribute   m_aggr_attr;
+    Attribute get_avg_attribute(CaliperMetadataDB& db) {
+        if (m_avg_attr == Attribute::invalid)
+            m_avg_attr =
+                db.create_attribute("aggregate.avg#" + m_aggr_attr_name,
+                                    CALI_TYPE_DOUBLE,
+                                    CALI_ATTR_SKIP_EVENTS | CALI_ATTR_ASVALUE);
 
-        Attribute   m_avg_attr;
-        Attribute   m_min_attr;
-        Attribute   m_max_attr;
+        return m_avg_attr;
+    }
+
+    Attribute get_min_attribute(CaliperMetadataDB& db) {
+        if (m_min_attr == Attribute::invalid)
+            m_min_attr =
+                db.create_attribute("aggregate.min#" + m_aggr_attr_name,
+                                    m_aggr_type,
+                                    CALI_ATTR_SKIP_EVENTS | CALI_ATTR_ASVALUE);
 
+        return m_min_attr;
+    }
         
-    public:
+    Attribute get_max_attribute(CaliperMetadataDB& db) {
+        if (m_max_attr == Attribute::invalid)
+            m_max_attr =
+                db.create_attribute("aggregate.max#" + m_aggr_attr_name,
+                                    m_aggr_type,
+                                    CALI_ATTR_SKIP_EVENTS | CALI_ATTR_ASVALUE);
+
+        return m_max_attr;
+    }
 
-        Attribute get_aggr_attr(CaliperMetadataDB& db) {
-            if (m_aggr_attr == Attribute::invalid)
-                m_aggr_attr = db.attribute(m_aggr_attr_name);
+public:
 
-            return m_aggr_attr;
-        }
+    StatisticsKernel(const std::string& name)
+        : SumKernel(name),
+          m_avg_attr(Attribute::invalid),
+          m_min_attr(Attribute::invalid),
+          m_max_attr(Attribute::invalid)
+        { }
 
-        Attribute get_avg_attribute(CaliperMetadataDB& db) {
-            if (m_aggr_attr == Attribute::invalid)
-                return Attribute::invalid;
-            if (m_avg_attr == Attribute::invalid)
-                m_avg_attr =
-                    db.create_attribute("aggregate.avg#" + m_aggr_attr_name,
-                                        CALI_TYPE_DOUBLE,
-                                        CALI_ATTR_SKIP_EVENTS | CALI_ATTR_ASVALUE);
+    static AggregateKernel* create(const std::string& cfg) {
+        return new StatisticsKernel(cfg);
+    }
+    
+    virtual void aggregate(CaliperMetadataDB& db, const EntryList& list, AggregateState* state) {
+        AggregateState::Value val;
+
+        if (!find_value(db, list, val))
+            return;
 
-            return m_avg_attr;
+        if (state->count == 0) {
+            state->sum = state->min = state->max = val;
+        } else {
+            add(m_aggr_type, state->sum, val);
+            set_min(m_aggr_type, state->min, val);
+            set_max(m_aggr_type, state->max, val);
         }
 
-        Attribute get_min_attribute(CaliperMetadataDB& db) {
-            if (m_aggr_attr == Attribute::invalid)
-                return Attribute::invalid;            
-            if (m_min_attr == Attribute::invalid)
-                m_min_attr =
-                    db.create_attribute("aggregate.min#" + m_aggr_attr_name,
-                                        m_aggr_attr.type(),
-                                        CALI_ATTR_SKIP_EVENTS | CALI_ATTR_ASVALUE);
+        ++state->count;
+    }
 
-            return m_min_attr;
-        }
-        
-        Attribute get_max_attribute(CaliperMetadataDB& db) {
-            if (m_aggr_attr == Attribute::invalid)
-                return Attribute::invalid;            
-            if (m_max_attr == Attribute::invalid)
-                m_max_attr =
-                    db.create_attribute("aggregate.max#" + m_aggr_attr_name,
-                                        m_aggr_attr.type(),
-                                        CALI_ATTR_SKIP_EVENTS | CALI_ATTR_ASVALUE);
-
-            return m_max_attr;
+    virtual void merge(AggregateState* state, const AggregateState* from) {
+        if (from->count == 0)
+            return;
+
+        if (state->count == 0) {
+            *state = *from;
+            return;
         }
-                
-        AggregateKernel* make_kernel() {
-            return new StatisticsKernel(this);
+
+        add(m_aggr_type, state->sum, from->sum);
+        set_min(m_aggr_type, state->min, from->min);
+        set_max(m_aggr_type, state->max, from->max);
+
+        state->count += from->count;
+    }
+
+    virtual void append_result(CaliperMetadataDB& db, const AggregateState* state, EntryList& list) {
+        if (state->count > 0) {
+            list.push_back(Entry(get_avg_attribute(db),
+                                 make_variant(m_aggr_type, state->sum).to_double() / state->count));
+            list.push_back(Entry(get_min_attribute(db), make_variant(m_aggr_type, state->min)));
+            list.push_back(Entry(get_max_attribute(db), make_variant(m_aggr_type, state->max)));
         }
+    }
+};
 
-        Config(const std::string& name)
-            : m_aggr_attr_name(name),
-              m_aggr_attr(Attribute::invalid),
-              m_avg_attr(Attribute::invalid),
-              m_min_attr(Attribute::invalid),
-              m_max_attr(Attribute::invalid)
-            {
-                Log(2).stream() << "aggregate: creating sum kernel for attribute " << m_aggr_attr_name << std::endl;
-            }
 
-        static AggregateKernelConfig* create(const std::string& cfg) {
-            return new Config(cfg);
-        }        
-    };
+const struct KernelInfo {
+    const char* name;
+    AggregateKernel* (*create)(const std::string& cfg);
+} kernel_list[] = {
+    { "count",      CountKernel::create      },
+    { "sum",        SumKernel::create        },
+    { "statistics", StatisticsKernel::create },
+    { 0, 0 }
+};
 
-    StatisticsKernel(Config* config)
-        : m_count(0), m_sum(0), m_config(config)
-        { }
+
+//
+// --- AggregationTable
+//
+
+/// Open-addressing hash table mapping packed aggregation keys to the
+/// inline kernel states for that key.
+class AggregationTable {
+    struct KeyRef {
+        uint64_t hash;
+        uint32_t pos;  ///< Key position in m_keys
+        uint32_t len;
+    };
     
-    virtual void aggregate(CaliperMetadataDB& db, const EntryList& list) {
-        std::lock_guard<std::mutex>
-            g(m_lock);
-        
-        Attribute aggr_attr = m_config->get_aggr_attr(db);
+    size_t                 m_num_kernels;
 
-        if (aggr_attr == Attribute::invalid)
-            return;
-            
-        for (const Entry& e : list) {
-            if (e.attribute() == aggr_attr.id()) {
-                switch (aggr_attr.type()) {
-                case CALI_TYPE_DOUBLE:
-                    {
-                        if (m_min.empty())
-                            m_min = Variant(std::numeric_limits<double>::max());
-                        if (m_max.empty())
-                            m_max = Variant(std::numeric_limits<double>::min());
-                        
-                        double val = e.value().to_double();                        
-                    
-                        m_sum = Variant(m_sum.to_double() + val);
-                        m_min = Variant(std::min(m_min.to_double(), val));
-                        m_max = Variant(std::max(m_max.to_double(), val));
-                    }
-                    break;
-                case CALI_TYPE_INT:
-                    {
-                        if (m_min.empty())
-                            m_min = Variant(std::numeric_limits<int>::max());
-                        if (m_max.empty())
-                            m_max = Variant(std::numeric_limits<int>::min());
-
-                        int val = e.value().to_int();
-                    
-                        m_sum = Variant(m_sum.to_int() + val);
-                        m_min = Variant(std::min(m_min.to_int(), val));
-                        m_max = Variant(std::max(m_max.to_int(), val));
-                    }
-                    break;
-                case CALI_TYPE_UINT:
-                    {
-                        if (m_min.empty())
-                            m_min = Variant(std::numeric_limits<uint64_t>::max());
-                        if (m_max.empty())
-                            m_max = Variant(std::numeric_limits<uint64_t>::min());
-
-                        uint64_t val = e.value().to_uint();
-                    
-                        m_sum = Variant(m_sum.to_uint() + val);
-                        m_min = Variant(std::min(m_min.to_uint(), val));
-                        m_max = Variant(std::max(m_max.to_uint(), val));
-                    }
-                    break;
-                default:
-                    ;
-                    // Some error?!
-                }
+    vector<unsigned char>  m_keys;    ///< Key bytes of all entries
+    vector<KeyRef>         m_entries;
+    vector<AggregateState> m_states;  ///< m_num_kernels states per entry
+    vector<uint32_t>       m_buckets; ///< Entry index + 1, or 0 if empty
 
-                ++m_count;
-                
-                break;
-            }
+    void grow() {
+        size_t n = std::max<size_t>(64, 2 * m_buckets.size());
+
+        m_buckets.assign(n, 0);
+
+        for (size_t i = 0; i < m_entries.size(); ++i) {
+            size_t b = m_entries[i].hash & (n - 1);
+
+            while (m_buckets[b])
+                b = (b + 1) & (n - 1);
+
+            m_buckets[b] = static_cast<uint32_t>(i + 1);
         }
     }
 
-    virtual void append_result(CaliperMetadataDB& db, EntryList& list) {
-        if (m_count > 0) {
-            list.push_back(Entry(m_config->get_avg_attribute(db),
-                                 m_sum.to_double() / m_count));
-            list.push_back(Entry(m_config->get_min_attribute(db), m_min));
-            list.push_back(Entry(m_config->get_max_attribute(db), m_max));
+public:
+
+    AggregationTable(size_t num_kernels)
+        : m_num_kernels(num_kernels)
+        { }
+
+    AggregateState* find_or_create(const unsigned char* key, size_t len, uint64_t hash) {
+        if (2 * (m_entries.size() + 1) > m_buckets.size())
+            grow();
+
+        size_t mask = m_buckets.size() - 1;
+        size_t b    = hash & mask;
+
+        for ( ; m_buckets[b]; b = (b + 1) & mask) {
+            size_t        i = m_buckets[b] - 1;
+            const KeyRef& k = m_entries[i];
+
+            if (k.hash == hash && k.len == len && memcmp(m_keys.data() + k.pos, key, len) == 0)
+                return m_states.data() + i * m_num_kernels;
         }
-    }
 
-private:
+        KeyRef k = { hash, static_cast<uint32_t>(m_keys.size()), static_cast<uint32_t>(len) };
 
-    unsigned   m_count;
-    
-    Variant    m_sum;
-    Variant    m_min;
-    Variant    m_max;
+        m_keys.insert(m_keys.end(), key, key + len);
+        m_entries.push_back(k);
+        m_states.resize(m_states.size() + m_num_kernels, AggregateState());
 
-    std::mutex m_lock;
-    
-    Config*    m_config;
-};
+        m_buckets[b] = static_cast<uint32_t>(m_entries.size());
 
+        return m_states.data() + (m_entries.size() - 1) * m_num_kernels;
+    }
 
-const struct KernelInfo {
-    const char* name;
-    AggregateKernelConfig* (*create)(const std::string& cfg);
-} kernel_list[] = {
-    { "count",      CountKernel::Config::create      },
-    { "sum",        SumKernel::Config::create        },
-    { "statistics", StatisticsKernel::Config::create },
-    { 0, 0 }
+    size_t size() const {
+        return m_entries.size();
+    }
+
+    size_t memory_usage() const {
+        return m_keys.capacity()    * sizeof(unsigned char)
+            +  m_entries.capacity() * sizeof(KeyRef)
+            +  m_states.capacity()  * sizeof(AggregateState)
+            +  m_buckets.capacity() * sizeof(uint32_t);
+    }
+
+    void clear() {
+        vector<unsigned char>().swap(m_keys);
+        vector<KeyRef>().swap(m_entries);
+        vector<AggregateState>().swap(m_states);
+        vector<uint32_t>().swap(m_buckets);
+    }
+
+    template<typename Fn>
+    void for_each(Fn fn) {
+        for (size_t i = 0; i < m_entries.size(); ++i)
+            fn(m_keys.data() + m_entries[i].pos, m_entries[i].len, m_entries[i].hash,
+               m_states.data() + i * m_num_kernels);
+    }
 };
 
 
@@ -408,27 +615,19 @@ struct Aggregator::AggregatorImpl
 {
     // --- data
 
-    vector<string>         m_key_strings;
-    vector<cali_id_t>      m_key_ids;
-    std::mutex             m_key_lock;
+    vector<string>           m_key_strings;
+    vector<cali_id_t>        m_key_ids;
+    std::mutex               m_key_lock;
 
-    bool                   m_select_all;
-    
-    vector<AggregateKernelConfig*> m_kernel_configs;
+    bool                     m_select_all;
     
-    struct TrieNode {
-        uint32_t next[256] = { 0 };
-        vector<AggregateKernel*> kernels;
-
-        ~TrieNode() {
-            for (AggregateKernel* k : kernels)
-                delete k;
-            kernels.clear();
-        }
-    };
+    vector<AggregateKernel*> m_kernels;
 
-    std::vector<TrieNode*> m_trie;    
-    std::mutex             m_trie_lock;
+    AggregationTable*        m_table;
+    std::mutex               m_table_lock;
+
+    size_t                   m_memory_budget;
+    vector<FILE*>            m_spill_files;
     
     //
     // --- parse config
@@ -460,50 +659,80 @@ struct Aggregator::AggregatorImpl
                 ;
 
             if (ki->create)
-                m_kernel_configs.push_back((*ki->create)(kernelconfig));
+                m_kernels.push_back((*ki->create)(kernelconfig));
             else
                 Log(0).stream() << "aggregator: unknown aggregation kernel \"" << kernelname << "\"" << std::endl;
         }
     }
-    
+
     //
-    // --- aggregation db ops
+    // --- spilling
+    //   Spill files hold (key length, key, kernel states) records. Entries 
+    // are partitioned by hash so that all states for a key end up in the
+    // same file.
     //
-    
-    TrieNode* get_trienode(uint32_t id) {
-        // Assume trie is locked!!
-        
-        if (id >= m_trie.size())
-            m_trie.resize(id+1);
 
-        if (!m_trie[id])
-            m_trie[id] = new TrieNode;
+    void write_entry(FILE* f, const unsigned char* key, size_t len, const AggregateState* states) {
+        uint32_t len32 = static_cast<uint32_t>(len);
 
-        return m_trie[id];
+        if (fwrite(&len32, sizeof(uint32_t), 1, f) != 1 ||
+            fwrite(key, 1, len, f) != len ||
+            fwrite(states, sizeof(AggregateState), m_kernels.size(), f) != m_kernels.size())
+            Log(0).stream() << "aggregator: error writing spill file" << std::endl;
     }
 
-    TrieNode* find_trienode(size_t n, unsigned char* key) {
-        std::lock_guard<std::mutex>
-            g(m_trie_lock);
+    bool read_entry(FILE* f, unsigned char* key, size_t* len, AggregateState* states) {
+        uint32_t len32 = 0;
 
-        TrieNode* trie = get_trienode(0);
+        if (fread(&len32, sizeof(uint32_t), 1, f) != 1 || len32 > MAX_KEYLEN)
+            return false;
+        if (fread(key, 1, len32, f) != len32)
+            return false;
+        if (fread(states, sizeof(AggregateState), m_kernels.size(), f) != m_kernels.size())
+            return false;
 
-        for ( size_t i = 0; trie && i < n; ++i ) {
-            uint32_t id = trie->next[key[i]];
+        *len = len32;
 
-            if (!id) {
-                id = static_cast<uint32_t>(m_trie.size()+1);
-                trie->next[key[i]] = id;
-            }
+        return true;
+    }
 
-            trie = get_trienode(id);
+    /// Write the entries of @param table into the partitioned spill 
+    /// @param files, and clear the table. Creates the spill files if 
+    /// necessary.
+    /// \return false if the spill files could not be created. The table
+    ///   is left as is in that case.
+    bool spill(AggregationTable* table, vector<FILE*>& files, unsigned level) {
+        if (files.empty()) {
+            files.assign(SPILL_PARTITIONS, nullptr);
+
+            for (FILE*& f : files)
+                if (!(f = tmpfile())) {
+                    Log(0).stream() << "aggregator: could not create spill file, "
+                                    << "disabling spilling (memory budget will be exceeded)"
+                                    << std::endl;
+
+                    close_files(files);
+                    return false;
+                }
         }
 
-        if (trie->kernels.empty())
-            for (AggregateKernelConfig* c : m_kernel_configs)
-                trie->kernels.push_back(c->make_kernel());
-        
-        return trie;
+        Log(2).stream() << "aggregator: spilling " << table->size() << " entries" << std::endl;
+
+        table->for_each([&](const unsigned char* key, size_t len, uint64_t hash, const AggregateState* states) {
+                write_entry(files[(hash >> (4*level)) % SPILL_PARTITIONS], key, len, states);
+            });
+
+        table->clear();
+
+        return true;
+    }
+
+    void close_files(vector<FILE*>& files) {
+        for (FILE* f : files)
+            if (f)
+                fclose(f);
+
+        files.clear();
     }
 
     //
@@ -620,16 +849,21 @@ struct Aggregator::AggregatorImpl
 
         unsigned char key[MAX_KEYLEN];
         size_t        pos  = pack_key(key_node, immediates, db, key);
+        uint64_t      hash = hash_key(key, pos);
 
-        TrieNode*     trie = find_trienode(pos, key);
+        // --- Aggregate
 
-        if (!trie)
-            return;
+        std::lock_guard<std::mutex>
+            g(m_table_lock);
 
-        // --- Aggregate
+        AggregateState* states = m_table->find_or_create(key, pos, hash);
         
-        for (AggregateKernel* k : trie->kernels)
-            k->aggregate(db, list);
+        for (size_t i = 0; i < m_kernels.size(); ++i)
+            m_kernels[i]->aggregate(db, list, states + i);
+
+        if (m_memory_budget > 0 && m_table->memory_usage() > m_memory_budget)
+            if (!spill(m_table, m_spill_files, 0))
+                m_memory_budget = 0; // keep aggregating in memory
     }
 
     //
@@ -655,76 +889,111 @@ struct Aggregator::AggregatorImpl
                 list.push_back(Entry(db.attribute(id), data));
         }
     }
-    
-    void recursive_flush(size_t n, unsigned char* key, TrieNode* trie,
-                         CaliperMetadataDB& db, const SnapshotProcessFn push) {
-        if (!trie)
-            return;
 
-        // --- Write current entry (if it represents a snapshot)
-        
-        if (!trie->kernels.empty()) {
-            EntryList list;
+    void flush_table(AggregationTable* table, CaliperMetadataDB& db, const SnapshotProcessFn push) {
+        table->for_each([&](const unsigned char* key, size_t len, uint64_t, const AggregateState* states) {
+                EntryList list;
 
-            // Decode & add key node entry
-            unpack_key(key, db, list);
+                // vldec peeks at the byte after a value: decode from a zero-padded copy
+                unsigned char buf[MAX_KEYLEN+1] = { 0 };
+                memcpy(buf, key, std::min<size_t>(len, MAX_KEYLEN));
 
-            // Write aggregation variables
-            for (AggregateKernel* k : trie->kernels)
-                k->append_result(db, list);
+                // Decode & add key node entry
+                unpack_key(buf, db, list);
 
-            push(db, list);
-        }
+                // Write aggregation variables
+                for (size_t i = 0; i < m_kernels.size(); ++i)
+                    m_kernels[i]->append_result(db, states + i, list);
 
-        // --- Recursively iterate over subsequent DB entries
+                push(db, list);
+            });
+    }
 
-        unsigned char* next_key = static_cast<unsigned char*>(alloca(n+2));
+    /// Merge the partially aggregated entries in spill file @param f, and 
+    /// flush the result. Re-partitions the file if the merged entries 
+    /// exceed the memory budget.
+    void merge_spill_file(FILE* f, unsigned level, CaliperMetadataDB& db, const SnapshotProcessFn push) {
+        rewind(f);
 
-        memset(next_key, 0, n+2);
-        memcpy(next_key, key, n);
-        
-        for (size_t i = 0; i < 256; ++i) {
-            if (trie->next[i] == 0)
-                continue;
+        AggregationTable       table(m_kernels.size());
+        vector<FILE*>          files;
+
+        unsigned char          key[MAX_KEYLEN];
+        size_t                 len = 0;
+        vector<AggregateState> buf(m_kernels.size());
+
+        bool                   can_spill = m_memory_budget > 0 && level < SPILL_MAX_LEVEL;
+
+        while (read_entry(f, key, &len, buf.data())) {
+            AggregateState* states = table.find_or_create(key, len, hash_key(key, len));
+
+            for (size_t i = 0; i < m_kernels.size(); ++i)
+                m_kernels[i]->merge(states + i, buf.data() + i);
+
+            if (can_spill && table.memory_usage() > m_memory_budget)
+                can_spill = spill(&table, files, level+1);
+        }
 
-            TrieNode* next = get_trienode(trie->next[i]);
-            next_key[n]    = static_cast<unsigned char>(i);
+        if (files.empty()) {
+            flush_table(&table, db, push);
+        } else {
+            spill(&table, files, level+1);
 
-            recursive_flush(n+1, next_key, next, db, push);
+            for (FILE* subf : files)
+                if (subf)
+                    merge_spill_file(subf, level+1, db, push);
+
+            close_files(files);
         }
     }
     
     void flush(CaliperMetadataDB& db, const SnapshotProcessFn push) {
         // NOTE: No locking: we assume flush() runs serially!
-        
-        TrieNode*     trie = get_trienode(0);
-        unsigned char key  = 0;
 
-        recursive_flush(0, &key, trie, db, push);
+        if (m_spill_files.empty()) {
+            flush_table(m_table, db, push);
+        } else {
+            spill(m_table, m_spill_files, 0);
+
+            for (FILE* f : m_spill_files)
+                if (f)
+                    merge_spill_file(f, 0, db, push);
+
+            close_files(m_spill_files);
+        }
     }
 
-    AggregatorImpl() {
-        m_trie.reserve(4096);
+    AggregatorImpl(size_t memory_budget)
+        : m_table(nullptr), m_memory_budget(memory_budget)
+        { }
+
+    void init() {
+        m_table = new AggregationTable(m_kernels.size());
+    }
+
+    void set_sample_rate(double rate) {
+        for (AggregateKernel* k : m_kernels)
+            k->set_sample_rate(rate);
     }
     
     ~AggregatorImpl() {
-        for (TrieNode* e : m_trie)
-            delete e;
+        close_files(m_spill_files);
 
-        m_trie.clear();
-        
-        for (AggregateKernelConfig* c : m_kernel_configs)
-            delete c;
+        delete m_table;
 
-        m_kernel_configs.clear();
+        for (AggregateKernel* k : m_kernels)
+            delete k;
+
+        m_kernels.clear();
     }
 };
 
-Aggregator::Aggregator(const string& aggr_config, const string& key)
-    : mP { new AggregatorImpl() }
+Aggregator::Aggregator(const string& aggr_config, const string& key, size_t memory_budget)
+    : mP { new AggregatorImpl(memory_budget) }
 {
     mP->parse_aggr_config(aggr_config);
     mP->parse_key(key);
+    mP->init();
 }
 
 Aggregator::~Aggregator()
@@ -738,6 +1007,12 @@ Aggregator::flush(CaliperMetadataDB& db, SnapshotProcessFn& push)
     mP->flush(db, push);
 }
 
+void
+Aggregator::set_sample_rate(double rate)
+{
+    mP->set_sample_rate(rate);
+}
+
 void
 Aggregator::operator()(CaliperMetadataDB& db, const EntryList& list)
 {
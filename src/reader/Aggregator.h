@@ -53,10 +53,19 @@ class Aggregator
 
 public:
 
-    Aggregator(const std::string& aggr_config, const std::string& key);
+    /// Create an aggregator with the given aggregation operators and key.
+    /// If @param memory_budget (in bytes) is non-zero, partially aggregated
+    /// data is spilled to temporary files when the aggregation table grows 
+    /// beyond the budget, and merged back in flush().
+    Aggregator(const std::string& aggr_config, const std::string& key, size_t memory_budget = 0);
 
     ~Aggregator();
 
+    /// Declare that the input snapshots are a random sample taken with 
+    /// probability @param rate. Scales count and sum results accordingly,
+    /// and adds standard error estimates as aggregate.stderr#<attribute>.
+    void set_sample_rate(double rate);
+
     void operator()(CaliperMetadataDB&, const EntryList&);
 
     void flush(CaliperMetadataDB&, SnapshotProcessFn& push);
@@ -37,6 +37,7 @@
 
 #include <csv/CsvReader.h>
 
+#include <AttributeInfoTable.h>
 #include <Log.h>
 #include <Node.h>
 #include <RecordMap.h>
@@ -58,11 +59,15 @@ struct CaliperMetadataDB::CaliperMetadataDBImpl
     mutable mutex             m_node_lock;
 
     MetaAttributeIDs          m_attr_keys = MetaAttributeIDs::invalid;
+    AttributeInfoTable        m_attr_info;   ///< Attribute descriptors
 
     Node*                     m_type_nodes[CALI_MAXTYPE+1] = { 0 };
     
     map<string, Node*>        m_attributes;
     mutable mutex             m_attribute_lock;
+
+    vector<bool>              m_written;      ///< Nodes written by write_path()
+    mutex                     m_written_lock;
     
     void setup_bootstrap_nodes() {
         // Create initial nodes
@@ -325,24 +330,37 @@ struct CaliperMetadataDB::CaliperMetadataDBImpl
             snap_fn(*db, merge_ctx_record_to_list(rec, idmap));
     }
 
-    Attribute attribute(cali_id_t id) const {
-        std::lock_guard<std::mutex>
-            g(m_node_lock);
+    Attribute make_attribute(const Node* node) {
+        return Attribute::make_attribute(m_attr_info.get_or_create(node, &m_attr_keys));
+    }
+
+    Attribute attribute(cali_id_t id) {
+        const AttributeInfo* info = m_attr_info.get(id);
+
+        if (info)
+            return Attribute::make_attribute(info);
         
-        if (id >= m_nodes.size())
-            return Attribute::invalid;
+        const Node* node = nullptr;
+
+        {
+            std::lock_guard<std::mutex>
+                g(m_node_lock);
+        
+            if (id < m_nodes.size())
+                node = m_nodes[id];
+        }
 
-        return Attribute::make_attribute(m_nodes[id], &m_attr_keys);
+        return make_attribute(node);
     }
 
-    Attribute attribute(const std::string& name) const {
+    Attribute attribute(const std::string& name) {
         std::lock_guard<std::mutex>
             g(m_attribute_lock);
         
         auto it = m_attributes.find(name);
 
         return it == m_attributes.end() ? Attribute::invalid :
-            Attribute::make_attribute(it->second, &m_attr_keys);
+            make_attribute(it->second);
     }
     
     bool read(const char* filename) {
@@ -352,6 +370,7 @@ struct CaliperMetadataDB::CaliperMetadataDBImpl
         m_nodes.clear();
 
         m_attr_keys = MetaAttributeIDs::invalid;
+        m_attr_info.clear();
 
         CsvReader reader(filename);
 
@@ -402,7 +421,7 @@ struct CaliperMetadataDB::CaliperMetadataDBImpl
         auto it = m_attributes.lower_bound(name);
 
         if (it != m_attributes.end() && it->first == name)
-            return Attribute::make_attribute(it->second, &m_attr_keys);
+            return make_attribute(it->second);
 
         // --- Create attribute
         
@@ -416,7 +435,7 @@ struct CaliperMetadataDB::CaliperMetadataDBImpl
 
         m_attributes.insert(make_pair(string(name), node));
         
-        return Attribute::make_attribute(node, &m_attr_keys);
+        return make_attribute(node);
     }
     
     CaliperMetadataDBImpl()
@@ -495,11 +514,28 @@ CaliperMetadataDB::create_attribute(const std::string& name, cali_attr_type type
     return mP->create_attribute(name, type, prop);
 }
 
-Node* 
-CaliperMetadataDB::mutable_node(cali_id_t id) 
+void
+CaliperMetadataDB::write_path(cali_id_t id, WriteRecordFn fn)
 {
     std::lock_guard<std::mutex>
-        g(mP->m_node_lock);
-    
-    return (id < mP->m_nodes.size()) ? mP->m_nodes[id] : nullptr;
+        g(mP->m_written_lock);
+
+    vector<const Node*> path;
+
+    for (const Node* node = this->node(id); node && node->id() != CALI_INV_ID; node = node->parent()) {
+        if (node->id() < mP->m_written.size() && mP->m_written[node->id()])
+            break;
+
+        path.push_back(node);
+    }
+
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+        cali_id_t node_id = (*it)->id();
+
+        if (node_id >= mP->m_written.size())
+            mP->m_written.resize(node_id + 1, false);
+
+        (*it)->push_record(fn);
+        mP->m_written[node_id] = true;
+    }
 }
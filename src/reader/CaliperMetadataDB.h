@@ -39,6 +39,7 @@
 #include "RecordProcessor.h"
 
 #include "Attribute.h"
+#include "Record.h"
 #include "RecordMap.h"
 
 #include <map>
@@ -89,8 +90,13 @@ public:
     const Node* make_entry(size_t n, const Attribute* attr, const Variant* value);
     Attribute   create_attribute(const std::string& name, cali_attr_type type, int prop);
 
-    // awful kludge till we find solution for node writing problem
-    Node*       mutable_node(cali_id_t);
+    //
+    // --- Output
+    //
+
+    /// \brief Write records of node \a id and its ancestors to \a fn,
+    ///   root first, skipping nodes this DB has already written.
+    void        write_path(cali_id_t id, WriteRecordFn fn);
 };
 
 }
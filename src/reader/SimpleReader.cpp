@@ -33,43 +33,244 @@
 /// @file SimpleReader.cpp
 /// A high-level API for parsing cali files
 
+#include "SimpleReader.h"
+
 #include <ContextRecord.h>
 
-#include "SimpleReader.h"
+#include <csv/CsvSpec.h>
+
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 using namespace cali;
 using namespace std;
 
+struct SimpleReader::SimpleReaderImpl
+{
+    CaliperMetadataDB   metadb;
+    IdMap               idmap;
+
+    // --- Block prefetching
+    //   The prefetch thread fills next_block while the reader consumes 
+    // block. Both are swapped when block is exhausted, so the line 
+    // buffers are re-used.
+
+    static const size_t block_size = 1024; // lines per block
+
+    ifstream            califile;
+    thread              prefetch_thread;
+
+    vector<string>      block;
+    size_t              block_count = 0;   ///< Number of valid lines in block
+    size_t              block_pos   = 0;
+    bool                last_block  = true;
+
+    vector<string>      next_block;
+    size_t              next_count  = 0;
+    bool                next_ready  = false;
+    bool                eof         = false; ///< Prefetch thread reached end of file
+    bool                stop        = false; ///< Early termination request
+
+    mutex               lock;
+    condition_variable  cv;
+
+    void prefetch() {
+        vector<string> buf(block_size);
+
+        while (true) {
+            size_t n = 0;
+
+            while (n < block_size && getline(califile, buf[n]))
+                ++n;
+
+            unique_lock<mutex> g(lock);
+
+            cv.wait(g, [this](){ return !next_ready || stop; });
+
+            if (stop)
+                return;
+
+            swap(next_block, buf);
+
+            next_count = n;
+            next_ready = true;
+            eof        = (n < block_size);
+
+            cv.notify_all();
+
+            if (eof)
+                return;
+
+            if (buf.size() < block_size)
+                buf.resize(block_size);
+        }
+    }
+
+    const string* next_line() {
+        while (block_pos >= block_count) {
+            if (last_block)
+                return nullptr;
+
+            {
+                unique_lock<mutex> g(lock);
+
+                cv.wait(g, [this](){ return next_ready; });
+
+                swap(block, next_block);
+
+                block_count = next_count;
+                block_pos   = 0;
+                last_block  = eof;
+                next_ready  = false;
+            }
+
+            cv.notify_all();
+        }
+
+        return &block[block_pos++];
+    }
+
+    void open(const string& filename) {
+        close();
+
+        califile.open(filename, ifstream::in);
+
+        block_count = block_pos = next_count = 0;
+        next_ready  = eof = stop = false;
+        last_block  = !califile.is_open();
+
+        if (califile.is_open())
+            prefetch_thread = thread(&SimpleReaderImpl::prefetch, this);
+    }
+
+    void close() {
+        {
+            lock_guard<mutex> g(lock);
+            stop = true;
+        }
+
+        cv.notify_all();
+
+        if (prefetch_thread.joinable())
+            prefetch_thread.join();
+
+        if (califile.is_open())
+            califile.close();
+
+        last_block = true;
+        block_pos  = block_count = 0;
+    }
+
+    bool next_record(RecordMap& rec) {
+        const string* line = nullptr;
+
+        while ((line = next_line()) != nullptr) {
+            if (line->empty())
+                continue;
+
+            rec = metadb.merge(CsvSpec::read_record(*line), idmap);
+
+            auto it = rec.find("__rec");
+
+            if (it != rec.end() && !it->second.empty())
+                return true;
+        }
+
+        return false;
+    }
+
+    bool next_ctx_record(RecordMap& rec) {
+        while (next_record(rec))
+            if (rec["__rec"].front().to_string() == "ctx")
+                return true;
+
+        return false;
+    }
+
+    bool next_snapshot(EntryList& list) {
+        RecordMap rec;
+
+        if (!next_ctx_record(rec))
+            return false;
+
+        list.clear();
+
+        auto r_it = rec.find("ref");
+
+        if (r_it != rec.end())
+            for (const Variant& v : r_it->second) {
+                const Node* node = metadb.node(v.to_id());
+
+                if (node)
+                    list.push_back(Entry(node));
+            }
+
+        auto a_it = rec.find("attr");
+        auto d_it = rec.find("data");
+
+        if (a_it != rec.end() && d_it != rec.end() && a_it->second.size() == d_it->second.size())
+            for (size_t i = 0; i < a_it->second.size(); ++i)
+                list.push_back(Entry(metadb.attribute(a_it->second[i].to_id()), d_it->second[i]));
+
+        return true;
+    }
+
+    ~SimpleReaderImpl() {
+        close();
+    }
+};
+
+const size_t SimpleReader::SimpleReaderImpl::block_size;
+
 SimpleReader::SimpleReader()
+    : mP { new SimpleReaderImpl }
+{
+}
+
+SimpleReader::~SimpleReader()
 {
+    mP.reset();
 }
 
 void SimpleReader::open(const string &filename)
 {
-    califile.open(filename, ifstream::in);
+    mP->open(filename);
+}
+
+void SimpleReader::close()
+{
+    mP->close();
+}
+
+bool SimpleReader::next_snapshot(EntryList& list)
+{
+    return mP->next_snapshot(list);
 }
 
 bool SimpleReader::nextSnapshot(ExpandedRecordMap &rec)
 {
-    string line;
     RecordMap record;
 
-    while (true) {
-        if (!getline(califile, line)) {
-            return false;
-        }
+    if (!mP->next_ctx_record(record))
+        return false;
 
-        record = metadb.merge(CsvSpec::read_record(line), idmap);
+    record = ContextRecord::unpack(record, std::bind(&CaliperMetadataDB::node, &mP->metadb, std::placeholders::_1));
+            
+    for (auto attr : record)
+        rec[attr.first] = attr.second.at(0);
 
-        if (record["__rec"].at(0).to_string() == "ctx") {
+    return true;
+}
 
-            record = ContextRecord::unpack(record, std::bind(&CaliperMetadataDB::node, &metadb, std::placeholders::_1));
-            
-            for (auto attr : record) {
-                rec[attr.first] = attr.second.at(0);
-            }
+bool SimpleReader::next(RecordMap &rec)
+{
+    return mP->next_record(rec);
+}
 
-            return true;
-        }
-    }
+CaliperMetadataDB& SimpleReader::metadb()
+{
+    return mP->metadb;
 }
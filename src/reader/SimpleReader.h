@@ -36,7 +36,7 @@
 #ifndef CALI_SIMPLEREADER_H
 #define CALI_SIMPLEREADER_H
 
-#include "csv/CsvSpec.h"
+#include "RecordProcessor.h"
 
 #include "RecordMap.h"
 #include "Variant.h"
@@ -44,30 +44,46 @@
 #include "CaliperMetadataDB.h"
 
 #include <map>
+#include <memory>
 #include <string>
-#include <fstream>
 
 namespace cali
 {
 
-class CaliperMetadataDB;
-class CsvSpec;
-
 typedef std::map<std::string, Variant> ExpandedRecordMap;
 
+/// A pull-based reader for a single cali stream.
+/// Lines are read ahead in blocks on a background thread, so the caller 
+/// can interleave its own processing with the file I/O.
 class SimpleReader
 {
-    private:
-        std::ifstream       califile;
+    struct SimpleReaderImpl;
+    std::unique_ptr<SimpleReaderImpl> mP;
+
+public:
+
+    SimpleReader();
+
+    ~SimpleReader();
+
+    void open(const std::string &filename);
+
+    /// Stop reading the stream. Can be used to terminate early.
+    void close();
+
+    /// Read the next snapshot into @param list. Replaces the list's 
+    /// contents but re-uses its storage. 
+    /// @return false at the end of the stream
+    bool next_snapshot(EntryList& list);
+
+    /// Read the next snapshot and expand it into attribute name/value pairs
+    bool nextSnapshot(ExpandedRecordMap &rec);
 
-        CaliperMetadataDB   metadb;
-        IdMap               idmap;
+    /// Read the next record, with ids mapped to the reader's metadata DB
+    bool next(RecordMap &rec);
 
-    public:
-        SimpleReader();
-        void open(const std::string &filename);
-        bool nextSnapshot(ExpandedRecordMap &rec);
-        bool next(RecordMap &rec);
+    /// The metadata DB holding the nodes and attributes of the stream
+    CaliperMetadataDB& metadb();
 };
 
 } // namespace cali
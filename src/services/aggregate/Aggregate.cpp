@@ -64,6 +64,9 @@ using namespace std;
 #define MAX_KEYLEN         128
 #define SNAP_MAX            80 // max snapshot size
 
+#define KEYCACHE_SIZE     1024 // number of key cache slots (power of 2)
+#define KEYCACHE_MAX_NODES   8 // max snapshot nodes in a key cache entry
+
 //
 // --- Class for the per-thread aggregation database
 //
@@ -79,29 +82,63 @@ class AggregateDB {
     AggregateDB*             m_next;
     AggregateDB*             m_prev;
 
-    std::vector<Attribute>   m_aggr_attributes;
-
     // the actual aggregation db
 
-    struct AggregateKernel  {
-        double   min;
-        double   max;
-        double   sum;
-        int      count;
+    // Aggregation operators, selected per aggregation attribute
+    enum AggregateOp {
+        AGGR_MIN = 1, AGGR_MAX = 2, AGGR_SUM = 4
+    };
 
-        AggregateKernel()
-            : min(std::numeric_limits<double>::max()),
-              max(std::numeric_limits<double>::min()),
-              sum(0), count(0)
-        { }
+    // One accumulator word. Each entry holds, for each aggregation
+    // attribute, a value count followed by one word per selected
+    // operator (min, max, sum). Integer attributes (e.g. counters) are
+    // accumulated natively.
+    union AggregateValue {
+        uint64_t u;
+        int64_t  i;
+        double   d;
+    };
 
-        void add(double val) {
-            min  = std::min(min, val);
-            max  = std::max(max, val);
-            sum += val;
-            ++count;
+    template<typename T>
+    static void accumulate(int ops, AggregateValue* v, T val, T AggregateValue::*m) {
+        bool first = (v[0].u++ == 0);
+
+        ++v;
+
+        if (ops & AGGR_MIN) {
+            if (first || val < (*v).*m)
+                (*v).*m = val;
+            ++v;
         }
-    };
+        if (ops & AGGR_MAX) {
+            if (first || val > (*v).*m)
+                (*v).*m = val;
+            ++v;
+        }
+        if (ops & AGGR_SUM)
+            (*v).*m += val;
+    }
+
+    static void add_value(size_t a, AggregateValue* v, const Variant& val) {
+        int ops = s_aggr_attribute_ops[a];
+
+        switch (s_aggr_attribute_types[a]) {
+        case CALI_TYPE_INT:
+            accumulate<int64_t>(ops, v, val.type() == CALI_TYPE_INT ?
+                                *static_cast<const int64_t*>(val.data()) :
+                                static_cast<int64_t>(val.to_double()),
+                                &AggregateValue::i);
+            break;
+        case CALI_TYPE_UINT:
+            accumulate<uint64_t>(ops, v, val.type() == CALI_TYPE_UINT ?
+                                 val.to_uint() :
+                                 static_cast<uint64_t>(val.to_double()),
+                                 &AggregateValue::u);
+            break;
+        default:
+            accumulate<double>(ops, v, val.to_double(), &AggregateValue::d);
+        }
+    }
 
     struct TrieNode {
         uint32_t next[256] = { 0 };
@@ -124,7 +161,7 @@ class AggregateDB {
 
             if (!m_blocks[block]) {
                 if (alloc) {
-                    m_blocks[block] = new T[ENTRIES_PER_BLOCK];
+                    m_blocks[block] = new T[ENTRIES_PER_BLOCK]();
                     ++m_num_blocks;
                 } else
                     return 0;
@@ -156,13 +193,29 @@ class AggregateDB {
     };
 
     BlockAlloc<TrieNode>        m_trie;
-    BlockAlloc<AggregateKernel> m_kernels;
+    BlockAlloc<AggregateValue>  m_kernels;
+
+    // direct-mapped cache of snapshot node tuple -> key node id
+    // mappings for keyed aggregation
+
+    struct KeyCacheEntry {
+        uint64_t  tag;      // 0: empty slot
+        cali_id_t key_node; // CALI_INV_ID if the snapshot has no key nodes
+        size_t    n;
+        cali_id_t nodes[KEYCACHE_MAX_NODES];
+    };
+
+    KeyCacheEntry*           m_keycache;
+    unsigned                 m_keycache_gen;
+    std::atomic<bool>        m_keycache_valid;
 
     // we maintain some internal statistics
     size_t                   m_num_trie_entries;
     size_t                   m_num_kernel_entries;
     size_t                   m_num_dropped;
     size_t                   m_max_keylen;
+    size_t                   m_num_keycache_hits;
+    size_t                   m_num_keycache_misses;
 
     //
     // --- static data
@@ -172,6 +225,12 @@ class AggregateDB {
         Attribute min_attr;
         Attribute max_attr;
         Attribute sum_attr;
+
+        StatisticsAttributes()
+            : min_attr(Attribute::invalid),
+              max_attr(Attribute::invalid),
+              sum_attr(Attribute::invalid)
+        { }
     };
 
     static Attribute         s_count_attribute;
@@ -180,6 +239,12 @@ class AggregateDB {
     static vector<Attribute> s_key_attributes;
     static vector<string>    s_key_attribute_names;
     static vector<string>    s_aggr_attribute_names;
+    static vector<cali_id_t> s_aggr_attribute_ids;
+    static vector<int>       s_aggr_attribute_ops;
+    static vector<cali_attr_type>
+                             s_aggr_attribute_types;
+    static vector<size_t>    s_aggr_attribute_offsets;
+    static size_t            s_kernel_size;
     static vector<StatisticsAttributes>
                              s_stats_attributes;
 
@@ -192,6 +257,10 @@ class AggregateDB {
     static AggregateDB*      s_list;
     static util::spinlock    s_list_lock;
 
+    // incremented whenever a key attribute id changes
+    static std::atomic<unsigned>
+                             s_key_generation;
+
     // global statistics
     static size_t            s_global_num_trie_entries;
     static size_t            s_global_num_kernel_entries;
@@ -199,6 +268,8 @@ class AggregateDB {
     static size_t            s_global_num_kernel_blocks;
     static size_t            s_global_num_dropped;
     static size_t            s_global_max_keylen;
+    static size_t            s_global_num_keycache_hits;
+    static size_t            s_global_num_keycache_misses;
 
 
     //
@@ -212,6 +283,65 @@ class AggregateDB {
             m_prev->m_next = m_next;
     }
 
+    static uint64_t hash_nodes(size_t n, const Node* const* nodes) {
+        uint64_t h = 0xcbf29ce484222325ULL ^ n;
+
+        for (size_t i = 0; i < n; ++i)
+            h = (h ^ nodes[i]->id()) * 0x100000001b3ULL;
+
+        return (h ^ (h >> 29)) | 1;
+    }
+
+    KeyCacheEntry* keycache_slot(uint64_t tag) {
+        return m_keycache + ((tag >> 1) & (KEYCACHE_SIZE-1));
+    }
+
+    bool keycache_lookup(size_t n, const Node* const* nodes, uint64_t tag, cali_id_t* key_node) {
+        if (!m_keycache || !m_keycache_valid.load(std::memory_order_relaxed))
+            return false;
+
+        const KeyCacheEntry* e = keycache_slot(tag);
+
+        if (e->tag != tag || e->n != n)
+            return false;
+        for (size_t i = 0; i < n; ++i)
+            if (e->nodes[i] != nodes[i]->id())
+                return false;
+
+        *key_node = e->key_node;
+        return true;
+    }
+
+    // Only called outside of signal handlers. A signal handler
+    // interrupting the update sees an empty slot, so it is safe to read
+    // the cache from there.
+    void keycache_insert(size_t n, const Node* const* nodes, uint64_t tag, cali_id_t key_node) {
+        unsigned gen = s_key_generation.load();
+
+        if (!m_keycache) {
+            m_keycache = new KeyCacheEntry[KEYCACHE_SIZE]();
+            m_keycache_gen = gen;
+        } else if (m_keycache_gen != gen) {
+            // key attributes changed: previous mappings may be incomplete
+            m_keycache_valid.store(false);
+            std::fill_n(m_keycache, KEYCACHE_SIZE, KeyCacheEntry());
+            m_keycache_gen = gen;
+            m_keycache_valid.store(true);
+        }
+
+        KeyCacheEntry* e = keycache_slot(tag);
+
+        e->tag = 0;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+
+        e->key_node = key_node;
+        e->n        = n;
+        std::transform(nodes, nodes + n, e->nodes, [](const Node* node){ return node->id(); });
+
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        e->tag = tag;
+    }
+
     TrieNode* find_entry(size_t n, unsigned char* key, bool alloc) {
         TrieNode* entry = m_trie.get(0, alloc);
 
@@ -227,21 +357,25 @@ class AggregateDB {
         }
 
         if (entry && entry->k_id == 0xFFFFFFFF) {
-            uint32_t id = static_cast<uint32_t>(m_num_kernel_entries + 1);
+            // an entry's accumulators must not cross a block boundary
+            size_t   len = std::max<size_t>(1, s_kernel_size);
+            size_t   pos = m_num_kernel_entries + 1;
 
-            m_num_kernel_entries += std::max<size_t>(1, m_aggr_attributes.size());
+            if (pos % 1024 + len > 1024)
+                pos += 1024 - pos % 1024;
 
-            if (m_kernels.get(id, alloc) == 0)
+            if (m_kernels.get(pos, alloc) == 0)
                 return 0;
-            else
-                entry->k_id = id;
+
+            m_num_kernel_entries = pos + len - 1;
+            entry->k_id = static_cast<uint32_t>(pos);
         }
 
         return entry;
     }
 
     void write_aggregated_snapshot(const unsigned char* key, const TrieNode* entry,
-                                   Caliper* c, std::unordered_set<cali_id_t>& written_node_cache) {
+                                   Caliper* c) {
         // --- decode key
 
         size_t   p = 0;
@@ -249,73 +383,80 @@ class AggregateDB {
 
         Variant  node_vec[SNAP_MAX];
 
-        for (int i = 0; i < std::min(num_nodes, SNAP_MAX); ++i)
-            node_vec[i] = Variant(static_cast<cali_id_t>(vldec_u64(key + p, &p)));
+        for (int i = 0; i < num_nodes; ++i) {
+            cali_id_t id = static_cast<cali_id_t>(vldec_u64(key + p, &p));
 
-        // --- write aggregate entries
+            if (i < SNAP_MAX)
+                node_vec[i] = Variant(id);
+        }
 
-        int      num_aggr_attr = 1; // limit to single aggregation attribute for now
+        num_nodes = std::min(num_nodes, SNAP_MAX);
+
+        // --- immediate key entries
 
         Variant  attr_vec[SNAP_MAX];
         Variant  data_vec[SNAP_MAX];
 
-        int      ap = 0;
+        int      num_key_imm = static_cast<int>(vldec_u64(key + p, &p));
+        int      ip = 0;
 
-        for (int a = 0; a < std::min(num_aggr_attr, SNAP_MAX/3); ++a) {
-            AggregateKernel* k = m_kernels.get(entry->k_id+a, false);
+        for (int i = 0; i < num_key_imm && ip < SNAP_MAX/2; ++i) {
+            bool      ok   = true;
 
-            if (!k)
-                break;
-            if (k->count == 0)
-                continue;
+            cali_id_t id   = static_cast<cali_id_t>(vldec_u64(key + p, &p));
+            Variant   data = Variant::unpack(key + p, &p, &ok);
 
-            attr_vec[3*ap+0] = Variant(s_stats_attributes[a].min_attr.id());
-            attr_vec[3*ap+1] = Variant(s_stats_attributes[a].max_attr.id());
-            attr_vec[3*ap+2] = Variant(s_stats_attributes[a].sum_attr.id());
+            if (!ok)
+                break;
 
-            data_vec[3*ap+0] = Variant(k->min);
-            data_vec[3*ap+1] = Variant(k->max);
-            data_vec[3*ap+2] = Variant(k->sum);
+            attr_vec[ip] = Variant(id);
+            data_vec[ip] = data;
 
-            ++ap;
+            ++ip;
         }
 
-        uint64_t count = entry->count;
+        // --- write aggregate entries
 
-        attr_vec[3*ap] = s_count_attribute.id();
-        data_vec[3*ap] = Variant(CALI_TYPE_UINT, &count, sizeof(uint64_t));
+        int      num_aggr_attr = static_cast<int>(s_aggr_attribute_ids.size());
 
-        int      num_immediate = 3*ap + 1;
+        int      ap = ip;
 
-        // --- write nodes (FIXME: get rid of this awful node cache hack)
+        const AggregateValue* values = m_kernels.get(entry->k_id, false);
 
-        for (int i = 0; i < num_nodes; ++i) {
-            cali_id_t node_id = node_vec[i].to_id();
+        for (int a = 0; values && a < num_aggr_attr && ap + 4 < SNAP_MAX; ++a) {
+            const AggregateValue* v   = values + s_aggr_attribute_offsets[a];
+            int                   ops = s_aggr_attribute_ops[a];
 
-            if (written_node_cache.count(node_id))
+            if (v->u == 0)
                 continue;
 
-            Node* node = c->node(node_id);
+            cali_attr_type type = s_aggr_attribute_types[a];
 
-            if (node)
-                node->write_path(c->events().write_record);
-            else
-                Log(2).stream() << "aggregate: error: unknown node id " << node_id << std::endl;
-        }
-        for (int i = 0; i < num_immediate; ++i) {
-            cali_id_t node_id = attr_vec[i].to_id();
+            if (type != CALI_TYPE_INT && type != CALI_TYPE_UINT)
+                type = CALI_TYPE_DOUBLE;
 
-            if (written_node_cache.count(node_id))
-                continue;
+            const StatisticsAttributes& stats = s_stats_attributes[a];
+            const Attribute* op_attr[3] = { &stats.min_attr, &stats.max_attr, &stats.sum_attr };
 
-            Node* node = c->node(node_id);
+            ++v;
 
-            if (node)
-                node->write_path(c->events().write_record);
-            else
-                Log(2).stream() << "aggregate: error: unknown node id " << node_id << std::endl;
+            for (int op = 0; op < 3; ++op)
+                if (ops & (1 << op)) {
+                    attr_vec[ap] = Variant(op_attr[op]->id());
+                    data_vec[ap] = Variant(type, v, sizeof(AggregateValue));
+
+                    ++ap;
+                    ++v;
+                }
         }
 
+        uint64_t count = entry->count;
+
+        attr_vec[ap] = s_count_attribute.id();
+        data_vec[ap] = Variant(CALI_TYPE_UINT, &count, sizeof(uint64_t));
+
+        int      num_immediate = ap + 1;
+
         // --- write snapshot record
 
         int               n[3] = { num_nodes, num_immediate, num_immediate };
@@ -325,7 +466,7 @@ class AggregateDB {
     }
 
     size_t recursive_flush(size_t n, unsigned char* key, TrieNode* entry,
-                           Caliper* c, std::unordered_set<cali_id_t>& written_node_cache) {
+                           Caliper* c) {
         if (!entry)
             return 0;
 
@@ -334,7 +475,7 @@ class AggregateDB {
         // --- write current entry if it represents a snapshot
 
         if (entry->count > 0)
-            write_aggregated_snapshot(key, entry, c, written_node_cache);
+            write_aggregated_snapshot(key, entry, c);
 
         num_written += (entry->count > 0 ? 1 : 0);
 
@@ -352,7 +493,7 @@ class AggregateDB {
             TrieNode* e  = m_trie.get(entry->next[i], false);
             next_key[n]  = static_cast<unsigned char>(i);
 
-            num_written += recursive_flush(n+1, next_key, e, c, written_node_cache);
+            num_written += recursive_flush(n+1, next_key, e, c);
         }
 
         return num_written;
@@ -368,6 +509,8 @@ public:
         m_num_kernel_entries = 0;
         m_num_dropped        = 0;
         m_max_keylen         = 0;
+        m_num_keycache_hits  = 0;
+        m_num_keycache_misses = 0;
     }
 
     void process_snapshot(Caliper* c, const EntryList* snapshot) {
@@ -388,7 +531,28 @@ public:
 
         size_t      n_key_attr = s_key_attribute_names.size();
             
-        if (n_key_attr > 0) {
+        // Repeated contexts map to the same key node: look it up in the
+        // key cache first. Cached key node ids remain valid across
+        // flushes; node ids are never reused.
+
+        uint64_t    tag        = 0;
+        bool        cached     = false;
+
+        if (n_key_attr > 0 && sizes.n_nodes <= KEYCACHE_MAX_NODES) {
+            tag    = hash_nodes(sizes.n_nodes, addr.node_entries);
+            cached = keycache_lookup(sizes.n_nodes, addr.node_entries, tag, &key_node);
+
+            if (cached) {
+                ++m_num_keycache_hits;
+
+                if (key_node != CALI_INV_ID)
+                    ++n_nodes;
+            } else {
+                ++m_num_keycache_misses;
+            }
+        }
+
+        if (n_key_attr > 0 && !cached) {
             // --- find out number of entries for each key attribute
             
             size_t* key_entries = static_cast<size_t*>(alloca(n_key_attr * sizeof(size_t)));
@@ -430,7 +594,10 @@ public:
                 if (node)
                     nodeid_vec[n_nodes++] = node->id();
             }
-        } else {
+
+            if (tag && !c->is_signal())
+                keycache_insert(sizes.n_nodes, addr.node_entries, tag, key_node);
+        } else if (n_key_attr == 0) {
             // --- no key attributes set: take nodes in snapshot   
 
             nodeid_vec = static_cast<cali_id_t*>(alloca((sizes.n_nodes+1) * sizeof(cali_id_t)));
@@ -450,10 +617,62 @@ public:
         unsigned char   key[MAX_KEYLEN];
         size_t          pos = 0;
 
-        pos += vlenc_u64(n_nodes, key + pos);
+        // Node ids that don't fit are cut off, so encode them first and
+        // write the number of ids actually encoded into the header. 
+        // Leave room for the node and immediate count headers (up to 10
+        // bytes each), and for one id (up to 10 bytes) per step.
+
+        unsigned char   node_key[MAX_KEYLEN];
+        size_t          node_pos = 0;
+        uint64_t        n_enc    = 0;
+
+        for ( ; n_enc < n_nodes && node_pos + 30 <= MAX_KEYLEN; ++n_enc)
+            node_pos += vlenc_u64(nodeid_vec[n_enc], node_key + node_pos);
 
-        for (size_t i = 0; i < n_nodes && pos+10 < MAX_KEYLEN; ++i)
-            pos += vlenc_u64(nodeid_vec[i], key + pos);
+        pos += vlenc_u64(n_enc, key + pos);
+        memcpy(key + pos, node_key, node_pos);
+        pos += node_pos;
+
+        // --- append immediate key entries, in key attribute order
+
+        unsigned char   imm_key[MAX_KEYLEN];
+        size_t          imm_pos = 0;
+        uint64_t        n_imm   = 0;
+
+        for (size_t a = 0; a < n_key_attr; ++a) {
+            if (s_key_attribute_ids[a] == CALI_INV_ID)
+                continue;
+
+            for (size_t i = 0; i < sizes.n_immediate; ++i) {
+                if (addr.immediate_attr[i] != s_key_attribute_ids[a])
+                    continue;
+
+                const Variant& v = addr.immediate_data[i];
+
+                // string and blob values are only pointers; they may not
+                // outlive the snapshot
+                if (v.type() == CALI_TYPE_STRING || v.type() == CALI_TYPE_USR)
+                    continue;
+
+                unsigned char buf[32];
+                size_t        p = 0;
+
+                p += vlenc_u64(addr.immediate_attr[i], buf + p);
+                p += v.pack(buf + p);
+
+                // discard entries that don't fit into the key
+                if (pos + 10 + imm_pos + p >= MAX_KEYLEN)
+                    break;
+
+                memcpy(imm_key + imm_pos, buf, p);
+                imm_pos += p;
+                ++n_imm;
+            }
+        }
+
+        pos += vlenc_u64(n_imm, key + pos);
+        memcpy(key + pos, imm_key, imm_pos);
+        pos += imm_pos;
 
         m_max_keylen = std::max(pos, m_max_keylen);
 
@@ -474,21 +693,23 @@ public:
 
         ++entry->count;
 
-        for (size_t a = 0; a < m_aggr_attributes.size(); ++a)
-            for (size_t i = 0; i < sizes.n_immediate; ++i)
-                if (addr.immediate_attr[i] == m_aggr_attributes[a].id()) {
-                    AggregateKernel* k = m_kernels.get(entry->k_id + a, !c->is_signal());
+        AggregateValue* values = m_kernels.get(entry->k_id, false);
 
-                    if (k)
-                        k->add(addr.immediate_data[i].to_double());
-                }
+        if (!values)
+            return;
+
+        for (size_t a = 0; a < s_aggr_attribute_ids.size(); ++a)
+            for (size_t i = 0; i < sizes.n_immediate; ++i)
+                if (s_aggr_attribute_ids[a] != CALI_INV_ID &&
+                    addr.immediate_attr[i] == s_aggr_attribute_ids[a])
+                    add_value(a, values + s_aggr_attribute_offsets[a], addr.immediate_data[i]);
     }
 
-    size_t flush(Caliper* c, std::unordered_set<cali_id_t>& written_node_cache) {
+    size_t flush(Caliper* c) {
         TrieNode*     entry = m_trie.get(0, false);
         unsigned char key   = 0;
 
-        return recursive_flush(0, &key, entry, c, written_node_cache);
+        return recursive_flush(0, &key, entry, c);
     }
 
     bool stopped() const {
@@ -500,32 +721,25 @@ public:
           m_retired(false),
           m_next(nullptr),
           m_prev(nullptr),
+          m_keycache(nullptr),
+          m_keycache_gen(0),
+          m_keycache_valid(true),
           m_num_trie_entries(0),
           m_num_kernel_entries(0),
           m_num_dropped(0),
-          m_max_keylen(0)
+          m_max_keylen(0),
+          m_num_keycache_hits(0),
+          m_num_keycache_misses(0)
     {
-        m_aggr_attributes.assign(s_aggr_attribute_names.size(), Attribute::invalid);
-
         Log(2).stream() << "aggregate: creating aggregation database" << std::endl;
 
-        for (int a = 0; a < s_aggr_attribute_names.size(); ++a) {
-            Attribute attr = c->get_attribute(s_aggr_attribute_names[a]);
-
-            if (attr == Attribute::invalid)
-                Log(1).stream() << "aggregate: warning: aggregation attribute "
-                                << s_aggr_attribute_names[a]
-                                << " not found" << std::endl;
-            else
-                m_aggr_attributes[a] = attr;
-        }
-
         // initialize first block
         m_trie.get(0, true);
         m_kernels.get(0, true);
     }
 
     ~AggregateDB() {
+        delete[] m_keycache;
     }
 
     static AggregateDB* acquire(Caliper* c, bool alloc) {
@@ -570,11 +784,14 @@ public:
         }
 
         size_t num_written = 0;
-        std::unordered_set<cali_id_t> written_node_cache;
 
         while (db) {
             db->m_stopped.store(true);
-            num_written += db->flush(c, written_node_cache);
+
+            // Nodes may have been created since the flush started
+            c->write_new_nodes();
+
+            num_written += db->flush(c);
 
             s_global_num_trie_entries   += db->m_num_trie_entries;
             s_global_num_kernel_entries += db->m_num_kernel_entries;
@@ -582,6 +799,8 @@ public:
             s_global_num_kernel_blocks  += db->m_kernels.num_blocks();
             s_global_num_dropped        += db->m_num_dropped;
             s_global_max_keylen = std::max(s_global_max_keylen, db->m_max_keylen);
+            s_global_num_keycache_hits   += db->m_num_keycache_hits;
+            s_global_num_keycache_misses += db->m_num_keycache_misses;
             
             db->clear();
             
@@ -619,6 +838,25 @@ public:
             ++s_global_num_dropped;
     }
 
+    static void set_key_attribute(size_t i, const Attribute& attr) {
+        // Immediate string and blob values are only pointers into the
+        // snapshot, so we can't put them into the key
+        if (attr.store_as_value() &&
+            (attr.type() == CALI_TYPE_STRING || attr.type() == CALI_TYPE_USR)) {
+            Log(0).stream() << "aggregate: warning: key attribute " << attr.name()
+                            << " is an immediate string or blob attribute,"
+                            << " can't aggregate by it" << std::endl;
+            return;
+        }
+
+        // No lock: hope that update is more-or-less atomic, and
+        // consequences of invalid values are negligible
+        s_key_attributes[i]    = attr;
+        s_key_attribute_ids[i] = attr.id();
+
+        ++s_key_generation;
+    }
+
     static void post_init_cb(Caliper* c) {
         // Initialize master-thread aggregation DB
         acquire(c, true);
@@ -627,10 +865,16 @@ public:
         for (unsigned i = 0; i < s_key_attribute_names.size(); ++i) {
             Attribute attr = c->get_attribute(s_key_attribute_names[i]);
 
-            if (attr != Attribute::invalid) {
-                s_key_attributes[i]    = attr;
-                s_key_attribute_ids[i] = attr.id();
-            }
+            if (attr != Attribute::invalid)
+                set_key_attribute(i, attr);
+        }
+
+        // Update aggregation attributes
+        for (unsigned i = 0; i < s_aggr_attribute_names.size(); ++i) {
+            Attribute attr = c->get_attribute(s_aggr_attribute_names[i]);
+
+            if (attr != Attribute::invalid)
+                set_aggregation_attribute(c, i, attr);
         }
     }
 
@@ -639,60 +883,157 @@ public:
         auto it = std::find(s_key_attribute_names.begin(), s_key_attribute_names.end(),
                             attr.name());
 
-        // No lock: hope that update is more-or-less atomic, and
-        // consequences of invalid values are negligible
-        if (it != s_key_attribute_names.end()) {
-            s_key_attributes[it-s_key_attribute_names.begin()]    = attr;
-            s_key_attribute_ids[it-s_key_attribute_names.begin()] = attr.id();
-        }
+        if (it != s_key_attribute_names.end())
+            set_key_attribute(it-s_key_attribute_names.begin(), attr);
+
+        // Update aggregation attributes (e.g., accumulators created
+        // after initialization)
+        it = std::find(s_aggr_attribute_names.begin(), s_aggr_attribute_names.end(),
+                       attr.name());
+
+        if (it != s_aggr_attribute_names.end())
+            set_aggregation_attribute(c, it-s_aggr_attribute_names.begin(), attr);
     }
     
     static void finish_cb(Caliper* c) {
         Log(2).stream() << "aggregate: max key len " << s_global_max_keylen << ", "
-                        << s_global_num_kernel_entries << " entries, "
+                        << s_global_num_kernel_entries << " accumulators, "
                         << s_global_num_trie_entries << " nodes, "
                         << s_global_num_trie_blocks + s_global_num_kernel_blocks << " blocks ("
                         << s_global_num_trie_blocks * sizeof(TrieNode) * 1024
-            + s_global_num_kernel_blocks * sizeof(AggregateKernel) * 1024
+            + s_global_num_kernel_blocks * sizeof(AggregateValue) * 1024
                         << " bytes reserved)"
                         << std::endl;
 
+        if (s_key_attribute_names.size() > 0)
+            Log(2).stream() << "aggregate: key cache " << s_global_num_keycache_hits << " hits, "
+                            << s_global_num_keycache_misses << " misses" << std::endl;
+
         if (s_global_num_dropped > 0)
             Log(1).stream() << "aggregate: dropped " << s_global_num_dropped
                             << " snapshots." << std::endl;
     }
 
-    static void create_statistics_attributes(Caliper* c) {
-        s_stats_attributes.resize(s_aggr_attribute_names.size());
-
-        for (size_t i = 0; i < s_aggr_attribute_names.size(); ++i) {
-            s_stats_attributes[i].min_attr =
-                c->create_attribute(std::string("aggregate.min#") + s_aggr_attribute_names[i],
-                                    CALI_TYPE_DOUBLE, CALI_ATTR_ASVALUE | CALI_ATTR_SCOPE_THREAD);
-            s_stats_attributes[i].max_attr =
-                c->create_attribute(std::string("aggregate.max#") + s_aggr_attribute_names[i],
-                                    CALI_TYPE_DOUBLE, CALI_ATTR_ASVALUE | CALI_ATTR_SCOPE_THREAD);
-            s_stats_attributes[i].sum_attr =
-                c->create_attribute(std::string("aggregate.sum#") + s_aggr_attribute_names[i],
-                                    CALI_TYPE_DOUBLE, CALI_ATTR_ASVALUE | CALI_ATTR_SCOPE_THREAD);
-        }
+    // Create the result attributes for aggregation attribute \a a once its
+    // type is known, then enable its aggregation
+    static void set_aggregation_attribute(Caliper* c, size_t a, const Attribute& attr) {
+        if (s_aggr_attribute_ids[a] != CALI_INV_ID)
+            return;
+
+        cali_attr_type type = attr.type();
+
+        if (type == CALI_TYPE_ADDR)
+            type = CALI_TYPE_UINT;
+        if (type != CALI_TYPE_INT && type != CALI_TYPE_UINT)
+            type = CALI_TYPE_DOUBLE;
+
+        s_aggr_attribute_types[a] = type;
+
+        int                   ops   = s_aggr_attribute_ops[a];
+        StatisticsAttributes& stats = s_stats_attributes[a];
+        const std::string&    name  = s_aggr_attribute_names[a];
+
+        if (ops & AGGR_MIN)
+            stats.min_attr =
+                c->create_attribute(std::string("aggregate.min#") + name,
+                                    type, CALI_ATTR_ASVALUE | CALI_ATTR_SCOPE_THREAD);
+        if (ops & AGGR_MAX)
+            stats.max_attr =
+                c->create_attribute(std::string("aggregate.max#") + name,
+                                    type, CALI_ATTR_ASVALUE | CALI_ATTR_SCOPE_THREAD);
+        if (ops & AGGR_SUM)
+            stats.sum_attr =
+                c->create_attribute(std::string("aggregate.sum#") + name,
+                                    type, CALI_ATTR_ASVALUE | CALI_ATTR_SCOPE_THREAD);
+
+        s_aggr_attribute_ids[a] = attr.id();
+    }
 
+    static void create_statistics_attributes(Caliper* c) {
         s_count_attribute =
             c->create_attribute("aggregate.count",
                                 CALI_TYPE_INT, CALI_ATTR_ASVALUE | CALI_ATTR_SCOPE_THREAD);
     }
 
+    // Parse an operator list ("min,max,sum"). Returns 0 if \a str
+    // is not a valid operator list.
+    static int parse_ops(const std::string& str) {
+        const struct { const char* name; int op; } op_names[] = {
+            { "min", AGGR_MIN }, { "max", AGGR_MAX }, { "sum", AGGR_SUM }
+        };
+
+        vector<string> list;
+        util::split(str, ',', std::back_inserter(list));
+
+        int ops = 0;
+
+        for (const string& s : list) {
+            auto it = std::find_if(std::begin(op_names), std::end(op_names),
+                                   [&s](decltype(op_names[0])& o){ return s == o.name; });
+
+            if (it == std::end(op_names))
+                return 0;
+
+            ops |= it->op;
+        }
+
+        return ops;
+    }
+
+    // Parse the aggregation attribute list. Entries are separated by
+    // ';', and may select operators with "attribute:op,op,...". Entries
+    // without operators may be colon-separated attribute lists; those
+    // use all operators.
+    static void parse_aggregation_attributes(const std::string& cfg) {
+        vector<string> entries;
+        util::split(cfg, ';', std::back_inserter(entries));
+
+        auto add = [](const std::string& name, int ops) {
+            if (name.empty())
+                return;
+            if (s_kernel_size + 4 > 1024) {
+                Log(0).stream() << "aggregate: too many aggregation attributes, skipping "
+                                << name << std::endl;
+                return;
+            }
+
+            s_aggr_attribute_names.push_back(name);
+            s_aggr_attribute_ops.push_back(ops);
+            s_aggr_attribute_offsets.push_back(s_kernel_size);
+
+            s_kernel_size += 1 + ((ops & AGGR_MIN) ? 1 : 0) + ((ops & AGGR_MAX) ? 1 : 0)
+                + ((ops & AGGR_SUM) ? 1 : 0);
+        };
+
+        for (const string& entry : entries) {
+            string::size_type p   = entry.rfind(':');
+            int               ops = (p == string::npos ? 0 : parse_ops(entry.substr(p+1)));
+
+            if (ops) {
+                add(entry.substr(0, p), ops);
+            } else {
+                vector<string> names;
+                util::split(entry, ':', std::back_inserter(names));
+
+                for (const string& name : names)
+                    add(name, AGGR_MIN | AGGR_MAX | AGGR_SUM);
+            }
+        }
+    }
+
     static bool init_static_data() {
         s_list_lock.unlock();
 
         s_config = RuntimeConfig::init("aggregate", s_configdata);
 
-        util::split(s_config.get("attributes").to_string(), ':',
-                    std::back_inserter(s_aggr_attribute_names));
+        parse_aggregation_attributes(s_config.get("attributes").to_string());
         util::split(s_config.get("key").to_string(), ':',
                     std::back_inserter(s_key_attribute_names));
 
         s_key_attribute_ids.assign(s_key_attribute_names.size(), CALI_INV_ID);
+        s_aggr_attribute_ids.assign(s_aggr_attribute_names.size(), CALI_INV_ID);
+        s_aggr_attribute_types.assign(s_aggr_attribute_names.size(), CALI_TYPE_DOUBLE);
+        s_stats_attributes.assign(s_aggr_attribute_names.size(), StatisticsAttributes());
         s_key_attributes.assign(s_key_attribute_names.size(), Attribute::invalid);
         
         if (pthread_key_create(&s_aggregate_db_key, retire) != 0) {
@@ -728,7 +1069,9 @@ public:
 const ConfigSet::Entry AggregateDB::s_configdata[] = {
     { "attributes",   CALI_TYPE_STRING, "time.inclusive.duration",
       "List of attributes to be aggregated",
-      "List of attributes to be aggregated" },
+      "List of attributes to be aggregated, separated by ':' or ';'.\n"
+      "Select the operators for an attribute with attribute:op,op,...\n"
+      "in a ';'-separated list. Operators: min, max, sum. Default: all." },
     { "key",   CALI_TYPE_STRING, "",
       "List of attributes in the aggregation key",
       "List of attributes in the aggregation key."
@@ -744,6 +1087,11 @@ vector<string> AggregateDB::s_key_attribute_names;
 vector<Attribute> AggregateDB::s_key_attributes;
 vector<string> AggregateDB::s_aggr_attribute_names;
 vector<cali_id_t> AggregateDB::s_key_attribute_ids;
+vector<cali_id_t> AggregateDB::s_aggr_attribute_ids;
+vector<int>    AggregateDB::s_aggr_attribute_ops;
+vector<cali_attr_type> AggregateDB::s_aggr_attribute_types;
+vector<size_t> AggregateDB::s_aggr_attribute_offsets;
+size_t         AggregateDB::s_kernel_size = 0;
 vector<AggregateDB::StatisticsAttributes> AggregateDB::s_stats_attributes;
 
 pthread_key_t  AggregateDB::s_aggregate_db_key;
@@ -751,12 +1099,16 @@ pthread_key_t  AggregateDB::s_aggregate_db_key;
 AggregateDB*   AggregateDB::s_list = nullptr;
 util::spinlock AggregateDB::s_list_lock;
 
+std::atomic<unsigned> AggregateDB::s_key_generation { 0 };
+
 size_t         AggregateDB::s_global_num_trie_entries   = 0;
 size_t         AggregateDB::s_global_num_kernel_entries = 0;
 size_t         AggregateDB::s_global_num_trie_blocks    = 0;
 size_t         AggregateDB::s_global_num_kernel_blocks  = 0;
 size_t         AggregateDB::s_global_num_dropped        = 0;
 size_t         AggregateDB::s_global_max_keylen         = 0;
+size_t         AggregateDB::s_global_num_keycache_hits  = 0;
+size_t         AggregateDB::s_global_num_keycache_misses = 0;
 
 namespace cali
 {
@@ -86,6 +86,9 @@ static const ConfigSet::Entry s_configdata[] = {
 
 void snapshot_cb(Caliper* c, int scope, const EntryList*, EntryList*)
 {
+    if (!(scope & CALI_SCOPE_THREAD))
+        return;
+
     Variant v_addr[MAX_PATH];
     Variant v_name[MAX_PATH];
 
@@ -0,0 +1,206 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+/// \file  CpuInfo.cpp
+/// \brief Caliper thread placement service: CPU, NUMA node, and migrations
+
+#include "../CaliperService.h"
+
+#include <Caliper.h>
+#include <EntryList.h>
+
+#include <Log.h>
+#include <RuntimeConfig.h>
+
+#include <util/split.hpp>
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace cali;
+using namespace std;
+
+namespace
+{
+
+Attribute   cpu_attr             { Attribute::invalid };
+Attribute   numa_node_attr       { Attribute::invalid };
+Attribute   cpu_migrations_attr  { Attribute::invalid };
+Attribute   numa_migrations_attr { Attribute::invalid };
+
+/// NUMA node of each CPU, -1 if unknown
+std::vector<int> cpu_to_node;
+
+/// Last CPU seen in a snapshot on each thread, plus one (0: none yet).
+/// Stored directly in the key value so the snapshot callback doesn't allocate.
+pthread_key_t    last_cpu_key;
+
+/// Parse a sysfs CPU list (e.g., "0-3,8-11") and assign \a node to the CPUs in it
+void parse_cpulist(const std::string& cpulist, int node)
+{
+    vector<string> ranges;
+    util::split(cpulist, ',', back_inserter(ranges));
+
+    for (const string& range : ranges) {
+        if (range.empty())
+            continue;
+
+        size_t pos   = range.find('-');
+        int    first = atoi(range.c_str());
+        int    last  = (pos == string::npos ? first : atoi(range.c_str() + pos + 1));
+
+        if (first < 0 || last < first)
+            continue;
+
+        if (cpu_to_node.size() <= static_cast<size_t>(last))
+            cpu_to_node.resize(last + 1, -1);
+
+        for (int cpu = first; cpu <= last; ++cpu)
+            cpu_to_node[cpu] = node;
+    }
+}
+
+/// Read the CPU-to-NUMA node mapping from sysfs
+void read_numa_topology()
+{
+    const char* nodedir = "/sys/devices/system/node";
+
+    DIR* dir = opendir(nodedir);
+
+    if (!dir) {
+        Log(1).stream() << "cpuinfo: cannot open " << nodedir 
+                        << ", NUMA nodes are not available" << endl;
+        return;
+    }
+
+    int num_nodes = 0;
+
+    for (struct dirent* d = readdir(dir); d; d = readdir(dir)) {
+        if (strncmp(d->d_name, "node", 4) != 0 || !isdigit(d->d_name[4]))
+            continue;
+
+        int      node = atoi(d->d_name + 4);
+        ifstream is(string(nodedir) + "/" + d->d_name + "/cpulist");
+        string   cpulist;
+
+        if (is && getline(is, cpulist)) {
+            parse_cpulist(cpulist, node);
+            ++num_nodes;
+        }
+    }
+
+    closedir(dir);
+
+    Log(2).stream() << "cpuinfo: found " << num_nodes << " NUMA nodes with "
+                    << cpu_to_node.size() << " CPUs" << endl;
+}
+
+void snapshot_cb(Caliper*, int scope, const EntryList*, EntryList* sbuf)
+{
+    if (!(scope & CALI_SCOPE_THREAD))
+        return;
+
+    int cpu = sched_getcpu();
+
+    if (cpu < 0)
+        return;
+
+    int node = (static_cast<size_t>(cpu) < cpu_to_node.size() ? cpu_to_node[cpu] : -1);
+
+    sbuf->append(cpu_attr.id(), Variant(cpu));
+
+    if (node >= 0)
+        sbuf->append(numa_node_attr.id(), Variant(node));
+
+    // Count a migration if this thread ran on a different CPU at its 
+    // previous snapshot
+
+    intptr_t last = reinterpret_cast<intptr_t>(pthread_getspecific(last_cpu_key)) - 1;
+
+    if (last >= 0 && last != cpu) {
+        uint64_t one  = 1;
+
+        sbuf->append(cpu_migrations_attr.id(), Variant(CALI_TYPE_UINT, &one, sizeof(uint64_t)));
+
+        int last_node = (static_cast<size_t>(last) < cpu_to_node.size() ? cpu_to_node[last] : -1);
+
+        if (last_node != node)
+            sbuf->append(numa_migrations_attr.id(), Variant(CALI_TYPE_UINT, &one, sizeof(uint64_t)));
+    }
+
+    if (last != cpu)
+        pthread_setspecific(last_cpu_key, reinterpret_cast<void*>(static_cast<intptr_t>(cpu) + 1));
+}
+
+void cpuinfo_register(Caliper* c)
+{
+    if (pthread_key_create(&last_cpu_key, nullptr) != 0) {
+        Log(0).stream() << "cpuinfo: pthread_key_create() failed, disabling cpuinfo service" << endl;
+        return;
+    }
+
+    read_numa_topology();
+
+    int prop = CALI_ATTR_ASVALUE | CALI_ATTR_SCOPE_THREAD | CALI_ATTR_SKIP_EVENTS;
+
+    cpu_attr             = 
+        c->create_attribute("cpu",             CALI_TYPE_INT,  prop);
+    numa_node_attr       = 
+        c->create_attribute("numa.node",       CALI_TYPE_INT,  prop);
+    cpu_migrations_attr  = 
+        c->create_attribute("cpu.migrations",  CALI_TYPE_UINT, prop);
+    numa_migrations_attr = 
+        c->create_attribute("numa.migrations", CALI_TYPE_UINT, prop);
+
+    c->events().snapshot.connect(&snapshot_cb);
+
+    Log(1).stream() << "Registered cpuinfo service" << endl;
+}
+
+} // anonymous namespace 
+
+
+namespace cali 
+{
+    CaliperService cpuinfo_service = { "cpuinfo", ::cpuinfo_register };
+} // namespace cali
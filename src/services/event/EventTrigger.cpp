@@ -67,6 +67,14 @@ const ConfigSet::Entry   configdata[] = {
       "Enable snapshot info records",
       "Enable snapshot info records."
     },
+    { "trigger_mode", CALI_TYPE_STRING, "all",
+      "Which events trigger snapshots (all|begin_end|end_only)",
+      "Which events trigger snapshots.\n"
+      "Colon-separated list of a default mode and/or attribute=mode entries.\n"
+      "  all:       begin, set, and end events\n"
+      "  begin_end: begin and end events\n"
+      "  end_only:  end and set events"
+    },
 
     ConfigSet::Terminator
 };
@@ -75,11 +83,30 @@ ConfigSet                config;
 
 bool                     enable_snapshot_info;
 
+enum TriggerEvents {
+    TRIGGER_BEGIN = 1,
+    TRIGGER_SET   = 2,
+    TRIGGER_END   = 4
+};
+
+const struct TriggerModeInfo {
+    const char* name;
+    int         events;
+} trigger_mode_list[] = {
+    { "all",       TRIGGER_BEGIN | TRIGGER_SET | TRIGGER_END },
+    { "begin_end", TRIGGER_BEGIN | TRIGGER_END               },
+    { "end_only",  TRIGGER_SET   | TRIGGER_END               }
+};
+
+int                      default_trigger_mode = TRIGGER_BEGIN | TRIGGER_SET | TRIGGER_END;
+std::map<std::string, int> trigger_modes;
+
 struct EventAttributes {
     Attribute begin_attr;
     Attribute set_attr;
     Attribute end_attr;
     Attribute lvl_attr;
+    int       trigger_mode;
 };
 
 typedef std::map<cali_id_t, EventAttributes> AttributeMap;
@@ -144,6 +171,11 @@ void create_attribute_cb(Caliper* c, const Attribute& attr)
                             CALI_ATTR_SKIP_EVENTS | 
                             (attr.properties() & CALI_ATTR_SCOPE_MASK));
 
+    auto it = trigger_modes.find(attr.name());
+
+    event_attributes.trigger_mode =
+        (it == trigger_modes.end() ? default_trigger_mode : it->second);
+
     std::lock_guard<std::mutex>
         g(event_attributes_lock);
         
@@ -165,6 +197,21 @@ bool get_event_attributes(const Attribute& attr, EventAttributes& evt_attr)
     return false;
 }
 
+// Push a snapshot for the event, or, if the attribute's trigger mode
+// excludes it, only run the snapshot callbacks with the trigger info
+// (e.g., so the timestamp service can record a phase start time)
+void trigger_event(Caliper* c, bool push, const EntryList* trigger_info)
+{
+    if (push) {
+        c->push_snapshot(CALI_SCOPE_THREAD | CALI_SCOPE_PROCESS, trigger_info);
+    } else if (trigger_info) {
+        EntryList::FixedEntryList<8> mark_data;
+        EntryList mark(mark_data);
+
+        c->pull_snapshot(0, trigger_info, &mark);
+    }
+}
+
 void event_begin_cb(Caliper* c, const Attribute& attr, const Variant& value)
 {
     EventAttributes event_attr;
@@ -200,9 +247,9 @@ void event_begin_cb(Caliper* c, const Attribute& attr, const Variant& value)
         EntryList trigger_info(trigger_info_data);
 
         c->make_entrylist(3, attrs, vals, trigger_info);
-        c->push_snapshot(CALI_SCOPE_THREAD | CALI_SCOPE_PROCESS, &trigger_info);
+        trigger_event(c, event_attr.trigger_mode & TRIGGER_BEGIN, &trigger_info);
     } else {
-        c->push_snapshot(CALI_SCOPE_THREAD | CALI_SCOPE_PROCESS, nullptr);
+        trigger_event(c, event_attr.trigger_mode & TRIGGER_BEGIN, nullptr);
     }
 }
 
@@ -230,9 +277,9 @@ void event_set_cb(Caliper* c, const Attribute& attr, const Variant& value)
         EntryList trigger_info(trigger_info_data);
 
         c->make_entrylist(3, attrs, vals, trigger_info);
-        c->push_snapshot(CALI_SCOPE_THREAD | CALI_SCOPE_PROCESS, &trigger_info);
+        trigger_event(c, event_attr.trigger_mode & TRIGGER_SET, &trigger_info);
     } else {
-        c->push_snapshot(CALI_SCOPE_THREAD | CALI_SCOPE_PROCESS, nullptr);
+        trigger_event(c, event_attr.trigger_mode & TRIGGER_SET, nullptr);
     }
 }
 
@@ -286,6 +333,32 @@ void event_trigger_register(Caliper* c)
     util::split(config.get("trigger").to_string(), ':', 
                 std::back_inserter(trigger_attr_names));
 
+    std::vector<std::string> mode_list;
+
+    util::split(config.get("trigger_mode").to_string(), ':',
+                std::back_inserter(mode_list));
+
+    for (const std::string& entry : mode_list) {
+        if (entry.empty())
+            continue;
+
+        std::string::size_type p = entry.rfind('=');
+        std::string mode = (p == std::string::npos ? entry : entry.substr(p+1));
+
+        auto it = std::find_if(std::begin(trigger_mode_list), std::end(trigger_mode_list),
+                               [&mode](const TriggerModeInfo& m){ return mode == m.name; });
+
+        if (it == std::end(trigger_mode_list)) {
+            Log(0).stream() << "event: unknown trigger mode \"" << mode << "\"" << endl;
+            continue;
+        }
+
+        if (p == std::string::npos)
+            default_trigger_mode = it->events;
+        else
+            trigger_modes[entry.substr(0, p)] = it->events;
+    }
+
     enable_snapshot_info = config.get("enable_snapshot_info").to_bool();
 
     // register trigger events
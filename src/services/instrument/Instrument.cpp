@@ -0,0 +1,397 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+/// \file  Instrument.cpp
+/// \brief Service for compiler-instrumented functions (-finstrument-functions)
+
+#include "../CaliperService.h"
+
+#include "SymbolTable.h"
+
+#include <Caliper.h>
+
+#include <Log.h>
+#include <RuntimeConfig.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <dlfcn.h>
+#include <fnmatch.h>
+#include <pthread.h>
+
+using namespace cali;
+using namespace std;
+
+#define ADDR_CACHE_SIZE 512 // per-thread address cache slots (power of 2)
+
+namespace
+{
+
+const ConfigSet::Entry s_configdata[] = {
+    { "include", CALI_TYPE_STRING, "",
+      "Functions to instrument",
+      "Colon-separated list of function name patterns (with shell wildcards) to instrument.\n"
+      "If empty, all functions are instrumented."
+    },
+    { "exclude", CALI_TYPE_STRING, "",
+      "Functions not to instrument",
+      "Colon-separated list of function name patterns (with shell wildcards) not to instrument."
+    },
+    { "max_depth", CALI_TYPE_UINT, "0",
+      "Maximum nesting depth of instrumented functions",
+      "Maximum nesting depth of instrumented function regions. 0: no limit."
+    },
+    ConfigSet::Terminator
+};
+
+enum State {
+    Uninitialized, Initializing, Active, Inactive
+};
+
+std::atomic<int>       s_state { Uninitialized };
+
+ConfigSet              s_config;
+
+Attribute              s_function_attr { Attribute::invalid };
+
+SymbolTable*           s_symbols = nullptr;
+
+vector<string>         s_include;
+vector<string>         s_exclude;
+unsigned               s_max_depth = 0;
+
+// functions outside of the symbol table (e.g., in objects loaded later)
+std::map<uintptr_t, SymbolTable::Function*>
+                       s_unknown_functions;
+std::mutex             s_unknown_functions_lock;
+
+pthread_key_t          s_thread_data_key;
+
+std::atomic<size_t>    s_num_regions { 0 };
+
+struct ThreadData {
+    struct CacheEntry {
+        uintptr_t              addr;
+        SymbolTable::Function* fn;
+    }        cache[ADDR_CACHE_SIZE];
+
+    unsigned depth;   // number of open function regions
+    unsigned skipped; // number of open functions beyond the depth limit
+    bool     in_hook;
+
+    ThreadData()
+        : depth(0), skipped(0), in_hook(false)
+        {
+            for (CacheEntry& e : cache)
+                e = { 0, nullptr };
+        }
+};
+
+// Split a colon-separated list, keeping C++ "::" scope separators
+vector<string> split_patterns(const string& str)
+{
+    vector<string> ret;
+    string         s;
+
+    for (string::size_type i = 0; i < str.size(); ++i) {
+        if (str[i] == ':') {
+            if (i+1 < str.size() && str[i+1] == ':') {
+                s.append("::");
+                ++i;
+                continue;
+            }
+            if (!s.empty())
+                ret.push_back(s);
+            s.clear();
+        } else
+            s.push_back(str[i]);
+    }
+
+    if (!s.empty())
+        ret.push_back(s);
+
+    return ret;
+}
+
+bool match_any(const vector<string>& patterns, const string& name)
+{
+    for (const string& p : patterns)
+        if (fnmatch(p.c_str(), name.c_str(), 0) == 0)
+            return true;
+
+    return false;
+}
+
+bool is_filtered(const string& name)
+{
+    return (!s_include.empty() && !match_any(s_include, name)) || match_any(s_exclude, name);
+}
+
+SymbolTable::Function* find_unknown_function(uintptr_t addr)
+{
+    std::lock_guard<std::mutex>
+        g(s_unknown_functions_lock);
+
+    auto it = s_unknown_functions.find(addr);
+
+    if (it != s_unknown_functions.end())
+        return it->second;
+
+    Dl_info info;
+    string  name;
+
+    if (dladdr(reinterpret_cast<void*>(addr), &info) && info.dli_sname) {
+        name = info.dli_sname;
+    } else {
+        char buf[24];
+        snprintf(buf, sizeof(buf), "0x%lx", static_cast<unsigned long>(addr));
+        name = buf;
+    }
+
+    SymbolTable::Function* f = new SymbolTable::Function(addr, addr+1, name);
+    f->skip = is_filtered(name);
+
+    s_unknown_functions.insert(std::make_pair(addr, f));
+
+    return f;
+}
+
+SymbolTable::Function* lookup(ThreadData* td, uintptr_t addr)
+{
+    ThreadData::CacheEntry& e = td->cache[(addr >> 4) & (ADDR_CACHE_SIZE-1)];
+
+    if (e.addr == addr)
+        return e.fn;
+
+    SymbolTable::Function* f = s_symbols->find(addr);
+
+    if (!f)
+        f = find_unknown_function(addr);
+
+    e.addr = addr;
+    e.fn   = f;
+
+    return f;
+}
+
+void release_thread_data(void* ptr)
+{
+    delete static_cast<ThreadData*>(ptr);
+}
+
+ThreadData* get_thread_data()
+{
+    ThreadData* td = static_cast<ThreadData*>(pthread_getspecific(s_thread_data_key));
+
+    if (!td) {
+        td = new ThreadData;
+        pthread_setspecific(s_thread_data_key, td);
+    }
+
+    return td;
+}
+
+// Initialize Caliper on the first instrumented function call. Returns
+// true if the instrument service is active.
+bool check_active()
+{
+    int state = s_state.load(std::memory_order_acquire);
+
+    if (state == Uninitialized) {
+        if (!s_state.compare_exchange_strong(state, Initializing))
+            return false;
+
+        Caliper::instance();
+
+        // the service registration sets the state to Active
+        state = Initializing;
+        s_state.compare_exchange_strong(state, Inactive);
+
+        return s_state.load() == Active;
+    }
+
+    return state == Active;
+}
+
+void finish_cb(Caliper*)
+{
+    s_state.store(Inactive);
+
+    Log(1).stream() << "instrument: " << s_num_regions.load()
+                    << " function regions." << std::endl;
+}
+
+void instrument_register(Caliper* c)
+{
+    s_config    = RuntimeConfig::init("instrument", s_configdata);
+
+    s_include   = split_patterns(s_config.get("include").to_string());
+    s_exclude   = split_patterns(s_config.get("exclude").to_string());
+    s_max_depth = s_config.get("max_depth").to_uint();
+
+    s_function_attr =
+        c->create_attribute("function", CALI_TYPE_STRING);
+
+    if (s_function_attr.type() != CALI_TYPE_STRING) {
+        Log(0).stream() << "instrument: \"function\" attribute is not a string attribute,"
+                        << " disabling instrument service" << std::endl;
+        return;
+    }
+
+    if (pthread_key_create(&s_thread_data_key, release_thread_data) != 0) {
+        Log(0).stream() << "instrument: pthread_key_create() failed,"
+                        << " disabling instrument service" << std::endl;
+        return;
+    }
+
+    // Read and filter the symbol table up front: filtered functions
+    // return after the address lookup
+
+    s_symbols = new SymbolTable;
+
+    size_t num_functions = s_symbols->read();
+    size_t num_skipped   = 0;
+
+    s_symbols->for_each([&num_skipped](SymbolTable::Function* f){
+            f->skip = is_filtered(f->name);
+
+            if (f->skip)
+                ++num_skipped;
+        });
+
+    c->events().finish_evt.connect(finish_cb);
+
+    s_state.store(Active);
+
+    Log(1).stream() << "Registered instrument service. Found "
+                    << num_functions << " functions, "
+                    << num_skipped   << " filtered." << std::endl;
+}
+
+} // namespace [anonymous]
+
+
+extern "C"
+{
+
+void __cyg_profile_func_enter(void* fn, void* site) __attribute__((no_instrument_function));
+void __cyg_profile_func_exit(void* fn, void* site)  __attribute__((no_instrument_function));
+
+void __cyg_profile_func_enter(void* fn, void*)
+{
+    if (!check_active())
+        return;
+
+    ThreadData* td = get_thread_data();
+
+    if (td->in_hook)
+        return;
+
+    SymbolTable::Function* f = lookup(td, reinterpret_cast<uintptr_t>(fn));
+
+    if (!f || f->skip)
+        return;
+
+    if (s_max_depth > 0 && td->depth >= s_max_depth) {
+        ++td->skipped;
+        return;
+    }
+
+    td->in_hook = true;
+
+    Caliper c = Caliper::instance();
+
+    if (c) {
+        const char* name = f->interned.load(std::memory_order_acquire);
+
+        if (!name) {
+            name = c.intern_string(f->name.c_str(), f->name.size());
+            f->interned.store(name, std::memory_order_release);
+        }
+
+        c.begin(s_function_attr, Variant(CALI_TYPE_STRING, name, f->name.size()), f->cache, 4);
+
+        ++td->depth;
+        ++s_num_regions;
+    }
+
+    td->in_hook = false;
+}
+
+void __cyg_profile_func_exit(void* fn, void*)
+{
+    if (s_state.load(std::memory_order_acquire) != Active)
+        return;
+
+    ThreadData* td = get_thread_data();
+
+    if (td->in_hook)
+        return;
+
+    SymbolTable::Function* f = lookup(td, reinterpret_cast<uintptr_t>(fn));
+
+    if (!f || f->skip)
+        return;
+
+    if (td->skipped > 0) {
+        --td->skipped;
+        return;
+    }
+
+    // function was entered before the service became active
+    if (td->depth == 0)
+        return;
+
+    td->in_hook = true;
+
+    Caliper c = Caliper::instance();
+
+    if (c)
+        c.end(s_function_attr);
+
+    --td->depth;
+    td->in_hook = false;
+}
+
+} // extern "C"
+
+namespace cali
+{
+    CaliperService instrument_service { "instrument", ::instrument_register };
+}
@@ -0,0 +1,211 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+/// \file  SymbolTable.cpp
+/// \brief Function symbol lookup for the instrument service
+
+#include "SymbolTable.h"
+
+#include <Log.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include <cxxabi.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <link.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace cali;
+
+namespace
+{
+
+std::string demangle(const char* name)
+{
+    int   status = 0;
+    char* str    = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+
+    if (!str || status != 0)
+        return std::string(name);
+
+    std::string ret(str);
+    free(str);
+
+    return ret;
+}
+
+/// Append the function symbols from ELF file \a path, loaded at \a base,
+/// to \a list. Uses the full symbol table if present, or the dynamic
+/// symbol table otherwise.
+void read_elf_functions(const char* path, uintptr_t base, std::vector<SymbolTable::Function*>& list)
+{
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+        return;
+
+    struct stat st;
+
+    if (fstat(fd, &st) < 0 || st.st_size < static_cast<off_t>(sizeof(ElfW(Ehdr)))) {
+        close(fd);
+        return;
+    }
+
+    size_t len = static_cast<size_t>(st.st_size);
+    void*  map = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    close(fd);
+
+    if (map == MAP_FAILED)
+        return;
+
+    const unsigned char* img  = static_cast<const unsigned char*>(map);
+    const ElfW(Ehdr)*    ehdr = reinterpret_cast<const ElfW(Ehdr)*>(img);
+
+    if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 ||
+        ehdr->e_ident[EI_CLASS] != (sizeof(void*) == 8 ? ELFCLASS64 : ELFCLASS32) ||
+        ehdr->e_shoff == 0 ||
+        ehdr->e_shoff + ehdr->e_shnum * sizeof(ElfW(Shdr)) > len) {
+        munmap(map, len);
+        return;
+    }
+
+    const ElfW(Shdr)* shdr   = reinterpret_cast<const ElfW(Shdr)*>(img + ehdr->e_shoff);
+    const ElfW(Shdr)* symtab = nullptr;
+
+    for (int i = 0; i < ehdr->e_shnum; ++i)
+        if (shdr[i].sh_type == SHT_SYMTAB)
+            symtab = shdr + i;
+    if (!symtab)
+        for (int i = 0; i < ehdr->e_shnum; ++i)
+            if (shdr[i].sh_type == SHT_DYNSYM)
+                symtab = shdr + i;
+
+    if (symtab && symtab->sh_link < ehdr->e_shnum &&
+        symtab->sh_offset + symtab->sh_size <= len) {
+        const ElfW(Shdr)* strtab = shdr + symtab->sh_link;
+        const ElfW(Sym)*  syms   = reinterpret_cast<const ElfW(Sym)*>(img + symtab->sh_offset);
+        size_t            nsyms  = symtab->sh_size / sizeof(ElfW(Sym));
+
+        if (strtab->sh_offset + strtab->sh_size <= len) {
+            const char* strs = reinterpret_cast<const char*>(img + strtab->sh_offset);
+
+            for (size_t i = 0; i < nsyms; ++i) {
+                const ElfW(Sym)& sym = syms[i];
+
+                if (ELF64_ST_TYPE(sym.st_info) != STT_FUNC || sym.st_shndx == SHN_UNDEF ||
+                    sym.st_value == 0 || sym.st_name >= strtab->sh_size)
+                    continue;
+
+                uintptr_t start = base + sym.st_value;
+
+                list.push_back(new SymbolTable::Function(start, start + std::max<size_t>(sym.st_size, 1),
+                                                         demangle(strs + sym.st_name)));
+            }
+        }
+    }
+
+    munmap(map, len);
+}
+
+struct PhdrData {
+    std::vector<SymbolTable::Function*> list;
+    int                                 count;
+};
+
+int phdr_cb(struct dl_phdr_info* info, size_t, void* ptr)
+{
+    PhdrData* data = static_cast<PhdrData*>(ptr);
+
+    // The main program comes first, and has an empty name
+    const char* path = info->dlpi_name;
+
+    if (data->count++ == 0 && (!path || path[0] == '\0'))
+        path = "/proc/self/exe";
+
+    if (path && path[0] == '/')
+        read_elf_functions(path, info->dlpi_addr, data->list);
+
+    return 0;
+}
+
+} // namespace [anonymous]
+
+SymbolTable::~SymbolTable()
+{
+    for (Function* f : m_functions)
+        delete f;
+}
+
+size_t
+SymbolTable::read()
+{
+    PhdrData data { { }, 0 };
+
+    dl_iterate_phdr(phdr_cb, &data);
+
+    std::vector<Function*>& list(data.list);
+
+    // Sort by address and remove aliases
+
+    std::stable_sort(list.begin(), list.end(), [](const Function* a, const Function* b){
+            return a->start < b->start;
+        });
+
+    for (Function* f : list)
+        if (!m_functions.empty() && m_functions.back()->start == f->start)
+            delete f;
+        else
+            m_functions.push_back(f);
+
+    return m_functions.size();
+}
+
+SymbolTable::Function*
+SymbolTable::find(uintptr_t addr) const
+{
+    auto it = std::upper_bound(m_functions.begin(), m_functions.end(), addr,
+                               [](uintptr_t a, const Function* f){ return a < f->start; });
+
+    if (it == m_functions.begin())
+        return nullptr;
+
+    Function* f = *(--it);
+
+    return (addr < f->end ? f : nullptr);
+}
@@ -0,0 +1,99 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+/// \file  SymbolTable.h
+/// \brief Function symbol lookup for the instrument service
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cali
+{
+
+class Node;
+
+/// \brief Table of the function symbols in all objects loaded into the
+///   process, read from their ELF symbol tables.
+///   The table does not change after it was read.
+
+class SymbolTable
+{
+public:
+
+    struct Function {
+        uintptr_t          start;
+        uintptr_t          end;
+        std::string        name;     ///< demangled name
+        bool               skip;     ///< filtered out
+
+        std::atomic<const char*> interned;
+        std::atomic<Node*> cache[4]; ///< begin() node cache
+
+        Function(uintptr_t s, uintptr_t e, const std::string& n)
+            : start(s), end(e), name(n), skip(false), interned(nullptr)
+            {
+                for (std::atomic<Node*>& c : cache)
+                    c.store(nullptr);
+            }
+    };
+
+private:
+
+    std::vector<Function*> m_functions; // sorted by start address
+
+public:
+
+    SymbolTable()
+        { }
+
+    ~SymbolTable();
+
+    /// \brief Read function symbols of all currently loaded objects.
+    ///   Returns the number of functions found.
+    size_t    read();
+
+    /// \brief Find the function containing address \a addr, or \c nullptr.
+    Function* find(uintptr_t addr) const;
+
+    template<typename F>
+    void      for_each(F fn) {
+        for (Function* f : m_functions)
+            fn(f);
+    }
+};
+
+} // namespace cali
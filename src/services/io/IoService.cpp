@@ -0,0 +1,232 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+/// \file  IoService.cpp
+/// \brief Caliper POSIX I/O service
+
+#include "IoService.h"
+
+#include "../CaliperService.h"
+
+#include <Caliper.h>
+#include <EntryList.h>
+
+#include <Log.h>
+#include <RuntimeConfig.h>
+
+#include <cstring>
+#include <pthread.h>
+#include <sys/types.h>
+
+using namespace cali;
+using namespace std;
+
+namespace cali
+{
+    bool io_enabled { false };
+}
+
+namespace
+{
+
+ConfigSet        config;
+
+ConfigSet::Entry configdata[] = {
+    { "trace_threshold", CALI_TYPE_UINT, "0",
+      "Push a snapshot for I/O calls longer than this (usec)",
+      "Push a snapshot for each I/O call that takes longer than this\n"
+      "number of microseconds. 0: never." 
+    },
+    ConfigSet::Terminator
+};
+
+struct IoCounters {
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+    uint64_t calls;
+    uint64_t nsec;
+};
+
+pthread_key_t    counters_key;
+
+Attribute        bytes_read_attr    { Attribute::invalid };
+Attribute        bytes_written_attr { Attribute::invalid };
+Attribute        calls_attr         { Attribute::invalid };
+Attribute        time_attr          { Attribute::invalid };
+
+Attribute        function_attr      { Attribute::invalid };
+Attribute        duration_attr      { Attribute::invalid };
+Attribute        bytes_attr         { Attribute::invalid };
+
+uint64_t         trace_threshold_nsec = 0;
+
+void release_counters(void* ptr)
+{
+    delete static_cast<IoCounters*>(ptr);
+}
+
+IoCounters* get_counters(bool alloc)
+{
+    IoCounters* ctr = static_cast<IoCounters*>(pthread_getspecific(counters_key));
+
+    if (alloc && !ctr) {
+        ctr = new IoCounters { 0, 0, 0, 0 };
+        pthread_setspecific(counters_key, ctr);
+    }
+
+    return ctr;
+}
+
+// Push a snapshot for a slow I/O call
+void trace_call(const char* fn, IoKind kind, ssize_t ret, uint64_t nsec)
+{
+    Caliper   c    = Caliper::instance();
+    uint64_t  usec = nsec / 1000;
+    int64_t   nb   = ret;
+
+    Attribute attrs[3] = { function_attr, duration_attr, bytes_attr };
+    Variant   vals[3]  = { Variant(CALI_TYPE_STRING, fn, strlen(fn)),
+                           Variant(CALI_TYPE_UINT, &usec, sizeof(uint64_t)),
+                           Variant(CALI_TYPE_INT,  &nb,   sizeof(int64_t)) };
+
+    EntryList::FixedEntryList<3> trigger_info_data;
+    EntryList trigger_info(trigger_info_data);
+
+    // only read/write calls have a byte count
+    c.make_entrylist(kind == IO_OTHER ? 2 : 3, attrs, vals, trigger_info);
+    c.push_snapshot(CALI_SCOPE_THREAD | CALI_SCOPE_PROCESS, &trigger_info);
+}
+
+// Append this thread's I/O counter deltas to the snapshot
+void snapshot_cb(Caliper* c, int scope, const EntryList*, EntryList* sbuf)
+{
+    // Leave the counters alone in signal handlers: we might have
+    // interrupted an update
+    if (!(scope & CALI_SCOPE_THREAD) || c->is_signal())
+        return;
+
+    IoCounters* ctr = get_counters(false);
+
+    if (!ctr || ctr->calls == 0)
+        return;
+
+    uint64_t usec = ctr->nsec / 1000;
+
+    if (ctr->bytes_read > 0)
+        sbuf->append(bytes_read_attr.id(),
+                     Variant(CALI_TYPE_UINT, &ctr->bytes_read,    sizeof(uint64_t)));
+    if (ctr->bytes_written > 0)
+        sbuf->append(bytes_written_attr.id(),
+                     Variant(CALI_TYPE_UINT, &ctr->bytes_written, sizeof(uint64_t)));
+
+    sbuf->append(calls_attr.id(), Variant(CALI_TYPE_UINT, &ctr->calls, sizeof(uint64_t)));
+    sbuf->append(time_attr.id(),  Variant(CALI_TYPE_UINT, &usec,       sizeof(uint64_t)));
+
+    // keep the sub-microsecond remainder for the next snapshot
+    *ctr = IoCounters { 0, 0, 0, ctr->nsec % 1000 };
+}
+
+void io_register(Caliper* c)
+{
+    config = RuntimeConfig::init("io", configdata);
+
+    if (pthread_key_create(&counters_key, release_counters) != 0) {
+        Log(0).stream() << "io: pthread_key_create() failed, disabling io service" << endl;
+        return;
+    }
+
+    trace_threshold_nsec = config.get("trace_threshold").to_uint() * 1000;
+
+    int prop = CALI_ATTR_ASVALUE | CALI_ATTR_SCOPE_THREAD | CALI_ATTR_SKIP_EVENTS;
+
+    Attribute unit_attr = c->create_attribute("time.unit", CALI_TYPE_STRING);
+    Variant   usec_val  = Variant(CALI_TYPE_STRING, "usec", 4);
+
+    bytes_read_attr    =
+        c->create_attribute("io.bytes.read",    CALI_TYPE_UINT, prop);
+    bytes_written_attr =
+        c->create_attribute("io.bytes.written", CALI_TYPE_UINT, prop);
+    calls_attr         =
+        c->create_attribute("io.calls",         CALI_TYPE_UINT, prop);
+    time_attr          =
+        c->create_attribute("io.time",          CALI_TYPE_UINT, prop,
+                            1, &unit_attr, &usec_val);
+
+    function_attr      =
+        c->create_attribute("io.function",      CALI_TYPE_STRING,
+                            CALI_ATTR_SCOPE_THREAD | CALI_ATTR_SKIP_EVENTS);
+    duration_attr      =
+        c->create_attribute("io.duration",      CALI_TYPE_UINT, prop,
+                            1, &unit_attr, &usec_val);
+    bytes_attr         =
+        c->create_attribute("io.bytes",         CALI_TYPE_INT,  prop);
+
+    c->events().snapshot.connect(&snapshot_cb);
+
+    io_enabled = true;
+
+    Log(1).stream() << "Registered io service" << endl;
+}
+
+} // anonymous namespace 
+
+
+namespace cali 
+{
+
+void io_record(const char* fn, IoKind kind, ssize_t ret, uint64_t nsec)
+{
+    // Skip I/O done inside Caliper (output services, sysfs reads at
+    // init) and on threads Caliper doesn't know yet
+    if (!Caliper::sigsafe_instance())
+        return;
+
+    IoCounters* ctr = get_counters(true);
+
+    ++ctr->calls;
+    ctr->nsec += nsec;
+
+    if (ret > 0) {
+        if (kind == IO_READ)
+            ctr->bytes_read    += ret;
+        else if (kind == IO_WRITE)
+            ctr->bytes_written += ret;
+    }
+
+    if (trace_threshold_nsec > 0 && nsec >= trace_threshold_nsec)
+        trace_call(fn, kind, ret, nsec);
+}
+
+CaliperService io_service = { "io", ::io_register };
+
+} // namespace cali
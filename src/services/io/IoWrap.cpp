@@ -0,0 +1,179 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+/// \file  IoWrap.cpp
+/// \brief POSIX I/O function wrappers for the io service
+///
+/// Link this library into the application (or LD_PRELOAD it) to 
+/// interpose read(), write(), pread(), pwrite(), open(), close(), and 
+/// fsync(). The wrappers forward to the next definition of each function.
+
+#include "IoService.h"
+
+#include <cerrno>
+#include <cstdarg>
+#include <cstdint>
+#include <ctime>
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace
+{
+
+// Prevents recording I/O done while recording I/O
+thread_local bool in_wrapper = false;
+
+inline uint64_t
+now_nsec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+template<typename Fn>
+Fn
+lookup(Fn* fnptr, const char* name)
+{
+    if (!*fnptr)
+        *fnptr = reinterpret_cast<Fn>(dlsym(RTLD_NEXT, name));
+
+    return *fnptr;
+}
+
+/// Call \a fn and record it in the io service if enabled
+template<typename Fn>
+ssize_t
+wrap_call(const char* name, cali::IoKind kind, Fn fn)
+{
+    if (!cali::io_enabled || in_wrapper)
+        return fn();
+
+    in_wrapper = true;
+
+    uint64_t begin = now_nsec();
+    ssize_t  ret   = fn();
+    uint64_t end   = now_nsec();
+
+    int saved_errno = errno;
+    cali::io_record(name, kind, ret, end - begin);
+    errno = saved_errno;
+
+    in_wrapper = false;
+
+    return ret;
+}
+
+ssize_t (*real_read)(int, void*, size_t)               = nullptr;
+ssize_t (*real_write)(int, const void*, size_t)        = nullptr;
+ssize_t (*real_pread)(int, void*, size_t, off_t)       = nullptr;
+ssize_t (*real_pwrite)(int, const void*, size_t, off_t) = nullptr;
+int     (*real_open)(const char*, int, ...)            = nullptr;
+int     (*real_close)(int)                             = nullptr;
+int     (*real_fsync)(int)                             = nullptr;
+
+} // anonymous namespace
+
+extern "C"
+{
+
+ssize_t
+read(int fd, void* buf, size_t count)
+{
+    auto fn = lookup(&real_read, "read");
+
+    return wrap_call("read", cali::IO_READ, [=]() { return fn(fd, buf, count); });
+}
+
+ssize_t
+write(int fd, const void* buf, size_t count)
+{
+    auto fn = lookup(&real_write, "write");
+
+    return wrap_call("write", cali::IO_WRITE, [=]() { return fn(fd, buf, count); });
+}
+
+ssize_t
+pread(int fd, void* buf, size_t count, off_t offset)
+{
+    auto fn = lookup(&real_pread, "pread");
+
+    return wrap_call("pread", cali::IO_READ, [=]() { return fn(fd, buf, count, offset); });
+}
+
+ssize_t
+pwrite(int fd, const void* buf, size_t count, off_t offset)
+{
+    auto fn = lookup(&real_pwrite, "pwrite");
+
+    return wrap_call("pwrite", cali::IO_WRITE, [=]() { return fn(fd, buf, count, offset); });
+}
+
+int
+open(const char* pathname, int flags, ...)
+{
+    auto   fn   = lookup(&real_open, "open");
+    mode_t mode = 0;
+
+    if (flags & O_CREAT) {
+        va_list ap;
+        va_start(ap, flags);
+        mode = va_arg(ap, mode_t);
+        va_end(ap);
+    }
+
+    return wrap_call("open", cali::IO_OTHER, [=]() { return fn(pathname, flags, mode); });
+}
+
+int
+close(int fd)
+{
+    auto fn = lookup(&real_close, "close");
+
+    return wrap_call("close", cali::IO_OTHER, [=]() { return fn(fd); });
+}
+
+int
+fsync(int fd)
+{
+    auto fn = lookup(&real_fsync, "fsync");
+
+    return wrap_call("fsync", cali::IO_OTHER, [=]() { return fn(fd); });
+}
+
+} // extern "C"
@@ -0,0 +1,315 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+/// \file  LockService.cpp
+/// \brief Caliper lock contention service
+
+#include "LockService.h"
+
+#include "../CaliperService.h"
+
+#include <Caliper.h>
+#include <EntryList.h>
+
+#include <ContextRecord.h>
+#include <Log.h>
+#include <RuntimeConfig.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <pthread.h>
+#include <vector>
+
+using namespace cali;
+using namespace std;
+
+namespace cali
+{
+    bool lock_enabled { false };
+}
+
+namespace
+{
+
+#define LOCKTABLE_SIZE 4096
+
+ConfigSet        config;
+
+ConfigSet::Entry configdata[] = {
+    { "top_locks", CALI_TYPE_UINT, "0",
+      "Number of most contended locks to report",
+      "Number of most contended locks to report at flush, by wait time.\n"
+      "0: don't keep per-lock statistics." 
+    },
+    ConfigSet::Terminator
+};
+
+struct LockCounters {
+    uint64_t contended;
+    uint64_t wait_nsec;
+    uint64_t cond_waits;
+    uint64_t cond_nsec;
+};
+
+/// Per-lock statistics, kept in an open-addressing hash table
+struct LockStats {
+    std::atomic<uintptr_t> addr;
+    std::atomic<uint64_t>  contended;
+    std::atomic<uint64_t>  wait_nsec;
+};
+
+pthread_key_t    counters_key;
+
+LockStats*       locktable = nullptr;
+unsigned         num_top_locks = 0;
+std::atomic<unsigned> num_dropped_locks { 0 };
+
+Attribute        contended_attr  { Attribute::invalid };
+Attribute        wait_time_attr  { Attribute::invalid };
+Attribute        cond_waits_attr { Attribute::invalid };
+Attribute        cond_time_attr  { Attribute::invalid };
+Attribute        address_attr    { Attribute::invalid };
+
+void release_counters(void* ptr)
+{
+    delete static_cast<LockCounters*>(ptr);
+}
+
+LockCounters* get_counters(bool alloc)
+{
+    LockCounters* ctr = static_cast<LockCounters*>(pthread_getspecific(counters_key));
+
+    if (alloc && !ctr) {
+        ctr = new LockCounters { 0, 0, 0, 0 };
+        pthread_setspecific(counters_key, ctr);
+    }
+
+    return ctr;
+}
+
+void update_locktable(const void* lock, uint64_t nsec)
+{
+    uintptr_t addr = reinterpret_cast<uintptr_t>(lock);
+    size_t    h    = (addr >> 4) % LOCKTABLE_SIZE;
+
+    for (size_t i = 0; i < LOCKTABLE_SIZE; ++i) {
+        LockStats* s   = &locktable[(h + i) % LOCKTABLE_SIZE];
+        uintptr_t  cur = s->addr.load(std::memory_order_relaxed);
+
+        if (cur == 0 && s->addr.compare_exchange_strong(cur, addr))
+            cur = addr;
+
+        if (cur == addr) {
+            s->contended.fetch_add(1,    std::memory_order_relaxed);
+            s->wait_nsec.fetch_add(nsec, std::memory_order_relaxed);
+
+            return;
+        }
+    }
+
+    ++num_dropped_locks;
+}
+
+// Append this thread's lock counter deltas to the snapshot
+void snapshot_cb(Caliper* c, int scope, const EntryList*, EntryList* sbuf)
+{
+    // Leave the counters alone in signal handlers: we might have
+    // interrupted an update
+    if (!(scope & CALI_SCOPE_THREAD) || c->is_signal())
+        return;
+
+    LockCounters* ctr = get_counters(false);
+
+    if (!ctr)
+        return;
+
+    if (ctr->contended > 0) {
+        uint64_t usec = ctr->wait_nsec / 1000;
+
+        sbuf->append(contended_attr.id(),
+                     Variant(CALI_TYPE_UINT, &ctr->contended, sizeof(uint64_t)));
+        sbuf->append(wait_time_attr.id(),
+                     Variant(CALI_TYPE_UINT, &usec,           sizeof(uint64_t)));
+
+        ctr->contended = 0;
+        ctr->wait_nsec %= 1000;
+    }
+    if (ctr->cond_waits > 0) {
+        uint64_t usec = ctr->cond_nsec / 1000;
+
+        sbuf->append(cond_waits_attr.id(),
+                     Variant(CALI_TYPE_UINT, &ctr->cond_waits, sizeof(uint64_t)));
+        sbuf->append(cond_time_attr.id(),
+                     Variant(CALI_TYPE_UINT, &usec,            sizeof(uint64_t)));
+
+        ctr->cond_waits = 0;
+        ctr->cond_nsec %= 1000;
+    }
+}
+
+// Write records for the most contended locks
+void flush_cb(Caliper* c, const EntryList*)
+{
+    if (!locktable)
+        return;
+
+    struct LockInfo {
+        uintptr_t addr;
+        uint64_t  contended;
+        uint64_t  wait_nsec;
+    };
+
+    std::vector<LockInfo> locks;
+
+    for (size_t i = 0; i < LOCKTABLE_SIZE; ++i) {
+        uintptr_t addr = locktable[i].addr.load();
+
+        if (addr == 0)
+            continue;
+
+        uint64_t  count = locktable[i].contended.exchange(0);
+        uint64_t  nsec  = locktable[i].wait_nsec.exchange(0);
+
+        if (count > 0)
+            locks.push_back(LockInfo { addr, count, nsec });
+    }
+
+    size_t n = std::min<size_t>(num_top_locks, locks.size());
+
+    std::partial_sort(locks.begin(), locks.begin() + n, locks.end(),
+                      [](const LockInfo& a, const LockInfo& b) {
+                          return a.wait_nsec > b.wait_nsec;
+                      });
+
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t usec = locks[i].wait_nsec / 1000;
+
+        Variant  attr[3] = { Variant(address_attr.id()),
+                             Variant(contended_attr.id()),
+                             Variant(wait_time_attr.id()) };
+        Variant  data[3] = { Variant(CALI_TYPE_ADDR, &locks[i].addr,      sizeof(uint64_t)),
+                             Variant(CALI_TYPE_UINT, &locks[i].contended, sizeof(uint64_t)),
+                             Variant(CALI_TYPE_UINT, &usec,               sizeof(uint64_t)) };
+
+        int               num[3] = { 0,       3,    3    };
+        const Variant* vecs[3]   = { nullptr, attr, data };
+
+        c->events().write_record(ContextRecord::record_descriptor(), num, vecs);
+    }
+
+    Log(1).stream() << "lock: wrote " << n << " of " << locks.size() 
+                    << " contended locks." << endl;
+
+    if (num_dropped_locks.load() > 0)
+        Log(1).stream() << "lock: lock table full, " << num_dropped_locks.load()
+                        << " contended lock waits not recorded per lock." << endl;
+}
+
+void lock_register(Caliper* c)
+{
+    config = RuntimeConfig::init("lock", configdata);
+
+    if (pthread_key_create(&counters_key, release_counters) != 0) {
+        Log(0).stream() << "lock: pthread_key_create() failed, disabling lock service" << endl;
+        return;
+    }
+
+    int prop = CALI_ATTR_ASVALUE | CALI_ATTR_SCOPE_THREAD | CALI_ATTR_SKIP_EVENTS;
+
+    Attribute unit_attr = c->create_attribute("time.unit", CALI_TYPE_STRING);
+    Variant   usec_val  = Variant(CALI_TYPE_STRING, "usec", 4);
+
+    contended_attr  =
+        c->create_attribute("lock.contended",  CALI_TYPE_UINT, prop);
+    wait_time_attr  =
+        c->create_attribute("lock.wait.time",  CALI_TYPE_UINT, prop,
+                            1, &unit_attr, &usec_val);
+    cond_waits_attr =
+        c->create_attribute("lock.cond.waits", CALI_TYPE_UINT, prop);
+    cond_time_attr  =
+        c->create_attribute("lock.cond.time",  CALI_TYPE_UINT, prop,
+                            1, &unit_attr, &usec_val);
+    address_attr    =
+        c->create_attribute("lock.address",    CALI_TYPE_ADDR, prop);
+
+    num_top_locks = config.get("top_locks").to_uint();
+
+    if (num_top_locks > 0) {
+        locktable = new LockStats[LOCKTABLE_SIZE];
+
+        for (size_t i = 0; i < LOCKTABLE_SIZE; ++i) {
+            locktable[i].addr.store(0);
+            locktable[i].contended.store(0);
+            locktable[i].wait_nsec.store(0);
+        }
+
+        c->events().flush.connect(&flush_cb);
+    }
+
+    c->events().snapshot.connect(&snapshot_cb);
+
+    lock_enabled = true;
+
+    Log(1).stream() << "Registered lock service" << endl;
+}
+
+} // anonymous namespace 
+
+
+namespace cali 
+{
+
+void lock_record(LockKind kind, const void* lock, uint64_t nsec)
+{
+    // Skip waits inside Caliper and on threads Caliper doesn't know yet
+    if (!Caliper::sigsafe_instance())
+        return;
+
+    LockCounters* ctr = get_counters(true);
+
+    if (kind == LOCK_COND) {
+        ++ctr->cond_waits;
+        ctr->cond_nsec += nsec;
+    } else {
+        ++ctr->contended;
+        ctr->wait_nsec += nsec;
+
+        if (locktable)
+            update_locktable(lock, nsec);
+    }
+}
+
+CaliperService lock_service = { "lock", ::lock_register };
+
+} // namespace cali
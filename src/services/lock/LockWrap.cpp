@@ -0,0 +1,175 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+/// \file  LockWrap.cpp
+/// \brief pthread lock function wrappers for the lock service
+///
+/// Link this library into the application (or LD_PRELOAD it) to 
+/// interpose pthread_mutex_lock(), pthread_rwlock_rdlock(), 
+/// pthread_rwlock_wrlock(), and pthread_cond_wait(). The lock wrappers
+/// try to take the lock first, and only time the wait if that fails. 
+
+#include "LockService.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <ctime>
+
+#include <dlfcn.h>
+#include <pthread.h>
+
+namespace
+{
+
+// Prevents recording lock waits while recording lock waits
+thread_local bool in_wrapper = false;
+
+inline uint64_t
+now_nsec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+template<typename Fn>
+Fn
+lookup(Fn* fnptr, const char* name, const char* version = nullptr)
+{
+    if (!*fnptr) {
+        void* sym = version ? dlvsym(RTLD_NEXT, name, version) : nullptr;
+
+        if (!sym)
+            sym = dlsym(RTLD_NEXT, name);
+
+        *fnptr = reinterpret_cast<Fn>(sym);
+    }
+
+    return *fnptr;
+}
+
+/// Call \a fn and record its duration as a wait on \a lock
+template<typename Fn>
+int
+wait_call(cali::LockKind kind, const void* lock, Fn fn)
+{
+    in_wrapper = true;
+
+    uint64_t begin = now_nsec();
+    int      ret   = fn();
+    uint64_t end   = now_nsec();
+
+    cali::lock_record(kind, lock, end - begin);
+
+    in_wrapper = false;
+
+    return ret;
+}
+
+int (*real_mutex_lock)(pthread_mutex_t*)                    = nullptr;
+int (*real_mutex_trylock)(pthread_mutex_t*)                 = nullptr;
+int (*real_rwlock_rdlock)(pthread_rwlock_t*)                = nullptr;
+int (*real_rwlock_tryrdlock)(pthread_rwlock_t*)             = nullptr;
+int (*real_rwlock_wrlock)(pthread_rwlock_t*)                = nullptr;
+int (*real_rwlock_trywrlock)(pthread_rwlock_t*)             = nullptr;
+int (*real_cond_wait)(pthread_cond_t*, pthread_mutex_t*)    = nullptr;
+
+} // anonymous namespace
+
+extern "C"
+{
+
+int
+pthread_mutex_lock(pthread_mutex_t* mutex)
+{
+    auto lock = lookup(&real_mutex_lock, "pthread_mutex_lock");
+
+    if (!cali::lock_enabled || in_wrapper)
+        return lock(mutex);
+
+    // uncontended: done
+    int ret = lookup(&real_mutex_trylock, "pthread_mutex_trylock")(mutex);
+
+    if (ret != EBUSY)
+        return ret;
+
+    return wait_call(cali::LOCK_MUTEX, mutex, [=]() { return lock(mutex); });
+}
+
+int
+pthread_rwlock_rdlock(pthread_rwlock_t* rwlock)
+{
+    auto lock = lookup(&real_rwlock_rdlock, "pthread_rwlock_rdlock");
+
+    if (!cali::lock_enabled || in_wrapper)
+        return lock(rwlock);
+
+    int ret = lookup(&real_rwlock_tryrdlock, "pthread_rwlock_tryrdlock")(rwlock);
+
+    if (ret != EBUSY)
+        return ret;
+
+    return wait_call(cali::LOCK_RWLOCK, rwlock, [=]() { return lock(rwlock); });
+}
+
+int
+pthread_rwlock_wrlock(pthread_rwlock_t* rwlock)
+{
+    auto lock = lookup(&real_rwlock_wrlock, "pthread_rwlock_wrlock");
+
+    if (!cali::lock_enabled || in_wrapper)
+        return lock(rwlock);
+
+    int ret = lookup(&real_rwlock_trywrlock, "pthread_rwlock_trywrlock")(rwlock);
+
+    if (ret != EBUSY)
+        return ret;
+
+    return wait_call(cali::LOCK_RWLOCK, rwlock, [=]() { return lock(rwlock); });
+}
+
+int
+pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex)
+{
+    // glibc has an old pthread_cond_wait version for binary compatibility;
+    // make sure we get the current one
+    auto wait = lookup(&real_cond_wait, "pthread_cond_wait", "GLIBC_2.3.2");
+
+    if (!cali::lock_enabled || in_wrapper)
+        return wait(cond, mutex);
+
+    return wait_call(cali::LOCK_COND, cond, [=]() { return wait(cond, mutex); });
+}
+
+} // extern "C"
@@ -105,7 +105,7 @@ long long* get_counter_array(bool alloc, size_t num_counters)
 void snapshot_cb(Caliper* c, int scope, const EntryList*, EntryList* snapshot) {
     auto num_counters = global_info.counter_events.size();
     
-    if (num_counters < 1)
+    if (num_counters < 1 || !(scope & CALI_SCOPE_THREAD))
         return;
 
     long long* counter_values = get_counter_array(!c->is_signal(), num_counters);
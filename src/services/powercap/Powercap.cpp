@@ -0,0 +1,335 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+/// \file  Powercap.cpp
+/// \brief Caliper energy measurement service for the Linux powercap (RAPL) interface
+
+#include "../CaliperService.h"
+
+#include <Caliper.h>
+#include <EntryList.h>
+
+#include <Log.h>
+#include <RuntimeConfig.h>
+
+#include <util/spinlock.hpp>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace cali;
+using namespace std;
+
+namespace
+{
+
+ConfigSet        config;
+
+ConfigSet::Entry configdata[] = {
+    { "root", CALI_TYPE_STRING, "/sys/class/powercap",
+      "Root directory of the powercap sysfs tree",
+      "Root directory of the powercap sysfs tree. The service reads the\n"
+      "intel-rapl* zones in this directory."
+    },
+    { "min_interval", CALI_TYPE_UINT, "1000",
+      "Minimum time between energy counter reads (usec)",
+      "Minimum time between energy counter reads in microseconds.\n"
+      "Energy values for snapshots in between are interpolated from\n"
+      "the power measured between the previous two reads. 0: read the\n"
+      "counters at every snapshot."
+    },
+    ConfigSet::Terminator
+};
+
+struct Domain {
+    std::string name;
+    int         fd;
+    uint64_t    max_range;  ///< counter wraps around at this value (uJ)
+    uint64_t    last_raw;   ///< last raw counter value
+    uint64_t    total;      ///< energy (uJ) since init at the last read
+    uint64_t    prev_total; ///< energy (uJ) since init at the read before
+    uint64_t    reported;   ///< energy (uJ) since init reported in snapshots
+    unsigned    skipped;    ///< reads skipped: wraparound with unknown range
+    Attribute   attr;
+};
+
+std::vector<Domain> domains;
+
+util::spinlock   domain_lock;
+
+uint64_t         min_interval_nsec = 0;
+uint64_t         last_read_nsec    = 0;
+uint64_t         prev_read_nsec    = 0;
+
+inline uint64_t
+now_nsec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+bool read_counter(int fd, uint64_t* val)
+{
+    char    buf[32];
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+
+    if (n <= 0)
+        return false;
+
+    buf[n] = '\0';
+    *val   = strtoull(buf, nullptr, 10);
+
+    return true;
+}
+
+std::string read_line(const std::string& filename)
+{
+    ifstream    is(filename);
+    std::string line;
+
+    if (is)
+        getline(is, line);
+
+    return line;
+}
+
+/// Read all energy counters. Must be called with domain_lock held.
+void read_domains(uint64_t now)
+{
+    for (Domain& d : domains) {
+        uint64_t raw = 0;
+
+        if (!read_counter(d.fd, &raw))
+            continue;
+
+        // Without a known range, we can't tell how much energy passed 
+        // across a wraparound: skip this read
+        if (raw < d.last_raw && d.max_range == 0) {
+            d.last_raw   = raw;
+            d.prev_total = d.total;
+            ++d.skipped;
+            continue;
+        }
+
+        uint64_t delta = (raw >= d.last_raw ? raw - d.last_raw : raw + d.max_range - d.last_raw);
+
+        d.last_raw   = raw;
+        d.prev_total = d.total;
+        d.total     += delta;
+    }
+
+    prev_read_nsec = last_read_nsec;
+    last_read_nsec = now;
+}
+
+/// Energy of domain \a d since init at time \a now, interpolated from
+/// the power between the last two reads
+uint64_t estimate(const Domain& d, uint64_t now)
+{
+    uint64_t est = d.total;
+
+    if (last_read_nsec > prev_read_nsec && now > last_read_nsec)
+        est += static_cast<uint64_t>(static_cast<double>(d.total - d.prev_total) 
+                                     * (now - last_read_nsec) 
+                                     / (last_read_nsec - prev_read_nsec));
+
+    return est;
+}
+
+void snapshot_cb(Caliper* c, int scope, const EntryList*, EntryList* sbuf)
+{
+    if (!(scope & CALI_SCOPE_PROCESS))
+        return;
+
+    // Don't wait for the lock in a signal handler; the energy goes into 
+    // a later snapshot instead
+    std::unique_lock<util::spinlock> g(domain_lock, std::defer_lock);
+
+    if (c->is_signal()) {
+        if (!g.try_lock())
+            return;
+    } else
+        g.lock();
+
+    uint64_t now = now_nsec();
+
+    if (now - last_read_nsec >= min_interval_nsec)
+        read_domains(now);
+
+    for (Domain& d : domains) {
+        // Interpolated values can be ahead of the next read: never report
+        // less than we did before, so deltas stay non-negative
+        uint64_t val   = std::max(estimate(d, now), d.reported);
+        uint64_t delta = val - d.reported;
+
+        d.reported = val;
+
+        sbuf->append(d.attr.id(), Variant(CALI_TYPE_UINT, &delta, sizeof(uint64_t)));
+    }
+}
+
+void finish_cb(Caliper*)
+{
+    for (Domain& d : domains) {
+        if (d.skipped > 0)
+            Log(1).stream() << "powercap: energy." << d.name << ": skipped " << d.skipped
+                            << " reads at counter wraparounds" << endl;
+
+        close(d.fd);
+    }
+
+    domains.clear();
+}
+
+/// Find the intel-rapl* zones in the powercap root directory and open 
+/// their energy counters
+void init_domains(Caliper* c, const std::string& root)
+{
+    DIR* dir = opendir(root.c_str());
+
+    if (!dir) {
+        Log(0).stream() << "powercap: cannot open " << root << endl;
+        return;
+    }
+
+    // zone directory -> zone name, e.g. intel-rapl:0:1 -> dram 
+    std::map<std::string, std::string> zones;
+
+    for (struct dirent* d = readdir(dir); d; d = readdir(dir))
+        if (strncmp(d->d_name, "intel-rapl:", 11) == 0)
+            zones[d->d_name] = read_line(root + "/" + d->d_name + "/name");
+
+    closedir(dir);
+
+    Attribute unit_attr = c->create_attribute("energy.unit", CALI_TYPE_STRING);
+    Variant   uj_val    = Variant(CALI_TYPE_STRING, "uJ", 2);
+
+    for (auto &p : zones) {
+        std::string path = root + "/" + p.first;
+
+        // Prefix subzone names with their parent zone's name, 
+        // e.g. package-0.dram
+        std::string name = p.second.empty() ? p.first : p.second;
+        size_t      pos  = p.first.rfind(':');
+
+        if (pos != std::string::npos && pos > strlen("intel-rapl")) {
+            auto it = zones.find(p.first.substr(0, pos));
+
+            if (it != zones.end() && !it->second.empty())
+                name = it->second + "." + name;
+        }
+
+        int fd = open((path + "/energy_uj").c_str(), O_RDONLY);
+
+        if (fd < 0) {
+            Log(1).stream() << "powercap: cannot open " << path << "/energy_uj: " 
+                            << strerror(errno) << endl;
+            continue;
+        }
+
+        Domain d;
+
+        d.name       = name;
+        d.fd         = fd;
+        d.max_range  = strtoull(read_line(path + "/max_energy_range_uj").c_str(), nullptr, 10);
+        d.last_raw   = 0;
+        d.total      = 0;
+        d.prev_total = 0;
+        d.reported   = 0;
+        d.skipped    = 0;
+
+        if (d.max_range == 0)
+            Log(1).stream() << "powercap: no max_energy_range_uj in " << path
+                            << ", counter wraparounds will be skipped" << endl;
+
+        if (!read_counter(fd, &d.last_raw)) {
+            Log(1).stream() << "powercap: cannot read " << path << "/energy_uj" << endl;
+            close(fd);
+            continue;
+        }
+
+        d.attr = 
+            c->create_attribute(std::string("energy.") + name, CALI_TYPE_UINT,
+                                CALI_ATTR_ASVALUE | CALI_ATTR_SCOPE_PROCESS | CALI_ATTR_SKIP_EVENTS,
+                                1, &unit_attr, &uj_val);
+
+        Log(2).stream() << "powercap: reading " << path << " as energy." << name << endl;
+
+        domains.push_back(d);
+    }
+
+    last_read_nsec = now_nsec();
+}
+
+void powercap_register(Caliper* c)
+{
+    config = RuntimeConfig::init("powercap", configdata);
+
+    min_interval_nsec = config.get("min_interval").to_uint() * 1000;
+
+    init_domains(c, config.get("root").to_string());
+
+    if (domains.empty()) {
+        Log(0).stream() << "powercap: no energy counters found, disabling powercap service" << endl;
+        return;
+    }
+
+    c->events().snapshot.connect(&snapshot_cb);
+    c->events().finish_evt.connect(&finish_cb);
+
+    Log(1).stream() << "Registered powercap service (" << domains.size() 
+                    << " energy counters)" << endl;
+}
+
+} // anonymous namespace 
+
+
+namespace cali 
+{
+    CaliperService powercap_service = { "powercap", ::powercap_register };
+} // namespace cali
@@ -41,7 +41,15 @@
 #include <Log.h>
 #include <RuntimeConfig.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include <signal.h>
 #include <time.h>
 #include <sys/time.h>
@@ -49,6 +57,10 @@
 
 #include <unistd.h>
 
+#include <linux/perf_event.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
 #include <ucontext.h>
@@ -60,6 +72,7 @@ namespace
 {
     Attribute timer_attr   { Attribute::invalid };
     Attribute sampler_attr { Attribute::invalid };
+    Attribute tid_attr     { Attribute::invalid };
 
     cali_id_t sampler_attr_id    = CALI_INV_ID;
     
@@ -70,6 +83,7 @@ namespace
 
     int       n_samples           = 0;
     int       n_processed_samples = 0;
+    int       n_deferred_samples  = 0;
 
     static const ConfigSet::Entry s_configdata[] = {
         { "frequency", CALI_TYPE_INT, "10",
@@ -80,18 +94,272 @@ namespace
           "Capture process-wide context information",
           "Capture process-wide context information in addition to thread-local context"
         },
+        { "backend", CALI_TYPE_STRING, "timer",
+          "Sampling backend (timer or perf)",
+          "Sampling backend.\n"
+          "  timer: a SIGPROF timer signal takes each sample\n"
+          "  perf:  the kernel writes samples into a perf_event ring buffer,\n"
+          "         which a background thread processes"
+        },
         ConfigSet::Terminator
     };
 
+    //
+    // --- perf_event backend
+    //
+
+    const size_t  PERF_DATA_PAGES    = 16;   // must be a power of two
+    const int     PERF_DRAIN_TIMEOUT = 10;   // msec
+
+    struct PerfThread {
+        pid_t                         tid;
+        int                           fd;
+        struct perf_event_mmap_page*  meta;
+        size_t                        map_size;
+        const Caliper::ContextHistory* history;
+        bool                          retired;
+    };
+
+    bool                     use_perf = false;
+
+    std::mutex               perf_lock;
+    std::vector<PerfThread*> perf_threads;
+
+    std::thread              perf_drain_thread;
+    std::atomic<bool>        perf_stop { false };
+    std::atomic<pid_t>       perf_drain_tid { 0 };
+
+    size_t                   page_size = 0;
+
+    uint64_t                 n_perf_samples    = 0;
+    uint64_t                 n_perf_lost       = 0;
+    uint64_t                 n_perf_nocontext  = 0;
+
+    pid_t current_tid()
+    {
+        return static_cast<pid_t>(syscall(SYS_gettid));
+    }
+
+    int perf_open(pid_t tid)
+    {
+        struct perf_event_attr pe;
+
+        memset(&pe, 0, sizeof(pe));
+
+        pe.size             = sizeof(pe);
+        pe.type             = PERF_TYPE_SOFTWARE;
+        pe.config           = PERF_COUNT_SW_CPU_CLOCK;
+        pe.sample_period    = nsec_interval; // cpu-clock counts nanoseconds
+        pe.sample_type      = PERF_SAMPLE_IP | PERF_SAMPLE_TID | PERF_SAMPLE_TIME;
+        pe.exclude_kernel   = 1;
+        pe.exclude_hv       = 1;
+        pe.use_clockid      = 1;
+        pe.clockid          = CLOCK_MONOTONIC; // same clock as the context history
+        pe.watermark        = 1;
+        pe.wakeup_watermark = PERF_DATA_PAGES * page_size / 2;
+
+        return static_cast<int>(syscall(SYS_perf_event_open, &pe, tid, -1, -1, PERF_FLAG_FD_CLOEXEC));
+    }
+
+    /// \brief Start perf sampling of the calling thread
+    bool setup_perf(Caliper* c)
+    {
+        pid_t tid = current_tid();
+
+        // don't sample the drain thread
+        if (tid == perf_drain_tid.load())
+            return true;
+
+        int fd = perf_open(tid);
+
+        if (fd < 0) {
+            Log(0).stream() << "sampler: perf_event_open() failed: " << strerror(errno) << std::endl;
+            return false;
+        }
+
+        size_t map_size = (PERF_DATA_PAGES + 1) * page_size;
+        void*  map      = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        if (map == MAP_FAILED) {
+            Log(0).stream() << "sampler: mmap() of perf buffer failed: " << strerror(errno) << std::endl;
+            close(fd);
+            return false;
+        }
+
+        PerfThread* t = new PerfThread;
+
+        t->tid      = tid;
+        t->fd       = fd;
+        t->meta     = static_cast<struct perf_event_mmap_page*>(map);
+        t->map_size = map_size;
+        t->history  = c->publish_context();
+        t->retired  = false;
+
+        std::lock_guard<std::mutex>
+            g(perf_lock);
+
+        perf_threads.push_back(t);
+
+        Log(2).stream() << "sampler: opened perf buffer for thread " << tid << std::endl;
+
+        return true;
+    }
+
+    /// \brief Stop perf sampling of the calling thread. The drain thread
+    ///   processes the remaining samples and closes the buffer.
+    void clear_perf()
+    {
+        pid_t tid = current_tid();
+
+        std::lock_guard<std::mutex>
+            g(perf_lock);
+
+        for (PerfThread* t : perf_threads)
+            if (t->tid == tid && !t->retired) {
+                ioctl(t->fd, PERF_EVENT_IOC_DISABLE, 0);
+                t->retired = true;
+            }
+    }
+
+    void process_perf_sample(Caliper* c, const PerfThread* t, uint64_t ip, uint32_t tid, uint64_t time)
+    {
+        Node* node = nullptr;
+
+        // The thread's context when the sample was taken
+        if (!Caliper::find_context(t->history, time, &node))
+            ++n_perf_nocontext;
+
+        int     v_tid = static_cast<int>(tid);
+
+        Variant v_pc(CALI_TYPE_ADDR, &ip, sizeof(uint64_t));
+        EntryList trigger_info(1, &sampler_attr_id, &v_pc);
+
+        EntryList::FixedEntryList<64> snapshot_data;
+        EntryList sbuf(snapshot_data);
+
+        if (sample_contexts & CALI_SCOPE_PROCESS)
+            c->pull_snapshot(CALI_SCOPE_PROCESS, &trigger_info, &sbuf);
+        else
+            sbuf.append(trigger_info);
+
+        if (node)
+            sbuf.append(node);
+
+        sbuf.append(tid_attr.id(), Variant(v_tid));
+
+        c->events().process_snapshot(c, &trigger_info, &sbuf);
+    }
+
+    /// \brief Process all samples in \a t's ring buffer. Must hold perf_lock.
+    void drain_perf_buffer(Caliper* c, PerfThread* t)
+    {
+        const size_t   data_size = PERF_DATA_PAGES * page_size;
+        unsigned char* data      = reinterpret_cast<unsigned char*>(t->meta) + page_size;
+
+        uint64_t head = __atomic_load_n(&t->meta->data_head, __ATOMIC_ACQUIRE);
+        uint64_t tail = t->meta->data_tail;
+
+        unsigned char buf[256];
+
+        while (tail < head) {
+            struct perf_event_header hdr;
+
+            for (size_t i = 0; i < sizeof(hdr); ++i)
+                reinterpret_cast<unsigned char*>(&hdr)[i] = data[(tail + i) % data_size];
+
+            if (hdr.size < sizeof(hdr))
+                break;
+
+            if (hdr.size <= sizeof(buf)) {
+                // records may wrap around the end of the buffer
+                for (size_t i = 0; i < hdr.size; ++i)
+                    buf[i] = data[(tail + i) % data_size];
+
+                const unsigned char* p = buf + sizeof(hdr);
+
+                if (hdr.type == PERF_RECORD_SAMPLE) {
+                    // PERF_SAMPLE_IP | PERF_SAMPLE_TID | PERF_SAMPLE_TIME layout
+                    uint64_t ip, time;
+                    uint32_t pid_tid[2];
+
+                    memcpy(&ip,     p,      sizeof(uint64_t));
+                    memcpy(pid_tid, p + 8,  2 * sizeof(uint32_t));
+                    memcpy(&time,   p + 16, sizeof(uint64_t));
+
+                    process_perf_sample(c, t, ip, pid_tid[1], time);
+                    ++n_perf_samples;
+                } else if (hdr.type == PERF_RECORD_LOST) {
+                    uint64_t lost;
+
+                    memcpy(&lost, p + 8, sizeof(uint64_t)); // after the event id
+                    n_perf_lost += lost;
+                }
+            }
+
+            tail += hdr.size;
+        }
+
+        __atomic_store_n(&t->meta->data_tail, tail, __ATOMIC_RELEASE);
+    }
+
+    /// \brief Process the samples of all threads, and release retired 
+    ///   threads' buffers
+    void drain_perf_buffers(Caliper* c)
+    {
+        std::lock_guard<std::mutex>
+            g(perf_lock);
+
+        for (PerfThread* t : perf_threads) {
+            drain_perf_buffer(c, t);
+
+            if (t->retired) {
+                munmap(t->meta, t->map_size);
+                close(t->fd);
+                delete t;
+            }
+        }
+
+        perf_threads.erase(std::remove_if(perf_threads.begin(), perf_threads.end(),
+                                          [](PerfThread* t) { return t->retired; }),
+                           perf_threads.end());
+    }
+
+    void perf_drain_loop()
+    {
+        perf_drain_tid.store(current_tid());
+
+        Caliper c = Caliper::instance();
+
+        while (!perf_stop.load()) {
+            std::vector<struct pollfd> fds;
+
+            {
+                std::lock_guard<std::mutex>
+                    g(perf_lock);
+
+                for (const PerfThread* t : perf_threads)
+                    fds.push_back(pollfd { t->fd, POLLIN, 0 });
+            }
+
+            if (fds.empty())
+                std::this_thread::sleep_for(std::chrono::milliseconds(PERF_DRAIN_TIMEOUT));
+            else
+                poll(fds.data(), fds.size(), PERF_DRAIN_TIMEOUT);
+
+            drain_perf_buffers(&c);
+        }
+    }
+
+    void pre_flush_cb(Caliper* c, const EntryList*)
+    {
+        // get the samples that are still in the buffers
+        drain_perf_buffers(c);
+    }
+
     void on_prof(int sig, siginfo_t *info, void *context)
     {
         ++n_samples;
         
-        Caliper c = Caliper::sigsafe_instance();
-
-        if (!c)
-            return;
-        
         ucontext_t *ucontext = (ucontext_t *) context;
 
         uint64_t  pc = static_cast<uint64_t>(ucontext->uc_mcontext.gregs[REG_RIP]);
@@ -99,6 +367,19 @@ namespace
 
         EntryList trigger_info(1, &sampler_attr_id, &v_pc);
 
+        Caliper c = Caliper::sigsafe_instance();
+
+        if (!c) {
+            // We interrupted Caliper itself: let the thread take the
+            // sample when it leaves the Caliper API
+            if (Caliper::defer_snapshot(sample_contexts, &trigger_info)) {
+                ++n_deferred_samples;
+                ++n_processed_samples;
+            }
+
+            return;
+        }
+
         c.push_snapshot(sample_contexts, &trigger_info);
 
         ++n_processed_samples;
@@ -186,23 +467,71 @@ namespace
     }
     
     void create_scope_cb(Caliper* c, cali_context_scope_t scope) {
-        if (scope == CALI_SCOPE_THREAD)
+        if (scope != CALI_SCOPE_THREAD)
+            return;
+
+        if (use_perf)
+            setup_perf(c);
+        else
             setup_settimer(c);
     }
 
     void release_scope_cb(Caliper* c, cali_context_scope_t scope) {
-        if (scope == CALI_SCOPE_THREAD)
+        if (scope != CALI_SCOPE_THREAD)
+            return;
+
+        if (use_perf)
+            clear_perf();
+        else
             clear_timer(c);
     }
 
     void finish_cb(Caliper* c) {
+        if (use_perf) {
+            clear_perf();
+
+            perf_stop.store(true);
+            perf_drain_thread.join();
+
+            drain_perf_buffers(c);
+
+            Log(1).stream() << "Sampler: processed " << n_perf_samples << " perf samples ("
+                            << n_perf_lost << " lost, "
+                            << n_perf_nocontext << " without thread context)." << endl;
+
+            return;
+        }
+
         clear_timer(c);
         clear_signal();
 
         Log(1).stream() << "Sampler: processed " << n_processed_samples << " samples ("
                         << n_samples << " total, "
+                        << n_deferred_samples << " deferred, "
                         << n_samples - n_processed_samples << " dropped)." << endl;
     }
+
+    /// \brief Set up the perf backend for the calling (main) thread and
+    ///   start the drain thread. Returns \c false if perf_event isn't available.
+    bool setup_perf_backend(Caliper* c)
+    {
+        page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+        // Published contexts refer to context tree nodes, which must stay valid
+        if (RuntimeConfig::get("caliper", "reclaim_nodes").to_bool()) {
+            Log(0).stream() << "sampler: perf backend does not work with node reclamation" << endl;
+            return false;
+        }
+
+        if (!setup_perf(c))
+            return false;
+
+        c->events().pre_flush_evt.connect(pre_flush_cb);
+
+        perf_drain_thread = std::thread(perf_drain_loop);
+
+        return true;
+    }
     
     void sampler_register(Caliper* c)
     {
@@ -220,12 +549,26 @@ namespace
                                 CALI_ATTR_SKIP_EVENTS  |
                                 CALI_ATTR_ASVALUE);
 
+        tid_attr =
+            c->create_attribute("cali.sampler.tid", CALI_TYPE_INT,
+                                CALI_ATTR_SCOPE_THREAD |
+                                CALI_ATTR_SKIP_EVENTS  |
+                                CALI_ATTR_ASVALUE);
+
         sampler_attr_id = sampler_attr.id();
 
+        std::string backend = config.get("backend").to_string();
+
+        use_perf = (backend == "perf");
+
+        if (!use_perf && backend != "timer")
+            Log(0).stream() << "sampler: unknown backend \"" << backend << "\", using timer" << endl;
+
         int frequency = config.get("frequency").to_int();
         
-        // some sanity checking
-        frequency     = std::min(std::max(frequency, 1), 10000);
+        // some sanity checking. Without signal handler overhead, the perf 
+        // backend can sample at higher frequencies.
+        frequency     = std::min(std::max(frequency, 1), use_perf ? 100000 : 10000);
         nsec_interval = 1000000000 / frequency;
 
         sample_contexts = CALI_SCOPE_THREAD;
@@ -233,15 +576,23 @@ namespace
         if (config.get("add_shared_context").to_bool() == true)
             sample_contexts |= CALI_SCOPE_PROCESS;
         
+        if (use_perf && !setup_perf_backend(c)) {
+            Log(0).stream() << "sampler: perf backend not available, using timer" << endl;
+            use_perf = false;
+        }
+
         c->events().create_scope_evt.connect(create_scope_cb);
         c->events().release_scope_evt.connect(release_scope_cb);
         c->events().finish_evt.connect(finish_cb);
 
-        setup_signal();
-        setup_settimer(c);
+        if (!use_perf) {
+            setup_signal();
+            setup_settimer(c);
+        }
         
         Log(1).stream() << "Registered sampler service. Using "
-                        << frequency << "Hz sampling frequency." << endl;
+                        << frequency << "Hz sampling frequency"
+                        << (use_perf ? " with perf backend." : ".") << endl;
     }
 
 } // namespace
@@ -167,15 +167,21 @@ Attribute find_offset_attribute(Caliper* c, cali_id_t attr_id, unsigned level)
 void snapshot_cb(Caliper* c, int scope, const EntryList* trigger_info, EntryList* sbuf) {
     auto now = chrono::high_resolution_clock::now();
 
-    if ((record_duration || record_phases || record_offset) && scope & CALI_SCOPE_THREAD) {
+    // Without any scope, the event service only marks an event that
+    // does not trigger a snapshot: just record phase start times then
+
+    if ((record_duration || record_phases || record_offset) && (scope & CALI_SCOPE_THREAD || scope == 0)) {
         uint64_t  usec = chrono::duration_cast<chrono::microseconds>(now - tstart).count();
         Variant v_usec = Variant(usec);
-        Variant v_offs = c->exchange(timeoffs_attr, v_usec);
 
-        if (record_duration && !v_offs.empty()) {
-            uint64_t duration = usec - v_offs.to_uint();
+        if (scope & CALI_SCOPE_THREAD) {
+            Variant v_offs = c->exchange(timeoffs_attr, v_usec);
+
+            if (record_duration && !v_offs.empty()) {
+                uint64_t duration = usec - v_offs.to_uint();
 
-            sbuf->append(snapshot_duration_attr.id(), Variant(duration));
+                sbuf->append(snapshot_duration_attr.id(), Variant(duration));
+            }
         }
 
         if (record_phases && trigger_info) {
@@ -50,7 +50,6 @@
 #include <atomic>
 #include <cstring>
 #include <mutex>
-#include <unordered_set>
 
 using namespace trace;
 using namespace cali;
@@ -180,13 +179,13 @@ namespace
             
         case BufferPolicy::Flush:
         {
-            unordered_set<cali_id_t> written_node_cache;
-            
             std::lock_guard<std::mutex>
                 g(global_flush_lock);            
 
+            c->write_new_nodes();
+
             Log(1).stream() << "Trace buffer full: flushed "
-                            << tbuf->chunks->flush(c, written_node_cache)
+                            << tbuf->chunks->flush(c)
                             << " snapshots." << endl;
             
             return tbuf;
@@ -227,7 +226,6 @@ namespace
         }
 
         size_t num_written = 0;
-        unordered_set<cali_id_t> written_node_cache;
 
         TraceBufferChunk::UsageInfo aggregate_info { 0, 0, 0 };
         
@@ -246,7 +244,10 @@ namespace
                 aggregate_info.used     += info.used;
             }
             
-            num_written += tbuf->chunks->flush(c, written_node_cache);
+            // Nodes may have been created since the flush started
+            c->write_new_nodes();
+
+            num_written += tbuf->chunks->flush(c);
             tbuf->stopped.store(false);
             
             if (tbuf->retired.load()) {
@@ -75,7 +75,7 @@ void TraceBufferChunk::reset()
 }
 
 
-size_t TraceBufferChunk::flush(Caliper* c, std::unordered_set<cali_id_t>& written_node_cache)
+size_t TraceBufferChunk::flush(Caliper* c)
 {
     size_t written = 0;
 
@@ -102,38 +102,6 @@ size_t TraceBufferChunk::flush(Caliper* c, std::unordered_set<cali_id_t>& writte
         for (int i = 0; i < n_attr;  ++i)
             vals_vec[i] = Variant::unpack(m_data + p, &p, nullptr);
 
-        // write nodes
-        // FIXME: this node cache is a terrible kludge, needs to go away
-        //   either make node-by-id lookup fast,
-        //   or fix node-before-snapshot I/O requirement
-
-        for (int i = 0; i < n_nodes; ++i) {
-            cali_id_t node_id = node_vec[i].to_id();
-
-            if (written_node_cache.count(node_id))
-                continue;
-                    
-            Node* node = c->node(node_vec[i].to_id());
-                    
-            if (node)
-                node->write_path(c->events().write_record);
-
-            written_node_cache.insert(node_id);
-        }
-        for (int i = 0; i < n_attr; ++i) {
-            cali_id_t node_id = attr_vec[i].to_id();
-
-            if (written_node_cache.count(node_id))
-                continue;
-
-            Node* node = c->node(attr_vec[i].to_id());
-                    
-            if (node)
-                node->write_path(c->events().write_record);
-
-            written_node_cache.insert(node_id);
-        }
-
         // write snapshot
                 
         int               n[3] = {  n_nodes,   n_attr,   n_attr };
@@ -150,7 +118,7 @@ size_t TraceBufferChunk::flush(Caliper* c, std::unordered_set<cali_id_t>& writte
     // 
             
     if (m_next) {
-        written += m_next->flush(c, written_node_cache);
+        written += m_next->flush(c);
         delete m_next;
         m_next = 0;
     }
@@ -0,0 +1,439 @@
+// Copyright (c) 2016, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+/// @file cali-merge.cpp
+/// Merges and aggregates many Caliper streams with a parallel tree reduction
+
+#include <Args.h>
+
+#include <Aggregator.h>
+#include <CaliperMetadataDB.h>
+#include <RecordProcessor.h>
+
+#include <ContextRecord.h>
+#include <Node.h>
+
+#include <csv/CsvReader.h>
+#include <csv/CsvSpec.h>
+
+#include <util/split.hpp>
+
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace cali;
+using namespace std;
+using namespace util;
+
+
+namespace
+{
+    const char* usage = "cali-merge [OPTION]... [FILE]..."
+        "\n  Merge and aggregate many caliper streams into a single stream";
+
+    const Args::Table option_table[] = { 
+        // name, longopt name, shortopt char, has argument, info, argument info
+        { "aggregate", "aggregate", 'a', true,
+          "Aggregate snapshots using the given aggregation operators: (sum(attribute)|count)[:...] (default: count)",
+          "AGGREGATION_OPS"
+        },
+        { "aggregate-key", "aggregate-key", 0, true,
+          "List of attributes to aggregate over (collapses all other attributes): attribute[:...]",
+          "ATTRIBUTES"
+        },
+        { "threads", "threads", 0, true,
+          "Use this many threads",
+          "THREADS"
+        },
+        { "output", "output", 'o', true,  "Set the output file name", "FILE"  },
+        { "help",   "help",   'h', false, "Print help message",       nullptr },
+        Args::Table::Terminator
+    };
+
+    /// Translates the aggregation operators given by the user into the
+    /// operators that combine already aggregated snapshots. Only operators
+    /// that can be re-applied to partial results are supported.
+    bool make_combine_ops(const string& ops, string& combine_ops) {
+        vector<string> list;
+        
+        util::split(ops, ':', back_inserter(list));
+
+        for (const string& s : list) {
+            string::size_type oparen = s.find_first_of('(');
+            string kernelname = s.substr(0, oparen);
+
+            if (!combine_ops.empty())
+                combine_ops.append(":");
+
+            if (kernelname == "count")
+                combine_ops.append("sum(aggregate.count)");
+            else if (kernelname == "sum")
+                combine_ops.append(s);
+            else {
+                cerr << "cali-merge: error: aggregation operator \"" << kernelname
+                     << "\" can not be used for merging" << endl;
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /// A partial merge result. Holds the metadata DB of one or more merged
+    /// input streams, and the aggregation state of their snapshots.
+    struct Partial {
+        CaliperMetadataDB db;
+        Aggregator        aggregate;
+        unsigned          level; ///< Level in the reduction tree 
+
+        Partial(const string& combine_ops, const string& key)
+            : aggregate(combine_ops, key), level(0)
+            { }
+    };
+
+    /// Copies snapshot entries and the nodes they reference from one 
+    /// metadata DB into another.
+    class SnapshotImporter {
+        CaliperMetadataDB& m_dst;
+
+        IdMap              m_idmap;    ///< Id map for CaliperMetadataDB::merge()
+        IdMap              m_imported; ///< Source node id -> target node id
+
+        cali_id_t import_node(const CaliperMetadataDB& src, const Node* node) {
+            if (!node || node->id() == CALI_INV_ID)
+                return CALI_INV_ID;
+
+            // The bootstrap nodes (ids 0-10) are identical in every metadata DB
+            if (node->id() <= 10)
+                return node->id();
+
+            auto it = m_imported.find(node->id());
+
+            if (it != m_imported.end())
+                return it->second;
+
+            import_node(src, node->parent());
+            import_node(src, src.node(node->attribute()));
+
+            RecordMap rec = m_dst.merge(node->record(), m_idmap);
+            cali_id_t id  = rec["id"].front().to_id();
+
+            m_imported.insert(make_pair(node->id(), id));
+
+            return id;
+        }
+
+    public:
+
+        SnapshotImporter(CaliperMetadataDB& dst)
+            : m_dst(dst)
+            { }
+
+        EntryList import(const CaliperMetadataDB& src, const EntryList& list) {
+            EntryList ret;
+
+            ret.reserve(list.size());
+
+            for (const Entry& e : list)
+                if (e.node())
+                    ret.push_back(Entry(m_dst.node(import_node(src, e.node()))));
+                else if (e.is_immediate())
+                    ret.push_back(Entry(m_dst.attribute(import_node(src, src.node(e.attribute()))),
+                                        e.value()));
+
+            return ret;
+        }
+    };
+
+    /// Merges partial result @param from into @param into.
+    void merge_partials(Partial& into, Partial& from) {
+        SnapshotImporter  importer(into.db);
+
+        SnapshotProcessFn push = [&](CaliperMetadataDB& db, const EntryList& list) {
+            into.aggregate(into.db, importer.import(db, list));
+        };
+
+        from.aggregate.flush(from.db, push);
+    }
+
+    /// Binary tree reduction of partial results. Keeps at most one pending
+    /// partial result per tree level: adding a result to an occupied level
+    /// merges both and carries the combined result to the next level, so 
+    /// memory use grows only logarithmically with the number of streams.
+    class TreeReduction {
+        std::mutex                            m_lock;
+        std::vector< std::unique_ptr<Partial> > m_levels;
+
+    public:
+
+        void add(std::unique_ptr<Partial> p) {
+            while (p) {
+                std::unique_ptr<Partial> q;
+
+                {
+                    std::lock_guard<std::mutex>
+                        g(m_lock);
+
+                    if (m_levels.size() <= p->level)
+                        m_levels.resize(p->level + 1);
+
+                    if (!m_levels[p->level]) {
+                        m_levels[p->level] = std::move(p);
+                        return;
+                    }
+
+                    q = std::move(m_levels[p->level]);
+                }
+
+                // Merges run outside the lock, so independent subtrees are 
+                // reduced in parallel
+
+                merge_partials(*q, *p);
+
+                ++q->level;
+                p = std::move(q);
+            }
+        }
+
+        std::unique_ptr<Partial> finish() {
+            std::unique_ptr<Partial> result;
+
+            // Merge remaining partials from the bottom up; fold smaller
+            // results into larger ones
+
+            for (auto& p : m_levels) {
+                if (!p)
+                    continue;
+
+                if (result)
+                    merge_partials(*p, *result);
+
+                result = std::move(p);
+            }
+
+            m_levels.clear();
+
+            return result;
+        }
+    };
+
+    class WriteRecord {
+        ostream& m_os;
+
+        /// Write the given node's path, including the attribute nodes 
+        /// the path references, unless already written
+        template<typename WriteFn>
+        void write_node(CaliperMetadataDB& db, const Node* node, WriteFn fn) {
+            for (const Node* n = node; n && n->id() != CALI_INV_ID; n = n->parent())
+                db.write_path(n->attribute(), fn);
+
+            db.write_path(node->id(), fn);
+        }
+
+    public:
+
+        WriteRecord(ostream& os)
+            : m_os(os)
+            { }
+
+        void operator()(CaliperMetadataDB& db, const EntryList& list) {
+            std::vector<Variant> attr;
+            std::vector<Variant> vals;
+            std::vector<Variant> refs;
+
+            auto write_fn = [this](const RecordDescriptor& r,
+                                   const int* c,
+                                   const Variant** d)
+                { CsvSpec::write_record(m_os, r, c, d); };
+            
+            for (const Entry& e : list) {
+                if (e.node()) {                    
+                    write_node(db, e.node(), write_fn);
+                    
+                    refs.push_back(Variant(e.node()->id()));
+                } else if (e.attribute() != CALI_INV_ID) {
+                    write_node(db, db.node(e.attribute()), write_fn);
+                    
+                    attr.push_back(Variant(e.attribute()));
+                    vals.push_back(e.value());
+                }
+            }
+
+            int           count[3] = { static_cast<int>(refs.size()),
+                                       static_cast<int>(attr.size()),
+                                       static_cast<int>(vals.size()) };
+            const Variant* data[3] = { refs.data(), attr.data(), vals.data() };
+            
+            CsvSpec::write_record(m_os, ContextRecord::record_descriptor(), count, data);
+        }
+    };
+}
+
+
+//
+// --- main()
+//
+
+int main(int argc, const char* argv[])
+{
+    Args args(::option_table);
+
+    //
+    // --- Parse command line arguments
+    //
+
+    {
+        int i = args.parse(argc, argv);
+
+        if (i < argc) {
+            cerr << "cali-merge: error: unknown option: " << argv[i] << '\n'
+                 << "  Available options: ";
+
+            args.print_available_options(cerr);
+            
+            return -1;
+        }
+
+        if (args.is_set("help")) {
+            cerr << usage << "\n\n";
+
+            args.print_available_options(cerr);
+
+            return 0;
+        }
+    }
+
+    string ops = args.get("aggregate", "count");
+    string key = args.get("aggregate-key");
+    string combine_ops;
+
+    if (!::make_combine_ops(ops, combine_ops))
+        return -1;
+
+    //
+    // --- Create output stream (if requested)
+    //
+
+    ofstream fs;
+
+    if (args.is_set("output")) {
+        string filename = args.get("output");
+
+        fs.open(filename.c_str());
+
+        if (!fs) {
+            cerr << "cali-merge: error: could not open output file " 
+                 << filename << endl;
+
+            return -2;
+        } 
+    }
+
+    std::vector<std::string> files = args.arguments();
+
+    if (files.empty()) {
+        cerr << "cali-merge: error: no input files" << endl;
+        return -1;
+    }
+    
+    unsigned long threads_arg = 0;
+
+    if (!args.get_uint("threads", std::thread::hardware_concurrency(), &threads_arg)) {
+        cerr << "cali-merge: error: invalid argument for --threads: \""
+             << args.get("threads") << "\"\n  Usage: " << usage << endl;
+        return -1;
+    }
+
+    unsigned num_threads = std::min<unsigned long>(files.size(), threads_arg);
+
+    num_threads = std::max(num_threads, 1u);
+    std::cerr << "cali-merge: processing " << files.size() << " files using "
+              << num_threads << " thread" << (num_threads == 1 ? "." : "s.")  << std::endl;
+
+    //
+    // --- Thread processing function
+    //
+
+    TreeReduction         reduction;
+    std::atomic<unsigned> index(0);
+    
+    auto thread_fn = [&]() {
+        for (unsigned i = index++; i < files.size(); i = index++) { // "index++" is atomic read-mod-write 
+            std::unique_ptr<Partial> p(new Partial(combine_ops, key));
+
+            // Aggregate the stream's snapshots with the user-given operators 
+            // first, then hand the result to the partial's combining aggregator
+
+            Aggregator        aggregate(ops, key);
+            SnapshotProcessFn snap_proc = aggregate;
+            NodeProcessFn     node_proc = [](CaliperMetadataDB&,const Node*) { return; };
+
+            CsvReader reader(files[i]);
+            IdMap     idmap;
+
+            if (!reader.read([&](const RecordMap& rec){ p->db.merge(rec, idmap, node_proc, snap_proc); }))
+                cerr << "Could not read file " << files[i] << endl;
+
+            SnapshotProcessFn combine = p->aggregate;
+
+            aggregate.flush(p->db, combine);
+            reduction.add(std::move(p));
+        }
+    };
+
+    std::vector<std::thread> threads;
+
+    for (unsigned t = 0; t < num_threads; ++t)
+        threads.emplace_back(thread_fn);
+
+    for (auto &t : threads)
+        t.join();
+    
+    //
+    // --- Flush outputs
+    //
+
+    std::unique_ptr<Partial> result = reduction.finish();
+
+    if (result) {
+        SnapshotProcessFn writer = ::WriteRecord(fs.is_open() ? fs : cout);
+
+        result->aggregate.flush(result->db, writer);
+    }
+}
@@ -56,10 +56,12 @@
 #include <util/split.hpp>
 
 #include <atomic>
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <iterator>
 #include <mutex>
+#include <random>
 #include <sstream>
 #include <thread>
 
@@ -87,6 +89,10 @@ namespace
           "List of attributes to aggregate over (collapses all other attributes): attribute[:...]",
           "ATTRIBUTES"
         },
+        { "aggregate-memory", "aggregate-memory", 0, true,
+          "Memory budget for aggregation in MiB. Larger aggregations are spilled to temporary files. Default: 1024",
+          "MIB"
+        },
         { "expand", "expand", 'e', false,  
           "Expand context records and print the selected attributes (default: all)", 
           nullptr 
@@ -115,6 +121,14 @@ namespace
           "Print given attributes in web-friendly json format",
           "ATTRIBUTES"
         },
+        { "sample-rate", "sample-rate", 0, true,
+          "Process only a random sample of snapshot records with the given probability (0 < p <= 1). Aggregation results are scaled.",
+          "P"
+        },
+        { "time-budget", "time-budget", 0, true,
+          "Stop reading input after the given number of seconds and report the fraction of input processed",
+          "SECONDS"
+        },
         { "threads", "threads", 0, true,
           "Use this many threads (applicable only with multiple files)",
           "THREADS"
@@ -146,10 +160,10 @@ namespace
             std::lock_guard<std::mutex>
                 g(sI->os_lock);
             
-            db.mutable_node(node->id())->write_path([this](const RecordDescriptor& r,
-                                                           const int* c,
-                                                           const Variant** d)
-                                                    { CsvSpec::write_record(sI->os, r, c, d); });
+            db.write_path(node->id(), [this](const RecordDescriptor& r,
+                                             const int* c,
+                                             const Variant** d)
+                          { CsvSpec::write_record(sI->os, r, c, d); });
         }
 
         void operator()(CaliperMetadataDB& db, const EntryList& list) {
@@ -166,11 +180,11 @@ namespace
             
             for (const Entry& e : list) {
                 if (e.node()) {                    
-                    db.mutable_node(e.node()->id())->write_path(write_fn);
+                    db.write_path(e.node()->id(), write_fn);
                     
                     refs.push_back(Variant(e.node()->id()));
                 } else if (e.attribute() != CALI_INV_ID) {
-                    db.mutable_node(e.attribute())->write_path(write_fn);
+                    db.write_path(e.attribute(), write_fn);
                     
                     attr.push_back(Variant(e.attribute()));
                     vals.push_back(e.value());
@@ -200,6 +214,66 @@ namespace
         }
     };
 
+    /// Shared state for the line sampling filters of all input streams
+    struct SamplingInfo {
+        double                                sample_rate;
+        bool                                  has_deadline;
+        std::chrono::steady_clock::time_point deadline;
+
+        std::atomic<bool>                     stop;
+        std::atomic<uint64_t>                 bytes_read;
+        std::atomic<uint64_t>                 ctx_seen;
+        std::atomic<uint64_t>                 ctx_sampled;
+
+        SamplingInfo()
+            : sample_rate(1.0), has_deadline(false), stop(false),
+              bytes_read(0), ctx_seen(0), ctx_sampled(0)
+            { }
+    };
+
+    /// CsvReader line filter that implements record sampling and the time
+    /// budget. Snapshot ("ctx") records are sampled with the configured
+    /// probability before parsing; all other records are always kept.
+    class LineSampler {
+        SamplingInfo*  m_info;
+        std::minstd_rand m_rng;
+        double         m_threshold;
+        unsigned       m_lines;
+
+        static const unsigned check_interval = 1024;
+
+    public:
+
+        LineSampler(SamplingInfo* info, unsigned seed)
+            : m_info(info),
+              m_rng(seed + 1),
+              m_threshold(info->sample_rate * (std::minstd_rand::max() - std::minstd_rand::min())),
+              m_lines(0)
+            { }
+
+        CsvReader::LineAction operator()(const std::string& line) {
+            if (++m_lines % check_interval == 0 && m_info->has_deadline)
+                if (std::chrono::steady_clock::now() > m_info->deadline)
+                    m_info->stop.store(true);
+
+            if (m_info->stop.load(std::memory_order_relaxed))
+                return CsvReader::Stop;
+
+            m_info->bytes_read.fetch_add(line.size() + 1, std::memory_order_relaxed);
+
+            if (m_info->sample_rate < 1.0 && line.compare(0, 9, "__rec=ctx") == 0) {
+                m_info->ctx_seen.fetch_add(1, std::memory_order_relaxed);
+
+                if (m_rng() - std::minstd_rand::min() >= m_threshold)
+                    return CsvReader::Skip;
+
+                m_info->ctx_sampled.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            return CsvReader::Parse;
+        }
+    };
+
     /// A node record filter that filters redundant identical node records.
     /// Redundant node records can occur when merging/unifying two streams.
     class FilterDuplicateNodes {
@@ -394,9 +468,50 @@ int main(int argc, const char* argv[])
         node_proc   = writer;
     }
 
-    Aggregator        aggregate(args.get("aggregate"), args.get("aggregate-key"));
+    unsigned long     aggregate_memory = 0;
+
+    if (!args.get_uint("aggregate-memory", 1024, &aggregate_memory)) {
+        cerr << "cali-query: error: invalid argument for --aggregate-memory: \""
+             << args.get("aggregate-memory") << "\"\n  Usage: " << usage << endl;
+        return -1;
+    }
+
+    Aggregator        aggregate(args.get("aggregate"), args.get("aggregate-key"),
+                                aggregate_memory * 1024 * 1024);
     SnapshotProcessFn snap_proc(args.is_set("aggregate") ? aggregate : snap_writer);
 
+    //
+    // --- Sampling and time budget
+    //
+
+    ::SamplingInfo    sampling;
+
+    if (args.is_set("sample-rate")) {
+        if (!args.get_double("sample-rate", 1.0, &sampling.sample_rate)
+            || !(sampling.sample_rate > 0.0 && sampling.sample_rate <= 1.0)) {
+            cerr << "cali-query: error: sample rate must be in (0, 1]" << endl;
+            return -2;
+        }
+
+        aggregate.set_sample_rate(sampling.sample_rate);
+    }
+
+    if (args.is_set("time-budget")) {
+        double budget = 0.0;
+
+        if (!args.get_double("time-budget", 0.0, &budget) || budget < 0.0) {
+            cerr << "cali-query: error: invalid argument for --time-budget: \""
+                 << args.get("time-budget") << "\"\n  Usage: " << usage << endl;
+            return -1;
+        }
+
+        sampling.has_deadline = true;
+        sampling.deadline     = std::chrono::steady_clock::now() +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(budget));
+    }
+
+    bool use_line_filter = args.is_set("sample-rate") || args.is_set("time-budget");
+
     string select = args.get("select");
 
     if (!select.empty())
@@ -408,10 +523,17 @@ int main(int argc, const char* argv[])
 
     std::vector<std::string> files = args.arguments();
     
-    unsigned num_threads =
-        std::min<unsigned>(files.size(),
-                           std::stoul(args.get("threads", std::to_string(std::thread::hardware_concurrency()))));
+    unsigned long threads_arg = 0;
+
+    if (!args.get_uint("threads", std::thread::hardware_concurrency(), &threads_arg)) {
+        cerr << "cali-query: error: invalid argument for --threads: \""
+             << args.get("threads") << "\"\n  Usage: " << usage << endl;
+        return -1;
+    }
+
+    unsigned num_threads = std::min<unsigned long>(files.size(), threads_arg);
 
+    num_threads = std::max(num_threads, 1u);
     std::cerr << "cali-query: processing " << files.size() << " files using "
               << num_threads << " thread" << (num_threads == 1 ? "." : "s.")  << std::endl;
 
@@ -437,7 +559,12 @@ int main(int argc, const char* argv[])
             CsvReader reader(files[i]);
             IdMap     idmap;
 
-            if (!reader.read([&](const RecordMap& rec){ metadb.merge(rec, idmap, node_proc, snap_proc); }))
+            auto rec_fn = [&](const RecordMap& rec){ metadb.merge(rec, idmap, node_proc, snap_proc); };
+
+            bool ok = use_line_filter ?
+                reader.read(rec_fn, ::LineSampler(&sampling, i)) : reader.read(rec_fn);
+
+            if (!ok)
                 cerr << "Could not read file " << files[i] << endl;
         }
     };
@@ -453,6 +580,25 @@ int main(int argc, const char* argv[])
 
     for (auto &t : threads)
         t.join();
+
+    if (sampling.sample_rate < 1.0)
+        cerr << "cali-query: sampled " << sampling.ctx_sampled.load() << " of "
+             << sampling.ctx_seen.load() << " snapshot records" << endl;
+
+    if (sampling.stop.load()) {
+        uint64_t total = 0;
+
+        for (const std::string& file : files) {
+            std::ifstream is(file, std::ios::binary | std::ios::ate);
+
+            if (is)
+                total += is.tellg();
+        }
+
+        cerr << "cali-query: time budget exceeded: processed " << sampling.bytes_read.load()
+             << " of " << total << " input bytes (" 
+             << (total > 0 ? 100.0 * sampling.bytes_read.load() / total : 100.0) << "%)" << endl;
+    }
     
     //
     // --- Flush outputs
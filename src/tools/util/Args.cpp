@@ -35,6 +35,9 @@
 
 #include "Args.h"
 
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
 #include <cstring>
 #include <map>
 
@@ -289,6 +292,45 @@ bool Args::is_set(const string& name) const
     return mP->is_set(name);
 }
 
+bool Args::get_uint(const string& name, unsigned long def, unsigned long* val) const
+{
+    if (!mP->is_set(name)) {
+        *val = def;
+        return true;
+    }
+
+    string str = mP->get(name, "");
+
+    // strtoul() accepts (and negates) a leading '-'
+    if (str.empty() || !isdigit(static_cast<unsigned char>(str[0])))
+        return false;
+
+    char* end = nullptr;
+    errno     = 0;
+    *val      = strtoul(str.c_str(), &end, 10);
+
+    return errno == 0 && *end == '\0';
+}
+
+bool Args::get_double(const string& name, double def, double* val) const
+{
+    if (!mP->is_set(name)) {
+        *val = def;
+        return true;
+    }
+
+    string str = mP->get(name, "");
+
+    if (str.empty())
+        return false;
+
+    char* end = nullptr;
+    errno     = 0;
+    *val      = strtod(str.c_str(), &end);
+
+    return errno == 0 && *end == '\0';
+}
+
 vector<string> Args::options() const
 {
     return mP->options();
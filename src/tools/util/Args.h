@@ -86,6 +86,15 @@ public:
     std::string get(const std::string& name, const std::string& def = "") const;
     bool        is_set(const std::string& name) const;
 
+    /// Parses the argument of option @arg name as a non-negative integer
+    /// into @arg val, or sets @arg val to @arg def if the option is not set.
+    /// @return false if the argument is not a valid number
+    bool        get_uint(const std::string& name, unsigned long def, unsigned long* val) const;
+    /// Parses the argument of option @arg name as a floating-point number
+    /// into @arg val, or sets @arg val to @arg def if the option is not set.
+    /// @return false if the argument is not a valid number
+    bool        get_double(const std::string& name, double def, double* val) const;
+
     std::vector<std::string> options() const;
     std::vector<std::string> arguments() const;
 
@@ -0,0 +1,53 @@
+#!/bin/sh
+#
+# Round-trip test for cali-merge: merges the traces of several cali-basic
+# runs and compares the result with cali-query's aggregation of the same
+# traces.
+#
+# Usage: cali-merge-test.sh <cali-basic> <cali-query> <cali-merge> <workdir>
+
+CALI_BASIC=$1
+CALI_QUERY=$2
+CALI_MERGE=$3
+WORKDIR=$4
+
+OPS="count:sum(iteration)"
+KEY="loop"
+
+rm -rf "$WORKDIR" && mkdir -p "$WORKDIR" || exit 1
+
+for i in 1 2 3 4 5 ; do
+    CALI_SERVICES_ENABLE=event:trace:recorder \
+    CALI_RECORDER_FILENAME="$WORKDIR/run-$i.cali" \
+    CALI_LOG_VERBOSITY=0 \
+        "$CALI_BASIC" || exit 1
+done
+
+"$CALI_QUERY" -a "$OPS" --aggregate-key="$KEY" -e "$WORKDIR"/run-*.cali \
+    | sort > "$WORKDIR/expected.txt" || exit 1
+
+for threads in 1 2 ; do
+    "$CALI_MERGE" -a "$OPS" --aggregate-key="$KEY" --threads=$threads \
+        -o "$WORKDIR/merged-$threads.cali" "$WORKDIR"/run-*.cali || exit 1
+    "$CALI_QUERY" -e "$WORKDIR/merged-$threads.cali" \
+        | sort > "$WORKDIR/merged-$threads.txt" || exit 1
+
+    if ! cmp -s "$WORKDIR/expected.txt" "$WORKDIR/merged-$threads.txt" ; then
+        echo "cali-merge --threads=$threads result differs from cali-query aggregation:"
+        diff "$WORKDIR/expected.txt" "$WORKDIR/merged-$threads.txt"
+        exit 1
+    fi
+done
+
+# the expected result must not be empty: each run sets iteration=0..3
+grep -q "loop=true,.*iteration=30" "$WORKDIR/expected.txt" || {
+    echo "unexpected aggregation result:" ; cat "$WORKDIR/expected.txt" ; exit 1
+}
+
+# invalid numeric arguments must be rejected
+if "$CALI_MERGE" --threads=abc "$WORKDIR/run-1.cali" 2> /dev/null ; then
+    echo "cali-merge accepted --threads=abc"
+    exit 1
+fi
+
+exit 0
@@ -0,0 +1,152 @@
+// Copyright (c) 2015, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// Test for the powercap service: reads energy counters from a fake
+// powercap sysfs tree and checks zone naming, deltas, and wraparound.
+//
+// Usage: cali-powercap-test <directory>
+
+#include <Caliper.h>
+#include <EntryList.h>
+
+#include <Variant.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <sys/stat.h>
+
+using namespace cali;
+
+namespace
+{
+
+std::string root;
+
+void write_file(const std::string& path, const std::string& content)
+{
+    std::ofstream os(root + "/" + path);
+    os << content << std::endl;
+}
+
+void make_zone(const std::string& zone, const char* name, uint64_t energy, uint64_t range)
+{
+    mkdir((root + "/" + zone).c_str(), 0755);
+
+    write_file(zone + "/name", name);
+    write_file(zone + "/energy_uj", std::to_string(energy));
+
+    if (range > 0)
+        write_file(zone + "/max_energy_range_uj", std::to_string(range));
+}
+
+int errors = 0;
+
+void check_delta(const EntryList& sbuf, const Attribute& attr, uint64_t expected, const char* what)
+{
+    Entry e = sbuf.get(attr);
+
+    if (e.is_empty()) {
+        std::cerr << what << ": " << attr.name() << " not found in snapshot" << std::endl;
+        ++errors;
+    } else if (e.value().to_uint() != expected) {
+        std::cerr << what << ": " << attr.name() << " = " << e.value().to_uint()
+                  << ", expected " << expected << std::endl;
+        ++errors;
+    }
+}
+
+void check_snapshot(Caliper& c, const Attribute& pkg, uint64_t pkg_delta,
+                    const Attribute& dram, uint64_t dram_delta, const char* what)
+{
+    EntryList::FixedEntryList<64> snapshot_data;
+    EntryList sbuf(snapshot_data);
+
+    c.pull_snapshot(CALI_SCOPE_PROCESS, nullptr, &sbuf);
+
+    check_delta(sbuf, pkg,  pkg_delta,  what);
+    check_delta(sbuf, dram, dram_delta, what);
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        std::cerr << "Usage: cali-powercap-test <directory>" << std::endl;
+        return 2;
+    }
+
+    root = argv[1];
+
+    mkdir(root.c_str(), 0755);
+
+    // intel-rapl:0:0 has no max_energy_range_uj: wraparounds are skipped
+    make_zone("intel-rapl:0",   "package-0", 1000, 10000);
+    make_zone("intel-rapl:0:0", "dram",       500,     0);
+
+    setenv("CALI_SERVICES_ENABLE",      "powercap", 1);
+    setenv("CALI_POWERCAP_ROOT",         root.c_str(), 1);
+    setenv("CALI_POWERCAP_MIN_INTERVAL", "0", 1);
+
+    Caliper   c    = Caliper::instance();
+
+    Attribute pkg  = c.get_attribute("energy.package-0");
+    Attribute dram = c.get_attribute("energy.package-0.dram");
+
+    if (pkg == Attribute::invalid || dram == Attribute::invalid) {
+        std::cerr << "energy.package-0 or energy.package-0.dram attribute not found" << std::endl;
+        return 1;
+    }
+
+    write_file("intel-rapl:0/energy_uj",   "1500");
+    write_file("intel-rapl:0:0/energy_uj", "800");
+
+    check_snapshot(c, pkg, 500, dram, 300, "delta");
+
+    // package counter wraps around at 10000, dram's range is unknown
+
+    write_file("intel-rapl:0/energy_uj",   "300");
+    write_file("intel-rapl:0:0/energy_uj", "100");
+
+    check_snapshot(c, pkg, 8800, dram, 0, "wraparound");
+
+    write_file("intel-rapl:0/energy_uj",   "400");
+    write_file("intel-rapl:0:0/energy_uj", "150");
+
+    check_snapshot(c, pkg, 100, dram, 50, "after wraparound");
+
+    return errors > 0 ? 1 : 0;
+}
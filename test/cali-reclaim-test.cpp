@@ -0,0 +1,128 @@
+// Copyright (c) 2015, Lawrence Livermore National Security, LLC.  
+// Produced at the Lawrence Livermore National Laboratory.
+//
+// This file is part of Caliper.
+// Written by David Boehme, boehme3@llnl.gov.
+// LLNL-CODE-678900
+// All rights reserved.
+//
+// For details, see https://github.com/scalability-llnl/Caliper.
+// Please also see the LICENSE file for our additional BSD notice.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+//  * Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the disclaimer below.
+//  * Redistributions in binary form must reproduce the above copyright notice, this list of
+//    conditions and the disclaimer (as noted below) in the documentation and/or other materials
+//    provided with the distribution.
+//  * Neither the name of the LLNS/LLNL nor the names of its contributors may be used to endorse
+//    or promote products derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS
+// OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// LAWRENCE LIVERMORE NATIONAL SECURITY, LLC, THE U.S. DEPARTMENT OF ENERGY OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+// DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+// WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+// ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// Multithreaded driver for cali-reclaim-test.sh: several threads update
+// nested regions and a phase attribute, and the main thread flushes
+// between rounds while the threads wait. The aggregated results must not
+// depend on node reclamation.
+//
+// Usage: cali-reclaim-test <threads> <iterations> <rounds>
+
+#include <Annotation.h>
+#include <Caliper.h>
+
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+int num_threads    = 4;
+int num_iterations = 200;
+int num_rounds     = 5;
+
+std::mutex              barrier_lock;
+std::condition_variable barrier_cv;
+int                     barrier_count = 0;
+int                     barrier_phase = 0;
+
+void barrier()
+{
+    std::unique_lock<std::mutex> lk(barrier_lock);
+
+    int phase = barrier_phase;
+
+    if (++barrier_count == num_threads + 1) {
+        barrier_count = 0;
+        ++barrier_phase;
+        barrier_cv.notify_all();
+    } else {
+        barrier_cv.wait(lk, [phase](){ return barrier_phase != phase; });
+    }
+}
+
+void work()
+{
+    cali::Annotation phase("phase");
+    cali::Annotation region("region");
+    cali::Annotation iteration("iteration");
+
+    for (int r = 0; r < num_rounds; ++r) {
+        for (int i = 0; i < num_iterations; ++i) {
+            phase.set(i % 5);
+            region.begin("outer");
+
+            for (int j = 0; j < 10; ++j) {
+                iteration.set(r * 100 + j);
+                region.begin("inner");
+                region.end();
+            }
+
+            region.end();
+        }
+
+        barrier(); // round done
+        barrier(); // flush done
+    }
+}
+
+} // namespace [anonymous]
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1)
+        num_threads    = std::atoi(argv[1]);
+    if (argc > 2)
+        num_iterations = std::atoi(argv[2]);
+    if (argc > 3)
+        num_rounds     = std::atoi(argv[3]);
+
+    cali::Caliper::instance();
+
+    std::vector<std::thread> threads;
+
+    for (int t = 0; t < num_threads; ++t)
+        threads.emplace_back(work);
+
+    for (int r = 0; r < num_rounds; ++r) {
+        barrier();
+        cali::Caliper::instance().flush(nullptr);
+        barrier();
+    }
+
+    for (std::thread& t : threads)
+        t.join();
+}
@@ -0,0 +1,48 @@
+#!/bin/sh
+#
+# Multithreaded aggregation test for context tree node reclamation:
+# runs cali-reclaim-test with and without CALI_CALIPER_RECLAIM_NODES and
+# checks that the aggregated snapshot counts are identical. Races show up
+# only in some runs, so it runs several times with reclamation.
+#
+# Usage: cali-reclaim-test.sh <cali-reclaim-test> <cali-query> <workdir>
+
+CALI_RECLAIM_TEST=$1
+CALI_QUERY=$2
+WORKDIR=$3
+
+ARGS="4 200 5"
+KEY="phase:region"
+
+rm -rf "$WORKDIR" && mkdir -p "$WORKDIR" || exit 1
+
+run() {
+    CALI_SERVICES_ENABLE=event:aggregate:recorder \
+    CALI_AGGREGATE_KEY="$KEY:event.set#phase" \
+    CALI_CALIPER_RECLAIM_NODES=$1 \
+    CALI_RECORDER_FILENAME="$WORKDIR/$2.cali" \
+    CALI_LOG_VERBOSITY=0 \
+        "$CALI_RECLAIM_TEST" $ARGS || exit 1
+
+    "$CALI_QUERY" -a "sum(aggregate.count)" --aggregate-key="$KEY" -e "$WORKDIR/$2.cali" \
+        | sort > "$WORKDIR/$2.txt" || exit 1
+}
+
+run false expected
+
+# 4 threads x 5 rounds x 40 iterations with phase=0 x 21 snapshots
+grep -q "^region=outer,phase=0,aggregate.count=16800$" "$WORKDIR/expected.txt" || {
+    echo "unexpected aggregation result:" ; cat "$WORKDIR/expected.txt" ; exit 1
+}
+
+for i in 1 2 3 4 5 ; do
+    run true reclaim-$i
+
+    if ! cmp -s "$WORKDIR/expected.txt" "$WORKDIR/reclaim-$i.txt" ; then
+        echo "aggregation result with node reclamation differs (run $i):"
+        diff "$WORKDIR/expected.txt" "$WORKDIR/reclaim-$i.txt"
+        exit 1
+    fi
+done
+
+exit 0
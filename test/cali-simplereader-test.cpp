@@ -33,6 +33,8 @@
 ///@file cali-simplereader-test.cpp
 
 #include <SimpleReader.h>
+
+#include <Node.h>
 using namespace cali;
 
 #include <string>
@@ -52,10 +54,17 @@ int main(int argc, char *argv[])
 
     sr.open(filename);
 
-    ExpandedRecordMap rec;
-    while (sr.nextSnapshot(rec)) {
-        for (auto attr : rec) {
-            cout << attr.first << "=" << attr.second << ",";
+    CaliperMetadataDB& db = sr.metadb();
+    EntryList list;
+
+    while (sr.next_snapshot(list)) {
+        for (const Entry& e : list) {
+            if (e.node()) {
+                for (const Node* node = e.node(); node && node->id() != CALI_INV_ID; node = node->parent())
+                    cout << db.attribute(node->attribute()).name() << "=" << node->data() << ",";
+            } else {
+                cout << db.attribute(e.attribute()).name() << "=" << e.value() << ",";
+            }
         }
         cout << endl;
     }
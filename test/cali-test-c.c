@@ -138,6 +138,54 @@ void test_snapshot()
   cali_end_byname("cali-test-c.experiment");    
 }
 
+void test_region()
+{
+  int i;
+
+  cali_begin_string_byname("cali-test-c.experiment", "region");
+
+  for (i = 0; i < 3; ++i) {
+    cali_begin_string_byname("cali-test-c.interned", cali_intern_string("interned"));
+    cali_end_byname("cali-test-c.interned");
+
+    CALI_REGION_BEGIN(region, "cali-test-c.region");
+    cali_push_snapshot(CALI_SCOPE_PROCESS | CALI_SCOPE_THREAD, 0, NULL, NULL, NULL);
+    CALI_REGION_END(region);
+  }
+
+  cali_end_byname("cali-test-c.experiment");
+}
+
+void test_accumulate()
+{
+  int i;
+
+  cali_id_t acc_attr =
+    cali_create_attribute("cali-test-c.accumulated", CALI_TYPE_DOUBLE, CALI_ATTR_ASVALUE);
+
+  cali_begin_string_byname("cali-test-c.experiment", "accumulate");
+
+  for (i = 0; i < 4; ++i)
+    cali_accumulate(acc_attr, 0.5);
+
+  cali_end_byname("cali-test-c.experiment");
+}
+
+void test_loop()
+{
+  int i;
+
+  cali_loop_t loop =
+    cali_make_loop("cali-test-c.loop", CALI_LOOP_BUCKET_LOG2, 1);
+
+  cali_loop_begin(loop);
+
+  for (i = 0; i < 20; ++i)
+    cali_loop_iteration(loop, i);
+
+  cali_loop_end(loop);
+}
+
 int main(int argc, char* argv[])
 {
   test_attr_by_name();
@@ -145,6 +193,9 @@ int main(int argc, char* argv[])
   test_mismatch();
   test_metadata();
   test_snapshot();
+  test_region();
+  test_accumulate();
+  test_loop();
   
   return 0;
 }
@@ -34,6 +34,7 @@
 
 #include <Annotation.h>
 #include <Caliper.h>
+#include <Region.h>
 
 #include <Variant.h>
 
@@ -190,6 +191,17 @@ void test_cross_scope()
     end_foo_op();
 }
 
+void test_region()
+{
+    static cali::Region outer("cali-test.region.outer", "cali-test.region");
+
+    for (int i = 0; i < 3; ++i) {
+        cali::Region::Guard g(outer);
+
+        CALI_REGION("cali-test.region.inner");
+    }
+}
+
 std::ostream& print_padded(std::ostream& os, const char* string, int fieldlen)
 {
     const char* whitespace =
@@ -220,6 +232,7 @@ int main(int argc, char* argv[])
         { "end-mismatch",             test_end_mismatch       },
         { "escaping",                 test_escaping           },
         { "cross-scope",              test_cross_scope        },
+        { "region",                   test_region             },
         { 0, 0 }
     };
 
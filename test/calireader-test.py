@@ -0,0 +1,59 @@
+#
+# Test for the python reader module: reads the trace of a cali-basic run
+# with read_cali_file() and read_cali_file_columns().
+#
+# Usage: calireader-test.py <calireader module dir> <cali-basic> <workdir>
+
+import os
+import shutil
+import subprocess
+import sys
+
+moduledir, cali_basic, workdir = sys.argv[1:4]
+
+sys.path.insert(0, moduledir)
+
+import calireader
+
+shutil.rmtree(workdir, ignore_errors=True)
+os.makedirs(workdir)
+
+filename = os.path.join(workdir, 'cali-basic.cali')
+
+env = dict(os.environ)
+env.update(CALI_SERVICES_ENABLE='event:trace:recorder',
+           CALI_RECORDER_FILENAME=filename,
+           CALI_LOG_VERBOSITY='0')
+
+subprocess.check_call([ cali_basic ], env=env)
+
+# --- row-wise reader
+
+records = calireader.read_cali_file(filename)
+
+iterations = sorted(set(int(r['iteration']) for r in records.values() if 'iteration' in r))
+
+if iterations != [ 0, 1, 2, 3 ]:
+    sys.exit('read_cali_file: unexpected iteration values %s' % iterations)
+
+# --- column reader
+
+rows, columns = calireader.read_cali_file_columns(filename)
+
+if rows != len(records):
+    sys.exit('read_cali_file_columns: %d rows, expected %d' % (rows, len(records)))
+
+for name in [ 'loop', 'iteration' ]:
+    if name not in columns:
+        sys.exit('read_cali_file_columns: missing column %s' % name)
+    if len(columns[name]) != rows:
+        sys.exit('read_cali_file_columns: column %s has %d rows, expected %d'
+                 % (name, len(columns[name]), rows))
+
+iterations = sorted(set(v for v in (columns['iteration'][i] for i in range(rows)) if v is not None))
+
+if iterations != [ 0, 1, 2, 3 ]:
+    sys.exit('read_cali_file_columns: unexpected iteration values %s' % iterations)
+
+if 'true' not in [ columns['loop'][i] for i in range(rows) ]:
+    sys.exit('read_cali_file_columns: loop column has no "true" value')